@@ -0,0 +1,82 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // per thread, so counting needs no synchronization and concurrent work does not mix in
+    thread_local uint64_t allocationCount = 0;
+    thread_local uint64_t allocatedBytes = 0;
+
+    void* CountedAllocate(std::size_t size)
+    {
+        ++allocationCount;
+        allocatedBytes += size;
+        return std::malloc(size == 0 ? 1 : size);
+    }
+}
+
+uint64_t ThreadAllocationCount()
+{
+    return allocationCount;
+}
+
+uint64_t ThreadAllocatedBytes()
+{
+    return allocatedBytes;
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* p = CountedAllocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* p = CountedAllocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
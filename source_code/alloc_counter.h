@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// heap allocations made through operator new by the calling thread since it started
+// alloc_counter.cpp replaces the global operator new/delete with versions that count,
+// they are linked into every program that calls one of these functions
+uint64_t ThreadAllocationCount();
+uint64_t ThreadAllocatedBytes();
@@ -0,0 +1,59 @@
+#include "analysis_arena.h"
+
+AnalysisArena::AnalysisArena()
+{
+    strings.reserve(MAX_KEPT_BUFFERS);
+}
+
+std::string AnalysisArena::TakeString()
+{
+    if (strings.empty())
+        return std::string();
+
+    size_t largest = 0;
+    for (size_t i = 1; i < strings.size(); ++i)
+    {
+        if (strings[i].capacity() > strings[largest].capacity())
+            largest = i;
+    }
+    std::string buffer = std::move(strings[largest]);
+    strings[largest].swap(strings.back());
+    strings.pop_back();
+    return buffer;
+}
+
+void AnalysisArena::GiveBack(std::string& buffer)
+{
+    // short strings live inside the object, there is no memory to keep
+    const size_t capacity = buffer.capacity();
+    if (capacity > MAX_KEPT_CAPACITY || capacity <= std::string().capacity())
+    {
+        std::string().swap(buffer);
+        return;
+    }
+
+    buffer.clear();
+    if (strings.size() < MAX_KEPT_BUFFERS)
+    {
+        strings.push_back(std::move(buffer));
+    }
+    else
+    {
+        // replaces the smallest kept buffer if this one is larger
+        size_t smallest = 0;
+        for (size_t i = 1; i < strings.size(); ++i)
+        {
+            if (strings[i].capacity() < strings[smallest].capacity())
+                smallest = i;
+        }
+        if (strings[smallest].capacity() < capacity)
+            strings[smallest].swap(buffer);
+    }
+    std::string().swap(buffer);
+}
+
+AnalysisArena& ThreadArena()
+{
+    thread_local AnalysisArena arena;
+    return arena;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// buffers the analysis passes build their output in, kept from one analysis to the next
+// a pass takes a string, writes its result into it and swaps it with the text, so the
+// string it gives back holds the memory of the old text; once the buffers have grown to
+// the size of the pieces analyzed, the passes allocate nothing
+// each thread has its own arena (ThreadArena), analyses on different threads share nothing
+class AnalysisArena
+{
+public:
+    static const size_t MAX_KEPT_BUFFERS = 4;
+    static const size_t MAX_KEPT_CAPACITY = 16 << 20; // larger buffers go back to the heap
+
+    AnalysisArena();
+
+    // an empty string, the largest kept one if there is any
+    std::string TakeString();
+
+    // keeps the memory of buffer for a later TakeString, buffer is left empty
+    void GiveBack(std::string& buffer);
+
+private:
+    std::vector<std::string> strings;
+};
+
+// the arena of the calling thread
+AnalysisArena& ThreadArena();
+
+// an empty string of the calling thread's arena for the length of a scope
+class ScratchString
+{
+public:
+    ScratchString() : value(ThreadArena().TakeString()) {}
+    ~ScratchString() { ThreadArena().GiveBack(value); }
+
+    ScratchString(const ScratchString&) = delete;
+    ScratchString& operator=(const ScratchString&) = delete;
+
+    std::string& Get() { return value; }
+
+private:
+    std::string value;
+};
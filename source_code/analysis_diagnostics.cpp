@@ -0,0 +1,169 @@
+#include "analysis_diagnostics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+    // records allocated up front, a large capacity is only a limit the vector grows up to
+    const size_t INITIAL_RECORDS = 1024;
+}
+
+AnalysisDiagnostics::AnalysisDiagnostics(size_t capacity)
+    : capacity(capacity)
+{
+    records.reserve(std::min(capacity, INITIAL_RECORDS));
+}
+
+void AnalysisDiagnostics::Add(AnalysisStage stage, uint64_t offset, uint32_t length, std::string_view replacement)
+{
+    ++counts[static_cast<int>(stage)];
+    if (records.size() >= capacity)
+    {
+        ++dropped;
+        return;
+    }
+    records.push_back(Diagnostic{ offset, length, static_cast<uint32_t>(replacement.size()), replacements.size(), stage });
+    replacements.append(replacement.data(), replacement.size());
+}
+
+void AnalysisDiagnostics::Merge(const AnalysisDiagnostics& other, uint64_t offsetShift)
+{
+    for (const Diagnostic& diagnostic : other.records)
+    {
+        if (records.size() >= capacity)
+        {
+            ++dropped;
+            continue;
+        }
+        records.push_back(diagnostic);
+        records.back().offset += offsetShift;
+        records.back().replacementStart = replacements.size();
+        replacements.append(other.Replacement(diagnostic).data(), diagnostic.replacementLength);
+    }
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+        counts[s] += other.counts[s];
+    dropped += other.dropped;
+}
+
+uint64_t AnalysisDiagnostics::Total() const
+{
+    return std::accumulate(std::begin(counts), std::end(counts), uint64_t(0));
+}
+
+std::vector<uint32_t> SelectDiagnostics(const AnalysisDiagnostics& diagnostics, AnalysisStage rule, DiagnosticOrder order)
+{
+    const std::vector<Diagnostic>& records = diagnostics.records;
+
+    // sorted by offset first, with the index breaking ties so equal offsets keep record order
+    std::vector<std::pair<uint64_t, uint32_t>> byOffset;
+    if (rule == AnalysisStage::COUNT)
+        byOffset.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        if (rule == AnalysisStage::COUNT || records[i].stage == rule)
+            byOffset.emplace_back(records[i].offset, static_cast<uint32_t>(i));
+    }
+    std::sort(byOffset.begin(), byOffset.end());
+
+    std::vector<uint32_t> selected(byOffset.size());
+    for (size_t i = 0; i < byOffset.size(); ++i)
+        selected[i] = byOffset[i].second;
+    if (order == DiagnosticOrder::OFFSET)
+        return selected;
+
+    // the other orders have few distinct keys (five rules, a few hundred replacement texts),
+    // so each record gets the rank of its key and a counting sort keeps the offset order
+    std::vector<uint32_t> ranks(records.size());
+    size_t rankCount;
+    if (order == DiagnosticOrder::RULE)
+    {
+        for (uint32_t index : selected)
+            ranks[index] = static_cast<uint32_t>(records[index].stage);
+        rankCount = static_cast<size_t>(AnalysisStage::COUNT);
+    }
+    else
+    {
+        std::unordered_map<std::string_view, uint32_t> ids;
+        std::vector<std::string_view> texts;
+        for (uint32_t index : selected)
+        {
+            auto inserted = ids.emplace(diagnostics.Replacement(records[index]), static_cast<uint32_t>(texts.size()));
+            if (inserted.second)
+                texts.push_back(inserted.first->first);
+            ranks[index] = inserted.first->second;
+        }
+        std::vector<uint32_t> textOrder(texts.size());
+        std::iota(textOrder.begin(), textOrder.end(), uint32_t(0));
+        std::sort(textOrder.begin(), textOrder.end(), [&texts](uint32_t a, uint32_t b) { return texts[a] < texts[b]; });
+        std::vector<uint32_t> rankOfId(texts.size());
+        for (size_t r = 0; r < textOrder.size(); ++r)
+            rankOfId[textOrder[r]] = static_cast<uint32_t>(r);
+        for (uint32_t index : selected)
+            ranks[index] = rankOfId[ranks[index]];
+        rankCount = texts.size();
+    }
+
+    std::vector<size_t> starts(rankCount + 1, 0);
+    for (uint32_t index : selected)
+        ++starts[ranks[index] + 1];
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<uint32_t> sorted(selected.size());
+    for (uint32_t index : selected)
+        sorted[starts[ranks[index]]++] = index;
+    return sorted;
+}
+
+std::string DiagnosticsToJson(const AnalysisDiagnostics& diagnostics)
+{
+    std::string json = "{\"counts\": {";
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+    {
+        json += s > 0 ? ", \"" : "\"";
+        json += StageName(static_cast<AnalysisStage>(s));
+        json += "\": " + std::to_string(diagnostics.counts[s]);
+    }
+    json += "}, \"dropped\": " + std::to_string(diagnostics.dropped) + ", \"records\": [";
+
+    std::vector<size_t> order(diagnostics.records.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&diagnostics](size_t a, size_t b)
+    {
+        return diagnostics.records[a].offset < diagnostics.records[b].offset;
+    });
+
+    bool first = true;
+    for (size_t index : order)
+    {
+        const Diagnostic& diagnostic = diagnostics.records[index];
+        json += first ? "\n" : ",\n";
+        json += "  {\"rule\": \"";
+        json += StageName(diagnostic.stage);
+        json += "\", \"offset\": " + std::to_string(diagnostic.offset) + ", \"length\": " + std::to_string(diagnostic.length)
+            + ", \"replacement\": \"";
+        for (unsigned char c : diagnostics.Replacement(diagnostic))
+        {
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += static_cast<char>(c);
+            }
+            else if (c < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                json += buffer;
+            }
+            else
+            {
+                json += static_cast<char>(c);
+            }
+        }
+        json += "\"}";
+        first = false;
+    }
+    json += first ? "]}" : "\n]}";
+    return json;
+}
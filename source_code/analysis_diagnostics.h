@@ -0,0 +1,63 @@
+#pragma once
+
+#include "analyzer.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one fix made by an analysis stage, offset and length are bytes of the analyzed input
+// (before any stage ran), the replacement text is kept in AnalysisDiagnostics::replacements
+struct Diagnostic
+{
+    uint64_t offset;
+    uint32_t length;
+    uint32_t replacementLength;
+    uint64_t replacementStart;
+    AnalysisStage stage; // the rule, reported as StageName(stage)
+};
+
+// fixes of an analysis as compact records, collected when a pointer to it is passed to
+// AnalyzePiece (a null pointer costs one branch per stage)
+// at most capacity records are kept (the vector grows with the fixes found up to it), fixes
+// beyond it are only counted
+struct AnalysisDiagnostics
+{
+    static const size_t DEFAULT_CAPACITY = 100000;
+
+    explicit AnalysisDiagnostics(size_t capacity = DEFAULT_CAPACITY);
+
+    std::vector<Diagnostic> records; // in the order the stages ran, per piece
+    std::string replacements;
+    uint64_t counts[static_cast<int>(AnalysisStage::COUNT)] = {}; // every fix, kept or not
+    uint64_t dropped = 0;
+    size_t capacity;
+
+    void Add(AnalysisStage stage, uint64_t offset, uint32_t length, std::string_view replacement);
+
+    // adds the records and counts of another analysis, its offsets moved by offsetShift
+    void Merge(const AnalysisDiagnostics& other, uint64_t offsetShift = 0);
+
+    std::string_view Replacement(const Diagnostic& diagnostic) const
+    {
+        return std::string_view(replacements.data() + diagnostic.replacementStart, diagnostic.replacementLength);
+    }
+
+    uint64_t Total() const;
+};
+
+// orders SelectDiagnostics can list records in, ties are kept in offset order
+enum class DiagnosticOrder
+{
+    OFFSET,
+    RULE,
+    REPLACEMENT
+};
+
+// indices into diagnostics.records of the records of rule (of every rule for
+// AnalysisStage::COUNT), sorted by order
+std::vector<uint32_t> SelectDiagnostics(const AnalysisDiagnostics& diagnostics, AnalysisStage rule, DiagnosticOrder order);
+
+// per rule counts and the kept records as JSON, the records sorted by offset
+std::string DiagnosticsToJson(const AnalysisDiagnostics& diagnostics);
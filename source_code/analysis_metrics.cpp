@@ -0,0 +1,129 @@
+#include "analysis_metrics.h"
+
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+namespace
+{
+    uint32_t CurrentThreadNumber()
+    {
+        return static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7fffffff);
+    }
+
+    std::string FormatNumber(const char* format, double value)
+    {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), format, value);
+        return buffer;
+    }
+}
+
+void AnalysisMetrics::Merge(const AnalysisMetrics& other)
+{
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+    {
+        stages[s].calls += other.stages[s].calls;
+        stages[s].seconds += other.stages[s].seconds;
+        stages[s].bytes += other.stages[s].bytes;
+        stages[s].fixes += other.stages[s].fixes;
+        stages[s].allocations += other.stages[s].allocations;
+    }
+
+    double shift = std::chrono::duration<double>(other.origin - origin).count();
+    for (const Event& event : other.events)
+    {
+        if (events.size() >= MAX_EVENTS)
+        {
+            ++droppedEvents;
+            continue;
+        }
+        events.push_back(event);
+        events.back().start += shift;
+    }
+    droppedEvents += other.droppedEvents;
+}
+
+void AnalysisMetrics::Record(AnalysisStage stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+                             uint64_t bytes, uint64_t fixes, uint64_t allocations)
+{
+    StageMetrics& totals = stages[static_cast<int>(stage)];
+    double duration = std::chrono::duration<double>(end - start).count();
+    ++totals.calls;
+    totals.seconds += duration;
+    totals.bytes += bytes;
+    totals.fixes += fixes;
+    totals.allocations += allocations;
+
+    if (!recordEvents)
+        return;
+    if (events.size() >= MAX_EVENTS)
+    {
+        ++droppedEvents;
+        return;
+    }
+    events.push_back(Event{ stage, std::chrono::duration<double>(start - origin).count(), duration,
+                            bytes, fixes, allocations, CurrentThreadNumber() });
+}
+
+std::string MetricsToJson(const AnalysisMetrics& metrics)
+{
+    std::string json = "{\n  \"stages\": [\n";
+    double totalSeconds = 0.0;
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+    {
+        const StageMetrics& stage = metrics.stages[s];
+        totalSeconds += stage.seconds;
+        json += "    {\"name\": \"" + std::string(StageName(static_cast<AnalysisStage>(s))) + "\""
+            + ", \"calls\": " + std::to_string(stage.calls)
+            + ", \"seconds\": " + FormatNumber("%.9f", stage.seconds)
+            + ", \"bytes\": " + std::to_string(stage.bytes)
+            + ", \"fixes\": " + std::to_string(stage.fixes)
+            + ", \"allocations\": " + std::to_string(stage.allocations) + "}"
+            + (s + 1 < static_cast<int>(AnalysisStage::COUNT) ? ",\n" : "\n");
+    }
+    json += "  ],\n  \"total_seconds\": " + FormatNumber("%.9f", totalSeconds)
+        + ",\n  \"events\": " + std::to_string(metrics.events.size())
+        + ",\n  \"dropped_events\": " + std::to_string(metrics.droppedEvents) + "\n}\n";
+    return json;
+}
+
+std::string MetricsToChromeTrace(const AnalysisMetrics& metrics)
+{
+    // complete ("X") events, timestamps in microseconds
+    std::string json = "{\"traceEvents\": [\n";
+    for (size_t i = 0; i < metrics.events.size(); ++i)
+    {
+        const AnalysisMetrics::Event& event = metrics.events[i];
+        json += "  {\"name\": \"" + std::string(StageName(event.stage)) + "\", \"cat\": \"analysis\", \"ph\": \"X\""
+            + ", \"ts\": " + FormatNumber("%.3f", event.start * 1e6)
+            + ", \"dur\": " + FormatNumber("%.3f", event.duration * 1e6)
+            + ", \"pid\": 1, \"tid\": " + std::to_string(event.thread)
+            + ", \"args\": {\"bytes\": " + std::to_string(event.bytes)
+            + ", \"fixes\": " + std::to_string(event.fixes)
+            + ", \"allocations\": " + std::to_string(event.allocations) + "}}"
+            + (i + 1 < metrics.events.size() ? ",\n" : "\n");
+    }
+    json += "], \"displayTimeUnit\": \"ms\"}\n";
+    return json;
+}
+
+std::string FormatMetricsTable(const AnalysisMetrics& metrics)
+{
+    std::string table;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-14s %8s %12s %10s %12s %8s %12s\n",
+                  "stage", "calls", "ms", "MB/s", "bytes", "fixes", "allocations");
+    table += line;
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+    {
+        const StageMetrics& stage = metrics.stages[s];
+        double mbPerSecond = stage.seconds > 0 ? stage.bytes / 1e6 / stage.seconds : 0.0;
+        std::snprintf(line, sizeof(line), "%-14s %8llu %12.3f %10.1f %12llu %8llu %12llu\n",
+                      StageName(static_cast<AnalysisStage>(s)), static_cast<unsigned long long>(stage.calls),
+                      stage.seconds * 1e3, mbPerSecond, static_cast<unsigned long long>(stage.bytes),
+                      static_cast<unsigned long long>(stage.fixes), static_cast<unsigned long long>(stage.allocations));
+        table += line;
+    }
+    return table;
+}
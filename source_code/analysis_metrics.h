@@ -0,0 +1,61 @@
+#pragma once
+
+#include "analyzer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// what one stage did over an analysis, summed over every piece it ran on
+struct StageMetrics
+{
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    uint64_t bytes = 0;       // bytes of text the stage was given
+    uint64_t fixes = 0;
+    uint64_t allocations = 0; // heap allocations made by the stage
+};
+
+// per stage measurements of an analysis, collected when a pointer to it is passed to
+// AnalyzePiece (a null pointer costs one branch per stage)
+struct AnalysisMetrics
+{
+    // one stage run, times in seconds since origin
+    struct Event
+    {
+        AnalysisStage stage;
+        double start;
+        double duration;
+        uint64_t bytes;
+        uint64_t fixes;
+        uint64_t allocations;
+        uint32_t thread;
+    };
+
+    // events beyond this many are only summed, not kept for the trace
+    static const size_t MAX_EVENTS = 100000;
+
+    StageMetrics stages[static_cast<int>(AnalysisStage::COUNT)];
+    std::vector<Event> events;
+    uint64_t droppedEvents = 0;
+    bool recordEvents = true;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    // adds the measurements of another analysis, events keep their own thread, their
+    // times are moved to this origin
+    void Merge(const AnalysisMetrics& other);
+
+    // records one stage run, used by AnalyzePiece
+    void Record(AnalysisStage stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+                uint64_t bytes, uint64_t fixes, uint64_t allocations);
+};
+
+// per stage totals as JSON
+std::string MetricsToJson(const AnalysisMetrics& metrics);
+
+// the recorded events in the Chrome trace event format (chrome://tracing, Perfetto)
+std::string MetricsToChromeTrace(const AnalysisMetrics& metrics);
+
+// per stage totals as a plain text table
+std::string FormatMetricsTable(const AnalysisMetrics& metrics);
@@ -0,0 +1,230 @@
+#include "analysis_protocol.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// systems without it have SIGPIPE ignored by the programs instead
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+    void PutNumber(std::string& out, uint32_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    uint32_t GetNumber(const char* data, size_t bytes)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+        return value;
+    }
+
+    uint32_t FloatBits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float BitsFloat(uint32_t bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool ReceiveAll(int socket, char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t received = recv(socket, data, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            data += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    bool FillAddress(const std::string& path, sockaddr_un& address)
+    {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+AnalysisSettings SettingsFromFlags(uint8_t flags)
+{
+    AnalysisSettings settings;
+    settings.capitalizeFirstLetter = (flags & ANALYZE_CAPITALIZE) != 0;
+    settings.fixSpacing = (flags & ANALYZE_SPACING) != 0;
+    settings.capitalizeAfterPeriod = (flags & ANALYZE_AFTER_PERIOD) != 0;
+    settings.codingTerms = (flags & ANALYZE_CODING_TERMS) != 0;
+    settings.suggestSpelling = (flags & ANALYZE_SPELLING) != 0;
+    return settings;
+}
+
+uint8_t FlagsFromSettings(const AnalysisSettings& settings)
+{
+    return (settings.capitalizeFirstLetter ? ANALYZE_CAPITALIZE : 0) | (settings.fixSpacing ? ANALYZE_SPACING : 0)
+        | (settings.capitalizeAfterPeriod ? ANALYZE_AFTER_PERIOD : 0) | (settings.codingTerms ? ANALYZE_CODING_TERMS : 0)
+        | (settings.suggestSpelling ? ANALYZE_SPELLING : 0);
+}
+
+void EncodeRequest(const Request& request, std::string& out)
+{
+    PutNumber(out, static_cast<uint32_t>(REQUEST_HEADER_SIZE + request.text.size()), FRAME_HEADER_SIZE);
+    PutNumber(out, request.id, 4);
+    out += static_cast<char>(request.kind);
+    out += static_cast<char>(request.flags);
+    out += static_cast<char>(request.language);
+    out += '\0';
+    out.append(request.text.data(), request.text.size());
+}
+
+void EncodeResponse(const Response& response, std::string& out)
+{
+    PutNumber(out, static_cast<uint32_t>(RESPONSE_HEADER_SIZE + response.findings.size() + response.text.size()), FRAME_HEADER_SIZE);
+    PutNumber(out, response.id, 4);
+    out += static_cast<char>(response.status);
+    out += static_cast<char>(response.changed ? 1 : 0);
+    PutNumber(out, 0, 2);
+    PutNumber(out, FloatBits(response.likeness), 4);
+    PutNumber(out, static_cast<uint32_t>(response.findings.size()), 4);
+    out.append(response.findings.data(), response.findings.size());
+    out.append(response.text.data(), response.text.size());
+}
+
+bool DecodeRequest(std::string_view payload, Request& request)
+{
+    if (payload.size() < REQUEST_HEADER_SIZE)
+        return false;
+    request.id = GetNumber(payload.data(), 4);
+    request.kind = static_cast<RequestKind>(payload[4]);
+    request.flags = static_cast<uint8_t>(payload[5]);
+    request.language = static_cast<uint8_t>(payload[6]);
+    request.text = payload.substr(REQUEST_HEADER_SIZE);
+    return true;
+}
+
+bool DecodeResponse(std::string_view payload, Response& response)
+{
+    if (payload.size() < RESPONSE_HEADER_SIZE)
+        return false;
+    response.id = GetNumber(payload.data(), 4);
+    response.status = static_cast<ResponseStatus>(payload[4]);
+    response.changed = payload[5] != 0;
+    response.likeness = BitsFloat(GetNumber(payload.data() + 8, 4));
+    uint32_t findingsSize = GetNumber(payload.data() + 12, 4);
+    if (findingsSize > payload.size() - RESPONSE_HEADER_SIZE)
+        return false;
+    response.findings = payload.substr(RESPONSE_HEADER_SIZE, findingsSize);
+    response.text = payload.substr(RESPONSE_HEADER_SIZE + findingsSize);
+    return true;
+}
+
+std::string DefaultSocketPath()
+{
+    const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory && *runtimeDirectory)
+        return std::string(runtimeDirectory) + "/trace.sock";
+    return "/tmp/trace-" + std::to_string(getuid()) + ".sock";
+}
+
+int ListenLocalSocket(const std::string& path, std::string& error)
+{
+    sockaddr_un address;
+    if (!FillAddress(path, address))
+    {
+        error = "socket path too long: " + path;
+        return -1;
+    }
+
+    // a socket file nobody accepts on is left over from a server that did not shut down
+    int probe = ConnectLocalSocket(path);
+    if (probe >= 0)
+    {
+        CloseSocket(probe);
+        error = "a server is already listening at " + path;
+        return -1;
+    }
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0)
+    {
+        error = path + ": " + std::strerror(errno);
+        if (listener >= 0)
+            close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+int ConnectLocalSocket(const std::string& path)
+{
+    sockaddr_un address;
+    if (!FillAddress(path, address))
+        return -1;
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0)
+        return -1;
+    if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+bool SendAll(int socket, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool ReadFrame(int socket, std::string& payload)
+{
+    char header[FRAME_HEADER_SIZE];
+    if (!ReceiveAll(socket, header, sizeof(header)))
+        return false;
+    uint32_t size = GetNumber(header, FRAME_HEADER_SIZE);
+    if (size > MAX_FRAME_SIZE)
+        return false;
+    payload.resize(size);
+    return size == 0 || ReceiveAll(socket, &payload[0], size);
+}
+
+void CloseSocket(int socket)
+{
+    close(socket);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "analyzer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// messages between trace_server and its clients over a Unix domain socket (POSIX only)
+// every message is a frame: its payload length as 4 bytes little-endian, then the payload
+// a request payload is
+//   id (4 bytes), kind (1), flags (1, ANALYZE_* bits), language (1, Language), 0 (1), text
+// and a response payload
+//   id (4 bytes, the request's), status (1), changed (1), 0 (2), likeness (4, float bits),
+//   findings size (4), findings (FormatFindings in the request's language), text (the
+//   corrected text, the counters as JSON for STATS, or what was wrong with the request)
+// numbers are little-endian, ids are chosen by the client and let it send more requests
+// before reading the responses, which may come back in any order
+
+const size_t FRAME_HEADER_SIZE = 4;
+const size_t REQUEST_HEADER_SIZE = 8;
+const size_t RESPONSE_HEADER_SIZE = 16;
+
+// largest payload either side accepts, a larger frame ends the connection
+const size_t MAX_FRAME_SIZE = 64u << 20;
+
+enum class RequestKind : uint8_t
+{
+    ANALYZE = 1,
+    STATS = 2 // the server's counters, the text is ignored
+};
+
+// analysis settings of a request, as in the trace_cli options
+const uint8_t ANALYZE_CAPITALIZE = 1;
+const uint8_t ANALYZE_SPACING = 2;
+const uint8_t ANALYZE_AFTER_PERIOD = 4;
+const uint8_t ANALYZE_CODING_TERMS = 8;
+const uint8_t ANALYZE_SPELLING = 16;
+
+enum class ResponseStatus : uint8_t
+{
+    OK = 0,
+    BAD_REQUEST = 1, // unknown kind, flags or language, the text says which
+    SHUTTING_DOWN = 2
+};
+
+struct Request
+{
+    uint32_t id = 0;
+    RequestKind kind = RequestKind::ANALYZE;
+    uint8_t flags = 0;
+    uint8_t language = 0;
+    std::string_view text; // points into the decoded payload
+};
+
+struct Response
+{
+    uint32_t id = 0;
+    ResponseStatus status = ResponseStatus::OK;
+    bool changed = false;
+    float likeness = 1.0f;
+    std::string_view findings;
+    std::string_view text;
+};
+
+AnalysisSettings SettingsFromFlags(uint8_t flags);
+uint8_t FlagsFromSettings(const AnalysisSettings& settings);
+
+// appends a whole frame (header and payload) to out
+void EncodeRequest(const Request& request, std::string& out);
+void EncodeResponse(const Response& response, std::string& out);
+
+// decode a payload without its frame header, false if it is too short or inconsistent
+bool DecodeRequest(std::string_view payload, Request& request);
+bool DecodeResponse(std::string_view payload, Response& response);
+
+// socket path used when none is given: $XDG_RUNTIME_DIR/trace.sock, else
+// /tmp/trace-<uid>.sock
+std::string DefaultSocketPath();
+
+// a socket listening at path, replacing a socket file left there by a server that is gone;
+// -1 with error set if it could not be created (or another server is listening)
+int ListenLocalSocket(const std::string& path, std::string& error);
+
+// a socket connected to the server at path, -1 if there is none
+int ConnectLocalSocket(const std::string& path);
+
+// sends all of data, false if the connection failed
+bool SendAll(int socket, const char* data, size_t size);
+
+// reads one frame into payload, false at the end of the connection, on an error or for a
+// frame larger than MAX_FRAME_SIZE
+bool ReadFrame(int socket, std::string& payload);
+
+void CloseSocket(int socket);
@@ -0,0 +1,887 @@
+#include "analyzer.h"
+#include "alloc_counter.h"
+#include "analysis_arena.h"
+#include "analysis_diagnostics.h"
+#include "analysis_metrics.h"
+#include "char_classes.h"
+#include "fused_pipeline.h"
+#include "result_cache.h"
+#include "scan_kernels.h"
+#include "utf8_case.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+
+const char* const SPACING_PUNCTUATION = ",.!?;:";
+
+bool NormalizeSpacing(std::string& text, const char* punctuation)
+{
+    const ByteSet punctuationSet(punctuation);
+
+    // text without anything to fix is not copied at all
+    const size_t length = text.size();
+    if (FindSpacingFix(text, 0, punctuationSet) >= length)
+        return false;
+
+    ScratchString scratch;
+    std::string& result = scratch.Get();
+    result.reserve(length + length / 16 + 16);
+
+    bool edited = false;
+    size_t i = 0;
+    while (i < length)
+    {
+        // copies everything up to the next fix at once
+        size_t next = FindSpacingFix(text, i, punctuationSet);
+        result.append(text, i, next - i);
+        i = next;
+        if (i >= length)
+            break;
+
+        unsigned char c = text[i];
+        if (IsSpacingWhitespace(c))
+        {
+            // finds the end of the whitespace run
+            size_t runEnd = SkipWhitespace(text, i + 1);
+
+            if (runEnd < length && punctuationSet.Contains(static_cast<unsigned char>(text[runEnd])))
+            {
+                edited = true; // drops whitespace before punctuation
+            }
+            else if (runEnd - i >= 2)
+            {
+                result += ' ';
+                edited = true;
+            }
+            else
+            {
+                result += c;
+            }
+            i = runEnd;
+        }
+        else
+        {
+            result += c;
+            if (i + 1 < length && IsAsciiLetter(text[i + 1]))
+            {
+                result += ' ';
+                edited = true;
+            }
+            ++i;
+        }
+    }
+
+    // removals and insertions can in rare cases cancel out, so compare before reporting a change
+    if (!edited || result == text)
+        return false;
+
+    text.swap(result);
+    return true;
+}
+
+namespace
+{
+    // bytes ending the word after a period, and the first word of a document
+    const ByteSet AFTER_PERIOD_WORD_END(".,!;");
+    const ByteSet FIRST_WORD_END(" ,.!;\n");
+    const ByteSet PERIOD(".");
+    const ByteSet NO_STOPS("");
+
+    // capitalizes the word starting after the whitespace at position j (the word after a period)
+    // returns true if a letter was changed
+    bool CapitalizeWordAfterPeriod(std::string& text, size_t j, const RulePack& rules, bool codingTerms)
+    {
+        size_t nextWordStart = SkipWhitespace(text, j);
+        size_t wordEnd = FindWordEnd(text, nextWordStart, AFTER_PERIOD_WORD_END);
+
+        std::string_view word(text.data() + nextWordStart, wordEnd - nextWordStart);
+        if (IsLowerLetter(word) && (!codingTerms || !rules.IsCodingTerm(word)))
+            return CapitalizeLetter(&text[nextWordStart], word.size());
+        return false;
+    }
+
+    // the whitespace separated token around position i, pieces start with a token
+    std::string_view TokenAt(std::string_view text, size_t i)
+    {
+        size_t start = i;
+        while (start > 0 && !IsSpacingWhitespace(text[start - 1])) --start;
+        return text.substr(start, FindWordEnd(text, i, NO_STOPS) - start);
+    }
+
+    // the spelling pass leaves shorter words alone and allows one edit up to
+    // SPELLING_ONE_EDIT_LENGTH characters, two above that
+    const size_t SPELLING_MIN_LENGTH = 4;
+    const size_t SPELLING_ONE_EDIT_LENGTH = 5;
+    const size_t SPELLING_CACHE_LIMIT = 1 << 16;
+
+    // suggestions for the words this thread looked up last, a text repeats most of its words;
+    // kept for one version of one index and dropped whole when it grows too big
+    struct SpellingCache
+    {
+        const SpellingIndex* index = nullptr;
+        uint64_t version = 0;
+        std::unordered_map<std::string, std::string> suggestions; // empty for listed words
+    };
+
+    SpellingCache& ThreadSpellingCache(const SpellingIndex& index)
+    {
+        thread_local SpellingCache cache;
+        if (cache.index != &index || cache.version != index.Version() || cache.suggestions.size() >= SPELLING_CACHE_LIMIT)
+        {
+            cache.index = &index;
+            cache.version = index.Version();
+            cache.suggestions.clear();
+        }
+        return cache;
+    }
+
+    // printable ASCII that is neither a letter nor a digit, stripped from the ends of words
+    bool IsAsciiPunctuation(unsigned char c)
+    {
+        return c > ' ' && c < 0x7F && !IsAsciiLetter(c) && (c < '0' || c > '9');
+    }
+
+    // length in characters of a word made of lower-case letters only, 0 for anything else
+    size_t LowerWordLength(std::string_view word)
+    {
+        size_t length = 0;
+        size_t i = 0;
+        while (i < word.size())
+        {
+            if (!IsLowerLetter(word.substr(i)))
+                return 0;
+            unsigned char lead = word[i];
+            i += lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+            ++length;
+        }
+        return length;
+    }
+
+    // replaces each lower-case word of text missing from the word list by its suggestion,
+    // words are the whitespace separated tokens without the ASCII punctuation around them;
+    // capitalized words, words with digits or apostrophes, coding terms and abbreviations
+    // are kept; returns the number of words replaced
+    size_t FixSpelling(std::string& text, const RulePack& rules, bool codingTerms)
+    {
+        const SpellingIndex& index = rules.Spelling();
+        if (index.Empty())
+            return 0;
+        SpellingCache& cache = ThreadSpellingCache(index);
+
+        ScratchString scratch;
+        std::string& result = scratch.Get(); // only written once a word is replaced
+        size_t copied = 0;
+        size_t fixes = 0;
+        const size_t length = text.size();
+        size_t i = SkipWhitespace(text, 0);
+        while (i < length)
+        {
+            size_t tokenStart = i;
+            i = FindWordEnd(text, i, NO_STOPS);
+            std::string_view token(text.data() + tokenStart, i - tokenStart);
+            i = SkipWhitespace(text, i);
+
+            size_t start = 0;
+            size_t end = token.size();
+            while (start < end && IsAsciiPunctuation(token[start])) ++start;
+            while (end > start && IsAsciiPunctuation(token[end - 1])) --end;
+            std::string_view word = token.substr(start, end - start);
+
+            size_t characters = LowerWordLength(word);
+            if (characters < SPELLING_MIN_LENGTH || (codingTerms && rules.IsCodingTerm(word)) || rules.IsAbbreviation(token))
+                continue;
+
+            auto cached = cache.suggestions.find(std::string(word));
+            if (cached == cache.suggestions.end())
+            {
+                std::string_view suggestion = index.Suggest(word, characters <= SPELLING_ONE_EDIT_LENGTH ? 1 : 2);
+                cached = cache.suggestions.emplace(std::string(word), std::string(suggestion)).first;
+            }
+            if (cached->second.empty())
+                continue;
+
+            if (result.empty())
+                result.reserve(length + length / 16);
+            result.append(text, copied, word.data() - text.data() - copied);
+            result += cached->second;
+            copied = word.data() + word.size() - text.data();
+            ++fixes;
+        }
+
+        if (fixes > 0)
+        {
+            result.append(text, copied, std::string::npos);
+            text.swap(result);
+        }
+        return fixes;
+    }
+
+    // an edit of one stage with its position in the text before and after the stage
+    struct StageEdit
+    {
+        size_t before;
+        size_t removed;
+        size_t after;
+        size_t inserted;
+    };
+
+    // maps an offset in the text after a stage to the text before it, offsets inside an
+    // inserted range go to the start (or with toEnd to the end) of the range it replaced
+    size_t MapBeforeStage(const std::vector<StageEdit>& edits, size_t offset, bool toEnd)
+    {
+        auto next = std::upper_bound(edits.begin(), edits.end(), offset,
+                                     [](size_t value, const StageEdit& edit) { return value < edit.after; });
+        if (next == edits.begin())
+            return offset;
+        const StageEdit& edit = *(next - 1);
+        if (toEnd && offset == edit.after)
+            return edit.before;
+        if (offset < edit.after + edit.inserted)
+            return toEnd ? edit.before + edit.removed : edit.before;
+        return offset - (edit.after + edit.inserted) + edit.before + edit.removed;
+    }
+
+    // records what one stage changed in a piece as diagnostics with offsets in the input,
+    // going back through the stages that ran before it and changed the length of the text
+    void RecordStageDiagnostics(AnalysisStage stage, const std::string& before, const std::string& after, uint64_t inputOffset,
+                                std::vector<std::vector<StageEdit>>& earlierStages, AnalysisDiagnostics& diagnostics)
+    {
+        if (before == after)
+            return;
+
+        std::vector<StageEdit> stageEdits;
+        bool lengthChanged = false;
+        size_t shift = 0; // growth of the text before the current edit, may wrap around
+        for (const TextEdit& edit : DiffText(before, after))
+        {
+            size_t start = edit.offset;
+            size_t end = edit.offset + edit.removed.size();
+            for (auto earlier = earlierStages.rbegin(); earlier != earlierStages.rend(); ++earlier)
+            {
+                start = MapBeforeStage(*earlier, start, false);
+                end = MapBeforeStage(*earlier, end, true);
+            }
+            diagnostics.Add(stage, inputOffset + start, static_cast<uint32_t>(end - start), edit.inserted);
+
+            stageEdits.push_back(StageEdit{ edit.offset, edit.removed.size(), edit.offset + shift, edit.inserted.size() });
+            shift += edit.inserted.size() - edit.removed.size();
+            lengthChanged = lengthChanged || edit.inserted.size() != edit.removed.size();
+        }
+        // same length replacements keep every offset where it is
+        if (lengthChanged)
+            earlierStages.push_back(std::move(stageEdits));
+    }
+
+    // true if text ends with a period followed only by whitespace that is not part of an
+    // abbreviation, the next word then belongs to the following piece; unknown (whitespace
+    // only text) keeps the previous value
+    bool EndsWithPendingPeriod(const std::string& text, const RulePack& rules, bool previous)
+    {
+        size_t i = text.length();
+        while (i > 0 && IsSpacingWhitespace(text[i - 1])) --i;
+        if (i == 0)
+            return previous;
+        return text[i - 1] == '.' && !rules.IsAbbreviation(TokenAt(text, i - 1));
+    }
+}
+
+const char* StageName(AnalysisStage stage)
+{
+    switch (stage)
+    {
+    case AnalysisStage::FIRST_LETTER: return "first_letter";
+    case AnalysisStage::SPACING: return "spacing";
+    case AnalysisStage::AFTER_PERIOD: return "after_period";
+    case AnalysisStage::SENTENCE_CASE: return "sentence_case";
+    case AnalysisStage::TYPOS: return "typos";
+    case AnalysisStage::SPELLING: return "spelling";
+    default: return "unknown";
+    }
+}
+
+bool StageEnabled(AnalysisStage stage, const AnalysisSettings& settings)
+{
+    switch (stage)
+    {
+    case AnalysisStage::FIRST_LETTER: return settings.capitalizeFirstLetter;
+    case AnalysisStage::SPACING: return settings.fixSpacing;
+    case AnalysisStage::AFTER_PERIOD: return settings.capitalizeAfterPeriod;
+    case AnalysisStage::SENTENCE_CASE: return settings.capitalizeFirstLetter && !settings.codingTerms;
+    case AnalysisStage::TYPOS: return true;
+    case AnalysisStage::SPELLING: return settings.suggestSpelling;
+    default: return false;
+    }
+}
+
+size_t RunStage(AnalysisStage stage, std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state)
+{
+    size_t fixes = 0;
+
+    switch (stage)
+    {
+    case AnalysisStage::FIRST_LETTER:
+    {
+        // checks if the first word should be capitalized
+        if (!state.documentStart || text.empty())
+            break;
+
+        // extracts the first word
+        std::string_view firstWord(text.data(), FindFirstOf(text, 0, FIRST_WORD_END));
+
+        // checks if the first word is a coding term
+        bool isCodingTerm = rules.IsCodingTerm(firstWord);
+
+        // capitalize the first letter if it's not a coding term
+        if (!(settings.codingTerms && isCodingTerm) && CapitalizeLetter(&text[0], text.size()))
+        {
+            state.firstLetterFixed = true;
+            ++fixes;
+        }
+        break;
+    }
+
+    case AnalysisStage::SPACING:
+        // process the entire text
+        if (NormalizeSpacing(text, SPACING_PUNCTUATION))
+        {
+            state.spacingFixed = true;
+            ++fixes;
+        }
+        break;
+
+    case AnalysisStage::AFTER_PERIOD:
+    {
+        // a period at the end of the previous piece refers to the first word here
+        if (state.periodPending && CapitalizeWordAfterPeriod(text, 0, rules, settings.codingTerms))
+            ++fixes;
+
+        const bool abbreviations = rules.HasAbbreviations();
+        for (size_t i = FindFirstOf(text, 0, PERIOD); i + 1 < text.length(); i = FindFirstOf(text, i + 1, PERIOD))
+        {
+            if (abbreviations)
+            {
+                // the periods of an abbreviation end neither a word nor a sentence
+                std::string_view token = TokenAt(text, i);
+                if (rules.IsAbbreviation(token))
+                {
+                    i = token.data() + token.size() - text.data() - 1;
+                    continue;
+                }
+            }
+            if (CapitalizeWordAfterPeriod(text, i + 1, rules, settings.codingTerms))
+                ++fixes;
+        }
+        state.afterPeriodFixes += fixes;
+        state.periodPending = EndsWithPendingPeriod(text, rules, state.periodPending);
+        break;
+    }
+
+    case AnalysisStage::SENTENCE_CASE:
+    {
+        // capitalizes the first letter of each sentence unless it's a coding term
+        // the words are moved down in place, each followed by one space, the result is at
+        // most one byte longer than the text (the space after the last word)
+        size_t write = 0;
+        size_t read = 0;
+        bool newSentence = state.newSentence; // flag to see if a new sentence starts
+        const size_t length = text.size();
+        while (true)
+        {
+            read = SkipWhitespace(text, read);
+            if (read >= length)
+                break;
+            size_t wordStart = read;
+            read = FindWordEnd(text, read, NO_STOPS);
+            std::string_view word(text.data() + wordStart, read - wordStart);
+
+            if (newSentence && !rules.IsCodingTerm(word))
+            {
+                if (CapitalizeLetter(&text[wordStart], word.size()))
+                    ++fixes;
+            }
+            // assumes sentence ends with a period
+            newSentence = word.back() == '.' && !rules.IsAbbreviation(word);
+
+            if (write != wordStart)
+                std::copy(text.begin() + wordStart, text.begin() + read, text.begin() + write);
+            write += read - wordStart;
+            if (write < length)
+                text[write] = ' '; // over whitespace that was already read
+            else
+                text.push_back(' '); // the last word had no whitespace after it
+            ++write;
+            read = std::max(read, write);
+        }
+        state.newSentence = newSentence;
+        text.resize(write);
+        break;
+    }
+
+    case AnalysisStage::TYPOS:
+    {
+        // fixes typos from the dictionary, each entry that was used lowers likeness once
+        fixes = rules.Typos().Apply(text, &state.typoEntriesUsed);
+        if (fixes > 0)
+        {
+            // sorted rather than merged, std::inplace_merge allocates a buffer on every call
+            std::sort(state.typoEntriesUsed.begin(), state.typoEntriesUsed.end());
+            state.typoEntriesUsed.erase(std::unique(state.typoEntriesUsed.begin(), state.typoEntriesUsed.end()), state.typoEntriesUsed.end());
+        }
+        break;
+    }
+
+    case AnalysisStage::SPELLING:
+        fixes = FixSpelling(text, rules, settings.codingTerms);
+        state.spellingFixes += fixes;
+        break;
+
+    default:
+        break;
+    }
+    return fixes;
+}
+
+namespace
+{
+    // runs the enabled stages over text, diagnostics get offsets from state.inputOffset
+    // without metrics and diagnostics nothing is needed between the stages, so they run fused
+    void RunStages(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                   AnalysisMetrics* metrics, AnalysisDiagnostics* diagnostics)
+    {
+        if (!metrics && !diagnostics)
+        {
+            RunFusedStages(text, settings, rules, state);
+            state.documentStart = false;
+            return;
+        }
+
+        ScratchString scratch;
+        std::string& before = scratch.Get(); // text before the current stage, only kept for diagnostics
+        std::vector<std::vector<StageEdit>> earlierStages;
+
+        for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+        {
+            AnalysisStage stage = static_cast<AnalysisStage>(s);
+            if (!StageEnabled(stage, settings))
+                continue;
+
+            if (diagnostics)
+                before = text;
+
+            if (!metrics)
+            {
+                RunStage(stage, text, settings, rules, state);
+            }
+            else
+            {
+                size_t bytes = text.size();
+                uint64_t allocationsBefore = ThreadAllocationCount();
+                auto start = std::chrono::steady_clock::now();
+                size_t fixes = RunStage(stage, text, settings, rules, state);
+                auto end = std::chrono::steady_clock::now();
+                metrics->Record(stage, start, end, bytes, fixes, ThreadAllocationCount() - allocationsBefore);
+            }
+
+            if (diagnostics)
+                RecordStageDiagnostics(stage, before, text, state.inputOffset, earlierStages, *diagnostics);
+        }
+        state.documentStart = false;
+    }
+
+    // analyzes the prose blocks of text one by one and copies the code blocks
+    void RunStagesOnProse(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                          AnalysisMetrics* metrics, AnalysisDiagnostics* diagnostics)
+    {
+        std::vector<TextBlock> blocks = ClassifyBlocks(text, state.blocks);
+        if (blocks.size() == 1 && blocks[0].kind == BlockKind::PROSE)
+        {
+            RunStages(text, settings, rules, state, metrics, diagnostics);
+            return;
+        }
+
+        const uint64_t pieceOffset = state.inputOffset;
+        ScratchString resultScratch;
+        ScratchString proseScratch;
+        std::string& result = resultScratch.Get();
+        result.reserve(text.size() + text.size() / 16);
+        std::string& prose = proseScratch.Get();
+        for (const TextBlock& block : blocks)
+        {
+            if (block.kind == BlockKind::CODE)
+            {
+                result.append(text, block.offset, block.length);
+                state.periodPending = false;
+                state.newSentence = true;
+                continue;
+            }
+            prose.assign(text, block.offset, block.length);
+            state.inputOffset = pieceOffset + block.offset;
+            RunStages(prose, settings, rules, state, metrics, diagnostics);
+            result += prose;
+        }
+        state.inputOffset = pieceOffset;
+        text.swap(result);
+    }
+}
+
+void AnalyzePiece(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                  AnalysisMetrics* metrics, AnalysisDiagnostics* diagnostics)
+{
+    if (text.empty())
+        return;
+
+    const size_t inputLength = text.size();
+    if (settings.codingTerms)
+        RunStagesOnProse(text, settings, rules, state, metrics, diagnostics);
+    else
+        RunStages(text, settings, rules, state, metrics, diagnostics);
+    state.inputOffset += inputLength;
+}
+
+void MergeFindings(AnalysisState& state, const AnalysisState& piece)
+{
+    state.firstLetterFixed = state.firstLetterFixed || piece.firstLetterFixed;
+    state.spacingFixed = state.spacingFixed || piece.spacingFixed;
+    state.afterPeriodFixes += piece.afterPeriodFixes;
+    state.spellingFixes += piece.spellingFixes;
+    if (piece.typoEntriesUsed.empty())
+        return;
+
+    std::vector<int> entries;
+    entries.reserve(state.typoEntriesUsed.size() + piece.typoEntriesUsed.size());
+    std::set_union(state.typoEntriesUsed.begin(), state.typoEntriesUsed.end(), piece.typoEntriesUsed.begin(),
+                   piece.typoEntriesUsed.end(), std::back_inserter(entries));
+    state.typoEntriesUsed.swap(entries);
+}
+
+std::vector<std::pair<AnalysisStage, size_t>> CountFindings(const AnalysisState& state)
+{
+    std::vector<std::pair<AnalysisStage, size_t>> findings;
+    if (state.firstLetterFixed)
+        findings.emplace_back(AnalysisStage::FIRST_LETTER, 1);
+    if (state.spacingFixed)
+        findings.emplace_back(AnalysisStage::SPACING, 1);
+    if (state.afterPeriodFixes > 0)
+        findings.emplace_back(AnalysisStage::AFTER_PERIOD, state.afterPeriodFixes);
+    if (state.spellingFixes > 0)
+        findings.emplace_back(AnalysisStage::SPELLING, state.spellingFixes);
+    return findings;
+}
+
+std::vector<std::pair<std::string, size_t>> CountMessages(const AnalysisState& state)
+{
+    std::vector<std::pair<std::string, size_t>> messages;
+    for (const auto& finding : CountFindings(state))
+        messages.emplace_back(FindingMessage(finding.first, Language::ENGLISH), finding.second);
+    if (ComputeLikeness(state) != 1.0f)
+        messages.emplace_back(CompletedMessage(Language::ENGLISH), 1);
+    return messages;
+}
+
+const char* FindingMessage(AnalysisStage stage, Language language)
+{
+    switch (stage)
+    {
+    case AnalysisStage::FIRST_LETTER:
+        switch (language)
+        {
+        case Language::SPANISH: return "Se convirtió la primera letra en mayúscula.";
+        case Language::FRENCH: return "La première lettre a été mise en majuscule.";
+        case Language::POLISH: return "Zamieniono pierwszą literę na wielką.";
+        default: return "Converted the first letter to uppercase.";
+        }
+    case AnalysisStage::SPACING:
+        switch (language)
+        {
+        case Language::SPANISH: return "Se corrigieron los espacios alrededor de la puntuación.";
+        case Language::FRENCH: return "Les espaces autour de la ponctuation ont été corrigés.";
+        case Language::POLISH: return "Poprawiono odstępy wokół znaków interpunkcyjnych.";
+        default: return "Fixed spaces around punctuation.";
+        }
+    case AnalysisStage::AFTER_PERIOD:
+        switch (language)
+        {
+        case Language::SPANISH: return "Mayúscula después del punto.";
+        case Language::FRENCH: return "Majuscule après un point.";
+        case Language::POLISH: return "Wielka litera po kropce.";
+        default: return "Capitalized after period.";
+        }
+    case AnalysisStage::SENTENCE_CASE:
+        switch (language)
+        {
+        case Language::SPANISH: return "Mayúscula al comienzo de la oración.";
+        case Language::FRENCH: return "Majuscule en début de phrase.";
+        case Language::POLISH: return "Wielka litera na początku zdania.";
+        default: return "Capitalized the start of a sentence.";
+        }
+    case AnalysisStage::TYPOS:
+        switch (language)
+        {
+        case Language::SPANISH: return "Se corrigió un error tipográfico.";
+        case Language::FRENCH: return "Une faute de frappe a été corrigée.";
+        case Language::POLISH: return "Poprawiono literówkę.";
+        default: return "Fixed a typo.";
+        }
+    case AnalysisStage::SPELLING:
+        switch (language)
+        {
+        case Language::SPANISH: return "Se corrigió la ortografía de una palabra.";
+        case Language::FRENCH: return "L'orthographe d'un mot a été corrigée.";
+        case Language::POLISH: return "Poprawiono pisownię wyrazu.";
+        default: return "Corrected the spelling of a word.";
+        }
+    default:
+        return "";
+    }
+}
+
+const char* CompletedMessage(Language language)
+{
+    switch (language)
+    {
+    case Language::SPANISH: return "Análisis de texto completado.";
+    case Language::FRENCH: return "Analyse du texte terminée.";
+    case Language::POLISH: return "Analiza tekstu zakończona.";
+    default: return "Text analysis completed.";
+    }
+}
+
+float ComputeLikeness(const AnalysisState& state)
+{
+    size_t fixes = (state.firstLetterFixed ? 1 : 0) + (state.spacingFixed ? 1 : 0)
+        + state.afterPeriodFixes + state.typoEntriesUsed.size() + state.spellingFixes;
+
+    float result = 1.0f;
+    for (size_t i = 0; i < fixes; ++i)
+        result -= 0.1f;
+    return result;
+}
+
+AnalysisReport FinishAnalysis(const AnalysisState& state)
+{
+    AnalysisReport report;
+    report.initialLikeness = 1.0f;
+    report.likeness = ComputeLikeness(state);
+    report.likenessChange = report.initialLikeness - report.likeness;
+    report.findings = CountFindings(state);
+    return report;
+}
+
+std::string FormatFindings(const AnalysisReport& report, Language language)
+{
+    std::string text;
+    for (const auto& finding : report.findings)
+    {
+        text += FindingMessage(finding.first, language);
+        if (finding.second > 1)
+            text += " (x" + std::to_string(finding.second) + ")";
+        text += "\n";
+    }
+    if (report.likeness != 1.0f)
+    {
+        text += CompletedMessage(language);
+        text += "\n";
+    }
+    return text;
+}
+
+AnalysisReport SprawdzPostawiene(std::string& text, bool capitalizeFirstLetter, bool fixSpacing, bool capitalizeAfterPeriod, bool codingTerms,
+                              const RulePack& rules, bool suggestSpelling)
+{
+    AnalysisSettings settings{ capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms, suggestSpelling };
+    AnalysisState state;
+    AnalyzePiece(text, settings, rules, state);
+    return FinishAnalysis(state);
+}
+
+size_t FindPieceCut(std::string_view text, size_t limit, const AnalysisSettings& settings)
+{
+    // a cut is safe before a word that follows whitespace: no pass looks across it except
+    // through AnalysisState, the word must not start with punctuation the spacing pass joins
+    // with codingTerms the cut must not change the whitespace between a prose and a code
+    // block (see ClassifyBlocks): it goes after a single '\n' ending a line whose kind does
+    // not depend on the next line, so the next piece starts with a whole line, or if the
+    // chunk has none inside a line
+    auto isSafeCut = [&text, &settings](size_t k)
+    {
+        unsigned char c = text[k];
+        if (!IsSpacingWhitespace(text[k - 1]) || IsSpacingWhitespace(c) || std::strchr(SPACING_PUNCTUATION, c) != nullptr)
+            return false;
+        if (!settings.codingTerms)
+            return true;
+        size_t start = k - 1;
+        while (start > 0 && IsSpacingWhitespace(text[start]) && text[start] != '\n') --start;
+        return text[start] != '\n' && !IsSpacingWhitespace(text[start]);
+    };
+
+    if (settings.codingTerms)
+    {
+        // the last line of the piece is classified without the one after it
+        for (size_t k = limit - 1; k > 1; --k)
+        {
+            if (text[k - 1] != '\n' || IsSpacingWhitespace(text[k - 2]) || IsSpacingWhitespace(text[k])
+                || std::strchr(SPACING_PUNCTUATION, text[k]) != nullptr)
+                continue;
+            size_t lineStart = text.rfind('\n', k - 2);
+            lineStart = lineStart == std::string_view::npos ? 0 : lineStart + 1;
+            if (!LineNeedsNextLine(text.substr(lineStart, k - lineStart)))
+                return k;
+        }
+    }
+
+    // prefers the last sentence boundary in the second half of the chunk, then any word boundary
+    size_t wordCut = 0;
+    for (size_t k = limit - 1; k > 0; --k)
+    {
+        if (!isSafeCut(k))
+            continue;
+        if (wordCut == 0)
+            wordCut = k;
+
+        size_t end = k - 1;
+        while (end > 0 && IsSpacingWhitespace(text[end])) --end;
+        char terminator = text[end];
+        if (terminator == '.' || terminator == '!' || terminator == '?')
+            return k;
+        if (k < limit / 2 && wordCut != 0)
+            return wordCut;
+    }
+
+    // a single token longer than the chunk is split as is
+    return wordCut != 0 ? wordCut : limit;
+}
+
+StreamAnalyzer::StreamAnalyzer(const AnalysisSettings& settings, Output output, const RulePack& rules, size_t chunkSize)
+    : settings(settings), output(std::move(output)), rules(rules), chunkSize(chunkSize < 64 ? 64 : chunkSize)
+{
+    buffer.reserve(this->chunkSize * 2);
+}
+
+void StreamAnalyzer::Write(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        // never holds more than two chunks of input
+        size_t room = chunkSize * 2 - buffer.size();
+        size_t take = size < room ? size : room;
+        buffer.append(data, take);
+        data += take;
+        size -= take;
+
+        while (buffer.size() >= chunkSize)
+            AnalyzeFront(FindPieceCut(buffer, chunkSize, settings));
+    }
+}
+
+void StreamAnalyzer::Finish()
+{
+    if (!buffer.empty())
+        AnalyzeFront(buffer.size());
+}
+
+void StreamAnalyzer::AnalyzeFront(size_t length)
+{
+    piece.assign(buffer, 0, length);
+    if (cache && !metrics)
+        AnalyzePieceCached(piece, settings, rules, state, *cache, diagnostics);
+    else
+        AnalyzePiece(piece, settings, rules, state, metrics, diagnostics);
+    if (!changed && piece.compare(0, std::string::npos, buffer, 0, length) != 0)
+        changed = true;
+
+    buffer.erase(0, length);
+    bytesIn += length;
+    bytesOut += piece.size();
+    if (!piece.empty())
+        output(piece);
+}
+
+bool AnalyzeInChunks(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                     const std::function<bool(size_t, size_t)>& progress, AnalysisMetrics* metrics, AnalysisDiagnostics* diagnostics,
+                     ResultCache* cache)
+{
+    std::string result;
+    result.reserve(text.size() + text.size() / 16);
+
+    StreamAnalyzer analyzer(settings, [&result](const std::string& piece) { result += piece; }, rules);
+    analyzer.SetMetrics(metrics);
+    analyzer.SetDiagnostics(diagnostics);
+    analyzer.SetCache(cache);
+    const size_t chunkSize = StreamAnalyzer::DEFAULT_CHUNK_SIZE;
+    for (size_t done = 0; done < text.size();)
+    {
+        size_t length = text.size() - done < chunkSize ? text.size() - done : chunkSize;
+        analyzer.Write(text.data() + done, length);
+        done += length;
+        if (!progress(done, text.size()))
+            return false;
+    }
+    analyzer.Finish();
+
+    state = analyzer.State();
+    text.swap(result);
+    return true;
+}
+
+bool AnalyzeDocument(const PieceTable& document, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                     std::vector<TextEdit>& edits, const std::function<bool(size_t, size_t)>& progress, AnalysisMetrics* metrics,
+                     AnalysisDiagnostics* diagnostics, ResultCache* cache)
+{
+    std::vector<TextEdit> found;
+    std::string original; // the input of the piece just analyzed, reused
+    size_t pieceStart = 0;
+
+    // each output piece is the corrected text of the input from pieceStart up to BytesIn()
+    auto addEdits = [&](const std::string& corrected, size_t pieceEnd)
+    {
+        original.clear();
+        document.Read(pieceStart, pieceEnd - pieceStart, original);
+        if (original != corrected)
+        {
+            for (TextEdit& edit : DiffText(original, corrected))
+            {
+                edit.offset += pieceStart;
+                found.push_back(std::move(edit));
+            }
+        }
+        pieceStart = pieceEnd;
+    };
+    StreamAnalyzer* streamAnalyzer = nullptr;
+    StreamAnalyzer analyzer(settings, [&](const std::string& corrected)
+    {
+        addEdits(corrected, static_cast<size_t>(streamAnalyzer->BytesIn()));
+    }, rules);
+    streamAnalyzer = &analyzer;
+    analyzer.SetMetrics(metrics);
+    analyzer.SetDiagnostics(diagnostics);
+    analyzer.SetCache(cache);
+
+    const size_t chunkSize = StreamAnalyzer::DEFAULT_CHUNK_SIZE;
+    size_t done = 0;
+    for (std::string_view view : document.Views())
+    {
+        while (!view.empty())
+        {
+            size_t length = view.size() < chunkSize ? view.size() : chunkSize;
+            analyzer.Write(view.data(), length);
+            view.remove_prefix(length);
+            done += length;
+            if (!progress(done, document.Size()))
+                return false;
+        }
+    }
+    analyzer.Finish();
+
+    // empty corrected pieces are not output, the input after the last output piece was
+    // then removed (an empty piece in between is covered by the diff of the next one)
+    if (pieceStart < analyzer.BytesIn())
+        addEdits(std::string(), static_cast<size_t>(analyzer.BytesIn()));
+
+    state = analyzer.State();
+    edits.swap(found);
+    return true;
+}
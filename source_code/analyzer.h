@@ -0,0 +1,206 @@
+#pragma once
+
+#include "block_classifier.h"
+#include "piece_table.h"
+#include "rule_pack.h"
+#include "text_edit.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct AnalysisDiagnostics;
+struct AnalysisMetrics;
+class ResultCache;
+
+// punctuation handled by the spacing pass, ",." alone gives the same output as the old regex version
+extern const char* const SPACING_PUNCTUATION;
+
+// fixes spacing around punctuation in one linear pass, without regex:
+//  - whitespace directly before punctuation is removed
+//  - a space is inserted between punctuation and a following letter
+//  - runs of two or more whitespace characters become a single space
+// the result is written into one preallocated buffer and swapped into text
+// returns true if the text was changed
+bool NormalizeSpacing(std::string& text, const char* punctuation);
+
+// analysis options chosen in the settings dialog
+struct AnalysisSettings
+{
+    bool capitalizeFirstLetter = false;
+    bool fixSpacing = false;
+    bool capitalizeAfterPeriod = false;
+    bool codingTerms = false; // also leaves the code blocks found by ClassifyBlocks untouched
+    bool suggestSpelling = false; // replaces words missing from the word list (see RulePack::Spelling)
+};
+
+// state carried from one piece of a document to the next, and what was fixed so far
+struct AnalysisState
+{
+    bool documentStart = true;  // nothing analyzed yet, the first letter pass still applies
+    bool periodPending = false; // text so far ends with a period, the next word follows it
+    bool newSentence = true;    // the next word starts a sentence
+    uint64_t inputOffset = 0;   // bytes of input analyzed before the current piece
+    BlockClassifierState blocks; // code blocks crossing pieces, used with codingTerms
+
+    bool firstLetterFixed = false;
+    bool spacingFixed = false;
+    size_t afterPeriodFixes = 0;
+    std::vector<int> typoEntriesUsed; // sorted, each entry lowers likeness once
+    size_t spellingFixes = 0;
+};
+
+// the passes of AnalyzePiece, in the order they run
+enum class AnalysisStage
+{
+    FIRST_LETTER,  // capitalizes the first letter of the document
+    SPACING,       // NormalizeSpacing
+    AFTER_PERIOD,  // capitalizes the word after each period
+    SENTENCE_CASE, // re-joins the words with single spaces, capitalizing sentence starts
+    TYPOS,         // dictionary typo fixes
+    SPELLING,      // closest listed word for each unknown lower-case word
+    COUNT
+};
+
+// short name of a stage used in reports, e.g. "after_period"
+const char* StageName(AnalysisStage stage);
+
+// true if AnalyzePiece runs the stage with these settings
+bool StageEnabled(AnalysisStage stage, const AnalysisSettings& settings);
+
+// runs one stage on text and records what it fixed in state, like AnalyzePiece does
+// (FIRST_LETTER only acts while state.documentStart is set, AnalyzePiece clears it)
+// returns the number of fixes made
+size_t RunStage(AnalysisStage stage, std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state);
+
+// analyzes and fixes one piece of a document in place, updating state
+// pieces must be split right before a word that follows whitespace (see StreamAnalyzer),
+// then analyzing them in order gives the same text as analyzing the whole document
+// rules holds the typos, abbreviations and coding terms of the text's language (see RulePackFor)
+// per stage measurements are added to metrics and every fix to diagnostics if they are not null
+// with settings.codingTerms only the prose blocks are analyzed, code blocks are kept as they
+// are and end a sentence
+void AnalyzePiece(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                  AnalysisMetrics* metrics = nullptr, AnalysisDiagnostics* diagnostics = nullptr);
+
+// adds the findings of a piece analyzed from its own AnalysisState to those in state, whose
+// sentence state is left as it is
+void MergeFindings(AnalysisState& state, const AnalysisState& piece);
+
+// stages with a message in the report of a finished document and how many times each is
+// reported, in report order
+std::vector<std::pair<AnalysisStage, size_t>> CountFindings(const AnalysisState& state);
+
+// analysis messages of a finished document in English with how many times each was reported
+std::vector<std::pair<std::string, size_t>> CountMessages(const AnalysisState& state);
+
+// UTF-8 message reported for fixes of a stage
+const char* FindingMessage(AnalysisStage stage, Language language);
+
+// UTF-8 message ending the report of a text that had anything fixed
+const char* CompletedMessage(Language language);
+
+// likeness score of a finished document, every fix lowers it by 0.1
+float ComputeLikeness(const AnalysisState& state);
+
+// result of one analysis, returned by value so concurrent analyses share nothing
+// the messages are only turned into text by FormatFindings when they are shown
+struct AnalysisReport
+{
+    std::vector<std::pair<AnalysisStage, size_t>> findings; // see CountFindings
+    float likeness = 1.0f;
+    float initialLikeness = 1.0f;
+    float likenessChange = 0.0f;
+};
+
+// builds the report of a finished document
+AnalysisReport FinishAnalysis(const AnalysisState& state);
+
+// the report messages in the language, one line per kind with its count, e.g.
+// "Capitalized after period. (x12)", empty if nothing was fixed
+std::string FormatFindings(const AnalysisReport& report, Language language);
+
+// analyzes and fixes text according to the settings, TextAnalyzer (text_analyzer.h) does the
+// same for a string_view and returns the corrected text with the report
+AnalysisReport SprawdzPostawiene(std::string& text, bool capitalizeFirstLetter, bool fixSpacing, bool capitalizeAfterPeriod, bool codingTerms,
+                              const RulePack& rules = DefaultRulePack(), bool suggestSpelling = false);
+
+// where the first limit bytes of text (limit <= text.size()) are best cut into two pieces
+// that AnalyzePiece can analyze one after the other: the last sentence end in the second
+// half, else the last word boundary, else limit for a single token longer than limit
+size_t FindPieceCut(std::string_view text, size_t limit, const AnalysisSettings& settings);
+
+// analyzes a document of any size in bounded memory
+// input is buffered until a chunk is full and cut at the last sentence boundary (or word
+// boundary if the chunk has no sentence end), corrected text is passed to output as soon as
+// each piece is done, so at most two chunks of input are held at any time
+class StreamAnalyzer
+{
+public:
+    using Output = std::function<void(const std::string&)>;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    StreamAnalyzer(const AnalysisSettings& settings, Output output,
+                   const RulePack& rules = DefaultRulePack(), size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    // feeds more input, may call output several times
+    void Write(const char* data, size_t size);
+
+    // analyzes the remaining input, use CountMessages(State()) and ComputeLikeness(State())
+    // for the results since one message line per fix would grow with the input
+    void Finish();
+
+    // collects per stage measurements of the following pieces into metrics (null stops)
+    void SetMetrics(AnalysisMetrics* newMetrics) { metrics = newMetrics; }
+
+    // collects the fixes of the following pieces into diagnostics (null stops)
+    void SetDiagnostics(AnalysisDiagnostics* newDiagnostics) { diagnostics = newDiagnostics; }
+
+    // takes the paragraphs of the following pieces from cache when they were analyzed before
+    // (see AnalyzePieceCached), not while metrics are collected (null stops)
+    void SetCache(ResultCache* newCache) { cache = newCache; }
+
+    const AnalysisState& State() const { return state; }
+    uint64_t BytesIn() const { return bytesIn; }
+    uint64_t BytesOut() const { return bytesOut; }
+    bool Changed() const { return changed; }
+
+private:
+    void AnalyzeFront(size_t length);
+
+    AnalysisSettings settings;
+    Output output;
+    const RulePack& rules;
+    size_t chunkSize;
+
+    AnalysisState state;
+    AnalysisMetrics* metrics = nullptr;
+    AnalysisDiagnostics* diagnostics = nullptr;
+    ResultCache* cache = nullptr;
+    std::string buffer; // input not analyzed yet
+    std::string piece;  // reused for each analyzed piece
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    bool changed = false;
+};
+
+// analyzes text in place through a StreamAnalyzer, calling progress(bytesDone, bytesTotal)
+// after each chunk, state receives what was fixed; if progress returns false the analysis
+// stops, text is left unchanged and false is returned
+// with a cache the paragraphs analyzed before are taken from it (see StreamAnalyzer::SetCache)
+bool AnalyzeInChunks(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                     const std::function<bool(size_t, size_t)>& progress, AnalysisMetrics* metrics = nullptr,
+                     AnalysisDiagnostics* diagnostics = nullptr, ResultCache* cache = nullptr);
+
+// analyzes a document through its views, one chunk at a time, without copying it
+// the fixes are returned in edits (ascending, offsets in document) for the caller to apply
+// to the document and to whatever shows it, so only the changed ranges are touched
+// progress and cache work as in AnalyzeInChunks, when progress stops the analysis edits is
+// left empty
+bool AnalyzeDocument(const PieceTable& document, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                     std::vector<TextEdit>& edits, const std::function<bool(size_t, size_t)>& progress, AnalysisMetrics* metrics = nullptr,
+                     AnalysisDiagnostics* diagnostics = nullptr, ResultCache* cache = nullptr);
@@ -0,0 +1,215 @@
+#include "atomic_file.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* const ATOMIC_FILE_SUFFIX = ".trace-tmp";
+
+namespace
+{
+    // bytes written between two progress calls, and at most with one write call
+    const size_t SAVE_BLOCK_SIZE = 8 << 20;
+
+    // pieces shorter than this are gathered into a buffer of GATHER_SIZE before writing
+    const size_t SMALL_PIECE_SIZE = 64 << 10;
+    const size_t GATHER_SIZE = 1 << 20;
+}
+
+AtomicFile::~AtomicFile()
+{
+    Discard();
+}
+
+#ifdef _WIN32
+
+bool AtomicFile::Open(const std::string& newPath)
+{
+    Discard();
+    path = newPath;
+    tempPath = newPath + ATOMIC_FILE_SUFFIX;
+    HANDLE handle = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    file = handle;
+    return true;
+}
+
+bool AtomicFile::Write(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(file, data, chunk, &written, nullptr) || written == 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool AtomicFile::Commit()
+{
+    bool flushed = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    file = nullptr;
+    // write-through returns only after the rename is on disk
+    if (flushed && MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        return true;
+    DeleteFileA(tempPath.c_str());
+    return false;
+}
+
+void AtomicFile::Discard()
+{
+    if (file == nullptr)
+        return;
+    CloseHandle(file);
+    file = nullptr;
+    DeleteFileA(tempPath.c_str());
+}
+
+bool AtomicFile::IsOpen() const
+{
+    return file != nullptr;
+}
+
+#else
+
+bool AtomicFile::Open(const std::string& newPath)
+{
+    Discard();
+    path = newPath;
+    tempPath = newPath + ATOMIC_FILE_SUFFIX;
+
+    // a replaced file keeps its permissions
+    mode_t mode = 0666;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0)
+        mode = info.st_mode & 07777;
+
+    fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0)
+        return false;
+    fchmod(fd, mode); // the umask applied to a file that is created
+    return true;
+}
+
+bool AtomicFile::Write(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool AtomicFile::Commit()
+{
+    // the data must be on disk before the rename is, or a crash could leave an empty file
+    bool flushed = fsync(fd) == 0;
+    flushed = close(fd) == 0 && flushed;
+    fd = -1;
+    if (!flushed || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    // and the rename itself is on disk once the directory is
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int directoryFd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (directoryFd >= 0)
+    {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+    return true;
+}
+
+void AtomicFile::Discard()
+{
+    if (fd < 0)
+        return;
+    close(fd);
+    fd = -1;
+    unlink(tempPath.c_str());
+}
+
+bool AtomicFile::IsOpen() const
+{
+    return fd >= 0;
+}
+
+#endif
+
+bool SaveDocument(const PieceTable& document, const std::string& path, const std::function<bool(size_t, size_t)>& progress)
+{
+    AtomicFile file;
+    if (!file.Open(path))
+        return false;
+
+    const size_t total = document.Size();
+    size_t done = 0;
+    size_t nextProgress = SAVE_BLOCK_SIZE;
+    auto reportProgress = [&]()
+    {
+        if (done < nextProgress)
+            return true;
+        nextProgress = done + SAVE_BLOCK_SIZE;
+        return progress(done, total);
+    };
+
+    // large pieces are written where they are, only the small pieces edits leave behind are
+    // gathered first so each does not cost a write call of its own
+    std::string gathered;
+    gathered.reserve(GATHER_SIZE);
+    for (std::string_view view : document.Views())
+    {
+        if (view.size() < SMALL_PIECE_SIZE && gathered.size() + view.size() <= GATHER_SIZE)
+        {
+            gathered.append(view.data(), view.size());
+            done += view.size();
+            continue;
+        }
+        if (!file.Write(gathered.data(), gathered.size()) || !reportProgress())
+            return false;
+        gathered.clear();
+        if (view.size() < SMALL_PIECE_SIZE)
+        {
+            gathered.append(view.data(), view.size());
+            done += view.size();
+            continue;
+        }
+
+        while (!view.empty())
+        {
+            size_t length = std::min(view.size(), SAVE_BLOCK_SIZE);
+            if (!file.Write(view.data(), length))
+                return false;
+            view.remove_prefix(length);
+            done += length;
+            if (!reportProgress())
+                return false;
+        }
+    }
+    return file.Write(gathered.data(), gathered.size()) && progress(done, total) && file.Commit();
+}
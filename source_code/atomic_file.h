@@ -0,0 +1,54 @@
+#pragma once
+
+#include "piece_table.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// a file written under a temporary name next to its path and renamed over it only once it
+// is complete and on disk, so a crash or a failed write leaves the old file as it was
+class AtomicFile
+{
+public:
+    AtomicFile() = default;
+    ~AtomicFile();
+
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+
+    // creates the temporary file for path, discarding one that was open
+    // returns false if it could not be created
+    bool Open(const std::string& path);
+
+    // writes size bytes straight to the file, without buffering them first, so callers
+    // should pass large blocks
+    bool Write(const char* data, size_t size);
+
+    // flushes the file to disk and renames it over path, returns false if that failed
+    // (the temporary file is then removed and path left untouched)
+    bool Commit();
+
+    // removes the temporary file, path is left untouched
+    void Discard();
+
+    bool IsOpen() const;
+
+private:
+    std::string path;
+    std::string tempPath;
+#ifdef _WIN32
+    void* file = nullptr; // HANDLE, null when closed
+#else
+    int fd = -1;
+#endif
+};
+
+// suffix of the temporary files written by AtomicFile
+extern const char* const ATOMIC_FILE_SUFFIX;
+
+// writes document to path through an AtomicFile, straight from its pieces in blocks of at
+// most a few MB, calling progress(bytesDone, bytesTotal) after each block
+// returns false if the file could not be written or progress returned false, path is then
+// left untouched
+bool SaveDocument(const PieceTable& document, const std::string& path, const std::function<bool(size_t, size_t)>& progress);
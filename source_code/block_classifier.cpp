@@ -0,0 +1,474 @@
+#include "block_classifier.h"
+#include "char_classes.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRACE_CLASSIFIER_SSE2 1
+#endif
+
+const char* const CODE_SYMBOLS = "#$%&()*+/;<=>@[\\]^{|}~";
+
+namespace
+{
+    enum ByteClass : unsigned char
+    {
+        SPACE = 1,
+        SYMBOL = 2,
+        STRUCTURAL = 4,
+        NEWLINE = 8
+    };
+
+    // CODE_SYMBOLS as ranges of ASCII, so the vectorized pass needs one compare per range
+    struct ByteRange
+    {
+        unsigned char first;
+        unsigned char last;
+    };
+
+    const ByteRange SYMBOL_RANGES[] = {
+        { '#', '&' }, { '(', '+' }, { '/', '/' }, { ';', '>' }, { '@', '@' }, { '[', '^' }, { '{', '~' }
+    };
+
+    const unsigned char* ByteClasses()
+    {
+        static const std::array<unsigned char, 256> classes = []
+        {
+            std::array<unsigned char, 256> table{};
+            for (int c = 0; c < 256; ++c)
+            {
+                if (IsSpacingWhitespace(static_cast<unsigned char>(c)))
+                    table[c] |= SPACE;
+            }
+            for (const ByteRange& range : SYMBOL_RANGES)
+            {
+                for (int c = range.first; c <= range.last; ++c)
+                    table[c] |= SYMBOL;
+            }
+            table['{'] |= STRUCTURAL;
+            table['}'] |= STRUCTURAL;
+            table[';'] |= STRUCTURAL;
+            table['\n'] |= NEWLINE;
+            return table;
+        }();
+        return classes.data();
+    }
+
+#ifdef TRACE_CLASSIFIER_SSE2
+    // bytes of v within [first, last], compared unsigned
+    inline __m128i InRange(__m128i v, unsigned char first, unsigned char last)
+    {
+        __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(static_cast<char>(first)));
+        __m128i limit = _mm_set1_epi8(static_cast<char>(last - first));
+        return _mm_cmpeq_epi8(_mm_min_epu8(shifted, limit), shifted);
+    }
+
+    // bits set in a 16 bit mask, without relying on a popcount instruction
+    inline unsigned CountBits(unsigned mask)
+    {
+        mask = mask - ((mask >> 1) & 0x5555);
+        mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+        mask = (mask + (mask >> 4)) & 0x0F0F;
+        return (mask + (mask >> 8)) & 0x1F;
+    }
+#endif
+
+    // keywords of the languages most often pasted into documents, a word can be in several
+    enum KeywordLanguage
+    {
+        C_FAMILY,
+        JAVA_CSHARP,
+        JAVASCRIPT,
+        PYTHON,
+        RUST_GO,
+        SHELL_SQL,
+        LANGUAGE_COUNT
+    };
+
+    const char* const C_FAMILY_KEYWORDS[] = {
+        "auto", "bool", "break", "case", "char", "class", "const", "constexpr", "continue", "default", "define",
+        "delete", "do", "double", "else", "enum", "extern", "false", "float", "for", "goto", "if", "include",
+        "inline", "int", "long", "namespace", "new", "nullptr", "operator", "private", "protected", "public",
+        "return", "short", "signed", "sizeof", "static", "std", "struct", "switch", "template", "this", "true",
+        "typedef", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while"
+    };
+    const char* const JAVA_CSHARP_KEYWORDS[] = {
+        "abstract", "boolean", "byte", "catch", "class", "else", "extends", "final", "finally", "for", "foreach",
+        "if", "implements", "import", "instanceof", "interface", "new", "null", "override", "package", "private",
+        "protected", "public", "return", "static", "string", "super", "synchronized", "this", "throw", "throws",
+        "try", "var", "void", "while"
+    };
+    const char* const JAVASCRIPT_KEYWORDS[] = {
+        "async", "await", "catch", "console", "const", "document", "else", "export", "for", "function", "if",
+        "import", "let", "new", "null", "require", "return", "this", "throw", "try", "typeof", "undefined",
+        "var", "while", "window", "yield"
+    };
+    const char* const PYTHON_KEYWORDS[] = {
+        "and", "as", "def", "del", "elif", "else", "except", "False", "for", "from", "global", "if", "import",
+        "in", "is", "lambda", "None", "nonlocal", "not", "or", "pass", "print", "raise", "return", "self",
+        "True", "try", "while", "with", "yield"
+    };
+    const char* const RUST_GO_KEYWORDS[] = {
+        "chan", "defer", "else", "fn", "for", "func", "go", "if", "impl", "let", "loop", "match", "mod", "mut",
+        "package", "pub", "range", "return", "self", "struct", "trait", "type", "use", "var"
+    };
+    const char* const SHELL_SQL_KEYWORDS[] = {
+        "done", "echo", "elif", "esac", "export", "fi", "then", "CREATE", "DELETE", "FROM", "INSERT", "JOIN",
+        "SELECT", "SET", "TABLE", "UPDATE", "VALUES", "WHERE"
+    };
+
+    // keyword -> bit per KeywordLanguage
+    const std::unordered_map<std::string_view, unsigned>& Keywords()
+    {
+        static const std::unordered_map<std::string_view, unsigned> keywords = []
+        {
+            std::unordered_map<std::string_view, unsigned> table;
+            auto add = [&table](KeywordLanguage language, const auto& words)
+            {
+                for (const char* word : words)
+                    table[word] |= 1u << language;
+            };
+            add(C_FAMILY, C_FAMILY_KEYWORDS);
+            add(JAVA_CSHARP, JAVA_CSHARP_KEYWORDS);
+            add(JAVASCRIPT, JAVASCRIPT_KEYWORDS);
+            add(PYTHON, PYTHON_KEYWORDS);
+            add(RUST_GO, RUST_GO_KEYWORDS);
+            add(SHELL_SQL, SHELL_SQL_KEYWORDS);
+            return table;
+        }();
+        return keywords;
+    }
+
+    const size_t MAX_KEYWORD_LENGTH = 12;
+
+    // only the start of a line is searched for keywords, code lines are short
+    const int MAX_SCANNED_WORDS = 12;
+
+    // WEAK lines are prose unless they continue code, e.g. "    return total" or a wrapped
+    // sentence that happens to contain several keywords
+    enum class LineKind
+    {
+        BLANK,
+        PROSE,
+        WEAK,
+        CODE
+    };
+
+    bool IsFence(std::string_view content)
+    {
+        return content.size() >= 3 && (content[0] == '`' || content[0] == '~') && content[1] == content[0] && content[2] == content[0];
+    }
+
+    bool IsDirective(std::string_view name)
+    {
+        static const char* const directives[] = { "define", "elif", "else", "endif", "error", "if", "ifdef", "ifndef",
+                                                  "import", "include", "pragma", "undef" };
+        return std::find(std::begin(directives), std::end(directives), name) != std::end(directives);
+    }
+
+    // keyword hits of the language with the most of them, whether the first word is a
+    // keyword and whether a name is directly followed by '(' as in a call
+    void ScanWords(std::string_view content, unsigned& keywordHits, bool& firstKeyword, bool& call)
+    {
+        const auto& keywords = Keywords();
+        unsigned hits[LANGUAGE_COUNT] = {};
+        size_t i = 0;
+        int words = 0;
+        while (i < content.size() && words < MAX_SCANNED_WORDS)
+        {
+            if (!IsWordChar(content[i]))
+            {
+                ++i;
+                continue;
+            }
+            size_t start = i;
+            while (i < content.size() && IsWordChar(content[i])) ++i;
+            std::string_view word = content.substr(start, i - start);
+
+            if (i < content.size() && content[i] == '(' && IsAsciiLetter(word[0]))
+                call = true;
+            if (word.size() <= MAX_KEYWORD_LENGTH)
+            {
+                auto found = keywords.find(word);
+                if (found != keywords.end())
+                {
+                    for (int language = 0; language < LANGUAGE_COUNT; ++language)
+                        hits[language] += (found->second >> language) & 1;
+                    firstKeyword = firstKeyword || words == 0;
+                }
+            }
+            ++words;
+        }
+        keywordHits = *std::max_element(hits, hits + LANGUAGE_COUNT);
+    }
+
+    LineKind ScoreLine(std::string_view line, const LineCounts& counts)
+    {
+        if (counts.nonSpace == 0)
+            return LineKind::BLANK;
+
+        size_t first = 0;
+        unsigned indent = 0;
+        while (first < line.size() && IsSpacingWhitespace(line[first]))
+        {
+            indent += line[first] == '\t' ? 4 : 1;
+            ++first;
+        }
+        size_t last = line.size();
+        while (last > first && IsSpacingWhitespace(line[last - 1])) --last;
+        std::string_view content = line.substr(first, last - first);
+        char lastChar = content.back();
+
+        // comments and preprocessor lines, "# Title" or "#tag" stay prose unless indented
+        if (content.compare(0, 2, "//") == 0 || content.compare(0, 2, "/*") == 0 || content.compare(0, 2, "#!") == 0)
+            return LineKind::CODE;
+        if (content[0] == '#')
+        {
+            size_t nameEnd = 1;
+            while (nameEnd < content.size() && IsAsciiLetter(content[nameEnd])) ++nameEnd;
+            if (IsDirective(content.substr(1, nameEnd - 1)))
+                return LineKind::CODE;
+            if (indent > 0)
+                return LineKind::WEAK;
+        }
+
+        // code needs some syntax, keywords alone are common English words
+        int score = 0;
+        bool syntax = false;
+        if (lastChar == ';' || lastChar == '{' || lastChar == '}')
+        {
+            score += 3;
+            syntax = true;
+        }
+        // share of symbols among the bytes that are not whitespace
+        bool dense = counts.symbols * 4 >= counts.nonSpace;
+        bool someSymbols = counts.symbols * 10 >= counts.nonSpace;
+        if (dense)
+        {
+            score += 2;
+            syntax = true;
+        }
+        else if (someSymbols)
+        {
+            score += 1;
+            syntax = true;
+        }
+        if (counts.structural >= 2)
+            ++score;
+        if (indent >= 4)
+            ++score;
+        if ((lastChar == '.' || lastChar == '!' || lastChar == '?') && !someSymbols)
+            score -= 2;
+
+        if (score >= 3 && syntax)
+            return LineKind::CODE;
+        if (score + 4 < 3)
+            return indent > 0 && score + 4 >= 2 ? LineKind::WEAK : LineKind::PROSE; // the words add at most 4
+
+        unsigned keywordHits = 0;
+        bool firstKeyword = false;
+        bool call = false;
+        ScanWords(content, keywordHits, firstKeyword, call);
+        score += static_cast<int>(std::min(keywordHits, 2u)) + (firstKeyword ? 1 : 0) + (call ? 1 : 0);
+        syntax = syntax || call;
+
+        if (score >= 3 && syntax)
+            return LineKind::CODE;
+        return score >= 2 ? LineKind::WEAK : LineKind::PROSE;
+    }
+}
+
+void CountLineClasses(std::string_view text, std::vector<LineCounts>& lines)
+{
+    lines.clear();
+    lines.reserve(text.size() / 32 + 1);
+    const unsigned char* classes = ByteClasses();
+    const size_t size = text.size();
+    LineCounts line{ 0, 0, 0, 0, 0 };
+
+    auto countByte = [&](size_t i)
+    {
+        unsigned char c = classes[static_cast<unsigned char>(text[i])];
+        line.nonSpace += (c & SPACE) == 0;
+        line.symbols += (c & SYMBOL) != 0;
+        line.structural += (c & STRUCTURAL) != 0;
+        if (c & NEWLINE)
+        {
+            line.end = i + 1;
+            lines.push_back(line);
+            line = LineCounts{ i + 1, 0, 0, 0, 0 };
+        }
+    };
+
+    size_t i = 0;
+#ifdef TRACE_CLASSIFIER_SSE2
+    // 16 bytes at a time, one bit per byte in each mask, split at the line breaks
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i openBrace = _mm_set1_epi8('{');
+    const __m128i closeBrace = _mm_set1_epi8('}');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+        __m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(v, space), InRange(v, '\t', '\r'));
+        __m128i symbols = _mm_setzero_si128();
+        for (const ByteRange& range : SYMBOL_RANGES)
+            symbols = _mm_or_si128(symbols, InRange(v, range.first, range.last));
+        __m128i structural = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, openBrace), _mm_cmpeq_epi8(v, closeBrace)),
+                                          _mm_cmpeq_epi8(v, semicolon));
+
+        unsigned nonSpaceMask = ~static_cast<unsigned>(_mm_movemask_epi8(whitespace)) & 0xFFFF;
+        unsigned symbolMask = static_cast<unsigned>(_mm_movemask_epi8(symbols));
+        unsigned structuralMask = static_cast<unsigned>(_mm_movemask_epi8(structural));
+        unsigned newlineMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+
+        unsigned rest = 0xFFFF; // bytes of the block not counted yet
+        while (newlineMask != 0)
+        {
+            unsigned lowest = newlineMask & (0u - newlineMask);
+            unsigned part = rest & ((lowest << 1) - 1); // up to and including the '\n'
+            line.nonSpace += CountBits(nonSpaceMask & part);
+            line.symbols += CountBits(symbolMask & part);
+            line.structural += CountBits(structuralMask & part);
+            line.end = i + CountBits(lowest - 1) + 1;
+            lines.push_back(line);
+            line = LineCounts{ line.end, 0, 0, 0, 0 };
+            rest &= ~part;
+            newlineMask &= newlineMask - 1;
+        }
+        line.nonSpace += CountBits(nonSpaceMask & rest);
+        line.symbols += CountBits(symbolMask & rest);
+        line.structural += CountBits(structuralMask & rest);
+    }
+#endif
+    for (; i < size; ++i)
+        countByte(i);
+
+    if (line.start < size)
+    {
+        line.end = size;
+        lines.push_back(line);
+    }
+}
+
+std::vector<TextBlock> ClassifyBlocks(std::string_view text, BlockClassifierState& state)
+{
+    std::vector<TextBlock> blocks;
+    if (text.empty())
+        return blocks;
+
+    std::vector<LineCounts> lines;
+    CountLineClasses(text, lines);
+
+    std::vector<LineKind> kinds(lines.size());
+    for (size_t l = 0; l < lines.size(); ++l)
+    {
+        const LineCounts& counts = lines[l];
+        std::string_view line = text.substr(counts.start, counts.end - counts.start);
+        if (l == 0 && state.lineOpen)
+        {
+            kinds[l] = state.previousCode ? LineKind::CODE : LineKind::PROSE;
+            continue;
+        }
+
+        size_t first = 0;
+        while (first < line.size() && IsSpacingWhitespace(line[first])) ++first;
+        if (first < line.size() && IsFence(line.substr(first)))
+        {
+            state.inFence = !state.inFence;
+            kinds[l] = LineKind::CODE;
+        }
+        else if (state.inFence)
+        {
+            kinds[l] = LineKind::CODE;
+        }
+        else
+        {
+            kinds[l] = ScoreLine(line, counts);
+        }
+    }
+
+    // weak lines right after code stay code if they are indented or code follows right after
+    bool previousCode = state.previousCode; // the line before is code, a blank line resets it
+    bool lastCode = state.previousCode;     // the last line that was not blank is code
+    for (size_t l = 0; l < lines.size(); ++l)
+    {
+        if (kinds[l] == LineKind::BLANK)
+        {
+            previousCode = false;
+            continue;
+        }
+        if (kinds[l] == LineKind::WEAK)
+        {
+            bool nextCode = l + 1 < lines.size() && kinds[l + 1] == LineKind::CODE;
+            const char* line = text.data() + lines[l].start;
+            bool indented = line[0] == ' ' || line[0] == '\t';
+            kinds[l] = previousCode && (indented || nextCode) ? LineKind::CODE : LineKind::PROSE;
+        }
+        previousCode = kinds[l] == LineKind::CODE;
+        lastCode = previousCode;
+    }
+    state.previousCode = lastCode;
+    state.lineOpen = text.back() != '\n';
+
+    // code ranges of whole lines, blank lines between code lines included, then grown over
+    // the whitespace around them
+    auto addBlock = [&blocks](size_t start, size_t end, BlockKind kind)
+    {
+        if (end <= start)
+            return;
+        if (!blocks.empty() && blocks.back().kind == kind)
+            blocks.back().length = end - blocks.back().offset;
+        else
+            blocks.push_back(TextBlock{ start, end - start, kind });
+    };
+
+    size_t position = 0; // end of the last block
+    size_t l = 0;
+    while (l < lines.size())
+    {
+        if (kinds[l] != LineKind::CODE)
+        {
+            ++l;
+            continue;
+        }
+        size_t codeStart = lines[l].start;
+        size_t codeEnd = lines[l].end;
+        for (++l; l < lines.size() && kinds[l] != LineKind::PROSE; ++l)
+        {
+            if (kinds[l] == LineKind::CODE)
+                codeEnd = lines[l].end;
+        }
+
+        while (codeStart > position && IsSpacingWhitespace(text[codeStart - 1])) --codeStart;
+        while (codeEnd < text.size() && IsSpacingWhitespace(text[codeEnd])) ++codeEnd;
+
+        addBlock(position, codeStart, BlockKind::PROSE);
+        addBlock(codeStart, codeEnd, BlockKind::CODE);
+        position = codeEnd;
+    }
+    addBlock(position, text.size(), BlockKind::PROSE);
+    return blocks;
+}
+
+bool LineNeedsNextLine(std::string_view line)
+{
+    // only weak lines that are not indented look at the next line (see ClassifyBlocks)
+    if (line.empty() || line[0] == ' ' || line[0] == '\t')
+        return false;
+
+    const unsigned char* classes = ByteClasses();
+    LineCounts counts{ 0, line.size(), 0, 0, 0 };
+    for (unsigned char c : line)
+    {
+        counts.nonSpace += (classes[c] & SPACE) == 0;
+        counts.symbols += (classes[c] & SYMBOL) != 0;
+        counts.structural += (classes[c] & STRUCTURAL) != 0;
+    }
+    return !IsFence(line) && ScoreLine(line, counts) == LineKind::WEAK;
+}
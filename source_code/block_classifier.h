@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// splits text into prose and code blocks so the analysis can leave code alone
+// every line is scored on cheap features: the share of symbol bytes, lines ending with
+// ';', '{' or '}', comment and preprocessor starts, indentation and hits from per language
+// keyword tables; lines inside ``` or ~~~ fences are always code
+// the byte counts of all lines are gathered by one vectorized byte class pass (SSE2 where
+// available), so classifying costs a small part of what the analysis of the text does
+
+enum class BlockKind
+{
+    PROSE,
+    CODE
+};
+
+// offset and length are bytes of the classified text
+struct TextBlock
+{
+    size_t offset;
+    size_t length;
+    BlockKind kind;
+};
+
+// what classifying a piece of a document carries to the next piece
+struct BlockClassifierState
+{
+    bool inFence = false;      // inside a fenced block
+    bool previousCode = false; // the last line that was not blank is code
+    bool lineOpen = false;     // the piece ended inside a line, whose rest keeps the same kind
+
+    bool operator==(const BlockClassifierState& other) const
+    {
+        return inFence == other.inFence && previousCode == other.previousCode && lineOpen == other.lineOpen;
+    }
+};
+
+// byte class counts of one line, end is past its '\n' (or the end of the text)
+struct LineCounts
+{
+    size_t start;
+    size_t end;
+    uint32_t nonSpace;   // bytes that are not whitespace
+    uint32_t symbols;    // bytes typical for code, see CODE_SYMBOLS
+    uint32_t structural; // '{', '}' and ';'
+};
+
+// bytes counted as symbols, prose punctuation (.,!?:'"-) is left out
+extern const char* const CODE_SYMBOLS;
+
+// counts the byte classes of every line of text in one pass, lines is overwritten
+void CountLineClasses(std::string_view text, std::vector<LineCounts>& lines);
+
+// splits text into blocks of whole lines (the first and last one may be partial when a
+// piece of a document starts or ends inside a line), adjacent blocks differ in kind
+// whitespace next to a code block belongs to it, so prose blocks that touch code start and
+// end with a word and the line structure around code survives the spacing pass
+// state is updated for the next piece of the same document
+std::vector<TextBlock> ClassifyBlocks(std::string_view text, BlockClassifierState& state);
+
+// true if the kind ClassifyBlocks gives line (one line, without the text around it) may
+// depend on the line after it, a piece of a document must not end with such a line
+bool LineNeedsNextLine(std::string_view line);
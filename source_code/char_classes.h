@@ -0,0 +1,20 @@
+#pragma once
+
+// byte classes shared by the analysis passes, all of them ASCII only and locale independent
+
+// whitespace as matched by \s in std::regex (space, \t, \n, \v, \f, \r)
+inline bool IsSpacingWhitespace(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool IsAsciiLetter(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// characters matched by \w in std::regex, used for the \b word boundary checks
+inline bool IsWordChar(unsigned char c)
+{
+    return IsAsciiLetter(c) || (c >= '0' && c <= '9') || c == '_';
+}
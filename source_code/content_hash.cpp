@@ -0,0 +1,81 @@
+#include "content_hash.h"
+
+#include <cstring>
+
+namespace
+{
+    // the primes of xxHash64
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+    uint64_t RotateLeft(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t ReadWord(const unsigned char* bytes)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        return word;
+    }
+
+    // spreads every input bit over the whole result
+    uint64_t Avalanche(uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
+
+Hash128 HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t low = seed + PRIME5;
+    uint64_t high = RotateLeft(seed, 32) ^ PRIME4;
+
+    // two independent words per step so the multiplications of both lanes overlap
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        uint64_t a = ReadWord(bytes + i);
+        uint64_t b = ReadWord(bytes + i + 8);
+        low = RotateLeft(low ^ RotateLeft(a * PRIME2, 31) * PRIME1, 27) * PRIME1 + PRIME4;
+        high = RotateLeft(high + (a ^ PRIME3) * PRIME4, 29) * PRIME2;
+        low = RotateLeft(low ^ RotateLeft(b * PRIME2, 31) * PRIME1, 27) * PRIME1 + PRIME4;
+        high = RotateLeft(high + (b ^ PRIME3) * PRIME4, 29) * PRIME2;
+    }
+    if (i + 8 <= size)
+    {
+        uint64_t a = ReadWord(bytes + i);
+        low = RotateLeft(low ^ RotateLeft(a * PRIME2, 31) * PRIME1, 27) * PRIME1 + PRIME4;
+        high = RotateLeft(high + (a ^ PRIME3) * PRIME4, 29) * PRIME2;
+        i += 8;
+    }
+
+    // the last bytes as one word, the length below tells "a" from "a\0"
+    if (i < size)
+    {
+        uint64_t tail = 0;
+        std::memcpy(&tail, bytes + i, size - i);
+        low = RotateLeft(low ^ tail * PRIME5, 11) * PRIME1;
+        high = RotateLeft(high + (tail ^ PRIME1) * PRIME3, 23) * PRIME2;
+    }
+
+    Hash128 hash;
+    hash.low = Avalanche(low + size);
+    hash.high = Avalanche(high ^ (static_cast<uint64_t>(size) * PRIME3) ^ hash.low);
+    return hash;
+}
+
+uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+    return Avalanche(seed ^ (value + PRIME1 + RotateLeft(seed, 17)));
+}
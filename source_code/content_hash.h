@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 128-bit hash of a byte string, two 64-bit lanes fed the same 8 byte words through
+// different multiplications, for content addressed lookups (ResultCache keys, rule pack
+// stamps) where a collision means a wrong result, not just a slower probe
+// fast (a few GB/s) but not cryptographic, inputs are not assumed to be chosen by an attacker
+struct Hash128
+{
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const Hash128& other) const { return low == other.low && high == other.high; }
+    bool operator!=(const Hash128& other) const { return !(*this == other); }
+};
+
+// hash of size bytes at data, different seeds give unrelated hashes of the same bytes
+Hash128 HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// mixes value into seed, for building the seed of HashBytes from several numbers
+uint64_t HashCombine(uint64_t seed, uint64_t value);
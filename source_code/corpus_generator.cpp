@@ -0,0 +1,191 @@
+#include "corpus_generator.h"
+
+#include <random>
+
+namespace
+{
+    const char* const PROSE_WORDS[] = {
+        "the", "analysis", "of", "text", "shows", "that", "every", "sentence", "should", "start",
+        "with", "a", "capital", "letter", "and", "end", "period", "we", "checked", "report",
+        "document", "is", "long", "but", "readable", "writer", "forgot", "spaces", "after", "commas",
+        "this", "tool", "fixes", "mistakes", "in", "seconds", "users", "type", "quickly", "often"
+    };
+
+    const char* const PROSE_TYPOS[] = { "teh", "adn", "recieve", "becuase", "definately", "seperate", "untill", "wich" };
+
+    const char* const CODE_LINES[] = {
+        "int count = 0;",
+        "for (int i = 0; i < size; ++i) {",
+        "    float ratio = total / 3.5f;",
+        "    double value = values[i] * ratio;",
+        "    if (value > limit) break;",
+        "}",
+        "// computes the next offset.",
+        "return result.first;",
+        "std::vector<int> items(size);",
+        "int main(int argc, char** argv) {",
+        "    printf(\"%d items,%d bytes\\n\", count, bytes);",
+        "x.y = obj.field;"
+    };
+
+    const char* const POLISH_WORDS[] = {
+        "zażółć", "gęślą", "jaźń", "łódź", "źdźbło", "więcej", "proszę", "dziękuję", "książka", "żółty",
+        "ćma", "też", "będzie", "miłość", "się"
+    };
+
+    const char* const FRENCH_WORDS[] = {
+        "été", "très", "déjà", "garçon", "français", "naïve", "où", "élève", "cœur", "être",
+        "à", "voilà", "château", "noël", "forêt"
+    };
+
+    const char* const SPANISH_WORDS[] = {
+        "año", "mañana", "niño", "corazón", "también", "canción", "está", "qué", "pingüino", "señor",
+        "árbol", "después", "música", "más", "sí"
+    };
+
+    const char* const WHITESPACE_RUNS[] = { " ", "  ", "\t", " \t ", "\n", "\n\n", "      ", "\t\t\t", " \n \n ", "                                " };
+
+    template <size_t N>
+    const char* Pick(const char* const (&items)[N], std::mt19937_64& rng)
+    {
+        return items[rng() % N];
+    }
+
+    void AppendSentence(std::string& text, std::mt19937_64& rng)
+    {
+        size_t words = 5 + rng() % 11;
+        for (size_t w = 0; w < words; ++w)
+        {
+            std::string word = rng() % 20 == 0 ? Pick(PROSE_TYPOS, rng) : Pick(PROSE_WORDS, rng);
+            if (w == 0 && rng() % 10 < 7)
+                word[0] = static_cast<char>(word[0] - 'a' + 'A');
+            text += word;
+            if (w + 1 < words)
+            {
+                unsigned mistake = rng() % 40;
+                if (mistake == 0) text += " ,";   // space before a comma
+                else if (mistake == 1) text += ","; // no space after a comma
+                else if (mistake == 2) text += ", ";
+                else if (mistake == 3) text += "  ";
+                else text += ' ';
+            }
+        }
+        static const char* const endings[] = { ". ", ". ", ". ", "! ", "? ", ".", " . " };
+        text += Pick(endings, rng);
+    }
+
+    template <size_t N>
+    void AppendForeignSentence(std::string& text, const char* const (&words)[N], std::mt19937_64& rng)
+    {
+        size_t count = 5 + rng() % 11;
+        for (size_t w = 0; w < count; ++w)
+        {
+            text += Pick(words, rng);
+            text += (w + 1 < count) ? (rng() % 15 == 0 ? ", " : " ") : ". ";
+        }
+    }
+
+    void AppendBlock(CorpusKind kind, std::string& text, std::mt19937_64& rng)
+    {
+        switch (kind)
+        {
+        case CorpusKind::PROSE:
+        {
+            size_t sentences = 4 + rng() % 5;
+            for (size_t s = 0; s < sentences; ++s)
+                AppendSentence(text, rng);
+            text += "\n\n";
+            break;
+        }
+
+        case CorpusKind::CODE:
+        {
+            size_t lines = 5 + rng() % 20;
+            for (size_t l = 0; l < lines; ++l)
+            {
+                text += Pick(CODE_LINES, rng);
+                text += '\n';
+            }
+            if (rng() % 5 == 0)
+                AppendSentence(text, rng);
+            text += '\n';
+            break;
+        }
+
+        case CorpusKind::DIACRITICS:
+        {
+            size_t sentences = 4 + rng() % 5;
+            unsigned language = rng() % 3;
+            for (size_t s = 0; s < sentences; ++s)
+            {
+                if (language == 0) AppendForeignSentence(text, POLISH_WORDS, rng);
+                else if (language == 1) AppendForeignSentence(text, FRENCH_WORDS, rng);
+                else AppendForeignSentence(text, SPANISH_WORDS, rng);
+            }
+            text += "\n\n";
+            break;
+        }
+
+        case CorpusKind::WHITESPACE:
+        {
+            size_t tokens = 10 + rng() % 30;
+            for (size_t t = 0; t < tokens; ++t)
+            {
+                text += Pick(PROSE_WORDS, rng);
+                text += Pick(WHITESPACE_RUNS, rng);
+                unsigned punctuation = rng() % 6;
+                if (punctuation == 0) text += ",";
+                else if (punctuation == 1) text += ".";
+                else if (punctuation == 2) text += ";";
+                if (rng() % 2 == 0)
+                    text += Pick(WHITESPACE_RUNS, rng);
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+const char* CorpusName(CorpusKind kind)
+{
+    switch (kind)
+    {
+    case CorpusKind::PROSE: return "prose";
+    case CorpusKind::CODE: return "code";
+    case CorpusKind::DIACRITICS: return "diacritics";
+    case CorpusKind::WHITESPACE: return "whitespace";
+    default: return "unknown";
+    }
+}
+
+bool ParseCorpusKind(const std::string& name, CorpusKind& kind)
+{
+    for (int k = 0; k < static_cast<int>(CorpusKind::COUNT); ++k)
+    {
+        if (name == CorpusName(static_cast<CorpusKind>(k)))
+        {
+            kind = static_cast<CorpusKind>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string GenerateCorpus(CorpusKind kind, size_t size, uint64_t seed)
+{
+    std::mt19937_64 rng(seed * 4 + static_cast<uint64_t>(kind));
+    std::string text;
+    text.reserve(size + 4096);
+    while (text.size() < size)
+        AppendBlock(kind, text, rng);
+
+    // never ends in the middle of a UTF-8 character
+    size_t end = size;
+    while (end > 0 && end < text.size() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80)
+        --end;
+    text.resize(end);
+    return text;
+}
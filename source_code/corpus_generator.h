@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// kinds of synthetic text used to benchmark the analysis
+enum class CorpusKind
+{
+    PROSE,      // English sentences with typos, missing capitals and spacing mistakes
+    CODE,       // mostly source code lines with some comments and prose in between
+    DIACRITICS, // Polish, French and Spanish sentences with accented letters
+    WHITESPACE, // long and mixed whitespace runs around punctuation
+    COUNT
+};
+
+const char* CorpusName(CorpusKind kind);
+bool ParseCorpusKind(const std::string& name, CorpusKind& kind);
+
+// generates size bytes (less if that would split a UTF-8 character) of text of the given
+// kind, the same seed always gives the same text so runs can be compared
+std::string GenerateCorpus(CorpusKind kind, size_t size, uint64_t seed = 1);
@@ -0,0 +1,277 @@
+#include "fused_pipeline.h"
+#include "analysis_arena.h"
+#include "char_classes.h"
+#include "scan_kernels.h"
+#include "utf8_case.h"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+    const ByteSet SPACING_SET(SPACING_PUNCTUATION);
+    const ByteSet PERIOD(".");
+
+    // whitespace runs JoinSentences skips byte by byte before calling SkipWhitespace
+    const size_t LONG_RUN = 2;
+
+    // classes of the bytes JoinSentences stops at
+    enum JoinClass : unsigned char
+    {
+        SPACE = 1,       // IsSpacingWhitespace
+        PUNCTUATION = 2, // SPACING_PUNCTUATION
+        PERIOD_MARK = 4
+    };
+
+    const unsigned char* JoinClasses()
+    {
+        static const std::array<unsigned char, 256> classes = []
+        {
+            std::array<unsigned char, 256> table{};
+            for (int c = 0; c < 256; ++c)
+            {
+                if (IsSpacingWhitespace(static_cast<unsigned char>(c)))
+                    table[c] |= SPACE;
+                if (SPACING_SET.Contains(static_cast<unsigned char>(c)))
+                    table[c] |= PUNCTUATION;
+            }
+            table['.'] |= PERIOD_MARK;
+            return table;
+        }();
+        return classes.data();
+    }
+
+    // capitalizes the word after each period; a period ending a word refers to the next one
+    // the periods of an abbreviation are skipped
+    template <bool Enabled>
+    struct AfterPeriodRule
+    {
+        const RulePack& rules;
+        bool pending;
+        size_t fixes = 0;
+
+        // period is the first period of the word, or null if it has none
+        void OnWord(char* word, size_t length, char* period)
+        {
+            if (!Enabled)
+                return;
+            if (pending && CapitalizeLetter(word, length))
+                ++fixes;
+            if (period != nullptr && rules.IsAbbreviation(std::string_view(word, length)))
+            {
+                pending = false;
+                return;
+            }
+            char* end = word + length;
+            for (; period != nullptr && period + 1 < end; period = static_cast<char*>(std::memchr(period + 1, '.', end - period - 1)))
+            {
+                if (CapitalizeLetter(period + 1, end - period - 1))
+                    ++fixes;
+            }
+            pending = end[-1] == '.';
+        }
+    };
+
+    // capitalizes the first word of each sentence unless it is a coding term, a sentence ends
+    // with a period that is not part of an abbreviation
+    struct SentenceCaseRule
+    {
+        const RulePack& rules;
+        bool newSentence;
+
+        void OnWord(char* word, size_t length)
+        {
+            std::string_view token(word, length);
+            if (newSentence && !rules.IsCodingTerm(token))
+                CapitalizeLetter(word, length);
+            newSentence = word[length - 1] == '.' && !rules.IsAbbreviation(token);
+        }
+    };
+
+    // spacing, after period and sentence case in one pass: the words of the spaced text are
+    // written once, each followed by one space, and the rules run on each word when it ends
+    // spacing joins punctuation after whitespace to the word before it and ends a word after
+    // punctuation followed by an ASCII letter
+    // while no rule waits for the next word (no sentence start, no pending period) the single
+    // spaced words up to the next stop are copied at once after FindPlainWordsEnd, the rest is
+    // copied byte by byte, which is cheaper than a scanning kernel call per word of a few bytes
+    // text without spacing fixes is rewritten in place, the words only move down
+    template <bool FixSpacing, bool CapitalizeAfterPeriod>
+    void JoinSentences(std::string& text, const RulePack& rules, AnalysisState& state)
+    {
+        const size_t length = text.size();
+        const bool inPlace = !FixSpacing || FindSpacingFix(text, 0, SPACING_SET) >= length;
+        ScratchString scratch;
+        std::string& result = scratch.Get();
+        if (!inPlace)
+        {
+            state.spacingFixed = true;
+            result.resize(length + length / 16 + 16); // grown below if there are more inserted spaces
+        }
+        char* begin = inPlace ? &text[0] : &result[0];
+        const unsigned char* input = reinterpret_cast<const unsigned char*>(text.data());
+
+        const unsigned char* classes = JoinClasses();
+        const unsigned char stops = SPACE | (FixSpacing ? PUNCTUATION : 0) | (CapitalizeAfterPeriod ? PERIOD_MARK : 0);
+        const ByteSet& stopSet = FixSpacing ? SPACING_SET : PERIOD;
+        char* write = begin;
+        char* word = nullptr;   // start of the word being written
+        char* period = nullptr; // first period in it
+
+        AfterPeriodRule<CapitalizeAfterPeriod> afterPeriod{ rules, state.periodPending };
+        SentenceCaseRule sentenceCase{ rules, state.newSentence };
+        // takes the positions as arguments, a write pointer captured by reference would have to
+        // be reloaded after every byte stored through it
+        auto onWord = [&afterPeriod, &sentenceCase](char* start, char* end, char* firstPeriod)
+        {
+            afterPeriod.OnWord(start, end - start, firstPeriod);
+            sentenceCase.OnWord(start, end - start);
+        };
+
+        size_t i = 0;
+        while (true)
+        {
+            size_t runStart = i;
+            // runs are mostly a single space, long ones are left to the scanning kernel
+            while (i < length && (classes[input[i]] & SPACE) && i - runStart < LONG_RUN) ++i;
+            if (i - runStart == LONG_RUN)
+                i = SkipWhitespace(text, i);
+            if (i >= length)
+                break;
+            if (word != nullptr && i > runStart && !(FixSpacing && (classes[input[i]] & PUNCTUATION)))
+            {
+                onWord(word, write, period);
+                *write++ = ' '; // over whitespace that was already read
+                word = nullptr;
+                period = nullptr;
+            }
+            if (word == nullptr)
+            {
+                word = write;
+                // after a single space more single spaced words likely follow
+                bool plain = i - runStart == 1 && input[runStart] == ' ';
+                if (plain && !sentenceCase.newSentence && !(CapitalizeAfterPeriod && afterPeriod.pending))
+                {
+                    // no rule looks at the words up to the next stop, they are copied as they are
+                    size_t end = FindPlainWordsEnd(text, i, stopSet);
+                    if (write != text.data() + i)
+                        std::memmove(write, text.data() + i, end - i);
+                    write += end - i;
+                    for (char* p = write; p > word; --p)
+                    {
+                        if (p[-1] == ' ')
+                        {
+                            word = p;
+                            break;
+                        }
+                    }
+                    i = end;
+                }
+            }
+
+            for (; i < length; ++i)
+            {
+                unsigned char c = input[i];
+                unsigned char kind = classes[c] & stops;
+                if (kind == 0)
+                {
+                    *write++ = static_cast<char>(c);
+                    continue;
+                }
+                if (kind & SPACE)
+                    break;
+                *write++ = static_cast<char>(c);
+                if ((kind & PERIOD_MARK) && period == nullptr)
+                    period = write - 1;
+                if (FixSpacing && i + 1 < length && IsAsciiLetter(input[i + 1]))
+                {
+                    // the rest of the input and this space must still fit (never in place, where
+                    // the text has no spacing fixes)
+                    if (static_cast<size_t>(write - begin) + length - i > result.size())
+                    {
+                        size_t written = write - begin;
+                        size_t wordOffset = word - begin;
+                        size_t periodOffset = period ? period - begin : 0;
+                        result.resize(result.size() * 2);
+                        begin = &result[0];
+                        write = begin + written;
+                        word = begin + wordOffset;
+                        period = period ? begin + periodOffset : nullptr;
+                    }
+                    onWord(word, write, period);
+                    *write++ = ' ';
+                    word = write;
+                    period = nullptr;
+                }
+            }
+        }
+        bool lastWord = word != nullptr;
+        if (lastWord)
+            onWord(word, write, period);
+
+        if (inPlace)
+        {
+            text.resize(write - begin);
+        }
+        else
+        {
+            result.resize(write - begin);
+            text.swap(result);
+        }
+        if (lastWord)
+            text.push_back(' '); // in place the last word may end the text
+        state.newSentence = sentenceCase.newSentence;
+        if (CapitalizeAfterPeriod)
+        {
+            state.periodPending = afterPeriod.pending;
+            state.afterPeriodFixes += afterPeriod.fixes;
+        }
+    }
+
+    template <bool CapitalizeFirstLetter, bool FixSpacing, bool CapitalizeAfterPeriod, bool CodingTerms>
+    void RunPipeline(std::string& text, const RulePack& rules, AnalysisState& state)
+    {
+        const AnalysisSettings settings{ CapitalizeFirstLetter, FixSpacing, CapitalizeAfterPeriod, CodingTerms };
+        if (CapitalizeFirstLetter)
+            RunStage(AnalysisStage::FIRST_LETTER, text, settings, rules, state);
+
+        if (CapitalizeFirstLetter && !CodingTerms)
+        {
+            JoinSentences<FixSpacing, CapitalizeAfterPeriod>(text, rules, state);
+        }
+        else
+        {
+            // without sentence case the spacing and after period passes only touch what they
+            // fix and skip the rest with the scanning kernels
+            if (FixSpacing)
+                RunStage(AnalysisStage::SPACING, text, settings, rules, state);
+            if (CapitalizeAfterPeriod)
+                RunStage(AnalysisStage::AFTER_PERIOD, text, settings, rules, state);
+        }
+        RunStage(AnalysisStage::TYPOS, text, settings, rules, state);
+    }
+
+    typedef void (*Pipeline)(std::string& text, const RulePack& rules, AnalysisState& state);
+
+    // indexed by the flags, capitalizeFirstLetter being the lowest bit
+    const Pipeline PIPELINES[16] = {
+        RunPipeline<false, false, false, false>, RunPipeline<true, false, false, false>,
+        RunPipeline<false, true, false, false>,  RunPipeline<true, true, false, false>,
+        RunPipeline<false, false, true, false>,  RunPipeline<true, false, true, false>,
+        RunPipeline<false, true, true, false>,   RunPipeline<true, true, true, false>,
+        RunPipeline<false, false, false, true>,  RunPipeline<true, false, false, true>,
+        RunPipeline<false, true, false, true>,   RunPipeline<true, true, false, true>,
+        RunPipeline<false, false, true, true>,   RunPipeline<true, false, true, true>,
+        RunPipeline<false, true, true, true>,    RunPipeline<true, true, true, true>,
+    };
+}
+
+void RunFusedStages(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state)
+{
+    int index = (settings.capitalizeFirstLetter ? 1 : 0) | (settings.fixSpacing ? 2 : 0) | (settings.capitalizeAfterPeriod ? 4 : 0)
+        | (settings.codingTerms ? 8 : 0);
+    PIPELINES[index](text, rules, state);
+    if (settings.suggestSpelling)
+        RunStage(AnalysisStage::SPELLING, text, settings, rules, state);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "analyzer.h"
+
+// runs the stages settings enables over text with the same result as running them one after
+// another with RunStage, through a version of the pipeline compiled for each of the 16
+// combinations of the settings flags and chosen once per call
+// with sentence case on, spacing, after period and sentence case are fused into a single
+// traversal that writes the joined words once, each pass a rule applied to every word as it
+// is completed; the typo pass then runs over the result (its entries may span several words),
+// followed by the spelling pass if it is on
+// AnalyzePiece uses it when neither metrics nor diagnostics are collected, since those need
+// the text between the stages
+void RunFusedStages(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state);
@@ -0,0 +1,178 @@
+#include "incremental_analyzer.h"
+
+#include "result_cache.h"
+
+#include <algorithm>
+
+IncrementalAnalyzer::IncrementalAnalyzer(const AnalysisSettings& settings, const RulePack& rules)
+    : settings(settings), rules(rules)
+{
+}
+
+void IncrementalAnalyzer::Reset(const AnalysisSettings& newSettings)
+{
+    settings = newSettings;
+    paragraphs.clear();
+    analyzedLastUpdate = 0;
+    firstLetterFixes = 0;
+    spacingFixes = 0;
+    afterPeriodFixes = 0;
+    spellingFixes = 0;
+    typoEntries.clear();
+}
+
+std::vector<IncrementalAnalyzer::Fix> IncrementalAnalyzer::Update(const std::string& text)
+{
+    std::vector<Fix> fixes;
+    analyzedLastUpdate = 0;
+    const size_t count = paragraphs.size();
+
+    // skips the leading paragraphs that are unchanged, each followed by its '\n'
+    // (the last one has no '\n' and must reach the end of the text)
+    size_t first = 0;
+    size_t start = 0;
+    while (first < count)
+    {
+        const std::string& paragraph = paragraphs[first].text;
+        bool last = first + 1 == count;
+        if (text.compare(start, paragraph.size(), paragraph) != 0)
+            break;
+        if (last ? start + paragraph.size() != text.size()
+                 : start + paragraph.size() >= text.size() || text[start + paragraph.size()] != '\n')
+            break;
+        start += paragraph.size() + 1;
+        ++first;
+    }
+    if (first == count && count > 0)
+        return fixes; // nothing changed
+
+    // skips the trailing paragraphs that are unchanged, each preceded by its '\n' which
+    // must lie after the leading ones (the first paragraph has no '\n' before it)
+    size_t end = text.size();
+    size_t kept = count;
+    while (kept > first && kept > 1)
+    {
+        const std::string& paragraph = paragraphs[kept - 1].text;
+        if (end < start + paragraph.size() + 1)
+            break;
+        size_t paragraphStart = end - paragraph.size();
+        if (text[paragraphStart - 1] != '\n' || text.compare(paragraphStart, paragraph.size(), paragraph) != 0)
+            break;
+        end = paragraphStart - 1;
+        --kept;
+    }
+
+    // the changed region becomes new paragraphs replacing paragraphs [first, kept)
+    std::vector<Paragraph> replaced;
+    for (size_t position = start;;)
+    {
+        size_t newline = text.find('\n', position);
+        if (newline == std::string::npos || newline >= end)
+        {
+            replaced.emplace_back();
+            replaced.back().text.assign(text, position, end - position);
+            break;
+        }
+        replaced.emplace_back();
+        replaced.back().text.assign(text, position, newline - position);
+        position = newline + 1;
+    }
+    return ReplaceParagraphs(first, kept, std::move(replaced), start);
+}
+
+std::vector<IncrementalAnalyzer::Fix> IncrementalAnalyzer::Replace(size_t first, size_t count, const std::vector<std::string>& texts)
+{
+    analyzedLastUpdate = 0;
+    std::vector<Paragraph> replaced(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i)
+        replaced[i].text = texts[i];
+    return ReplaceParagraphs(first, std::min(first + count, paragraphs.size()), std::move(replaced), 0);
+}
+
+std::vector<IncrementalAnalyzer::Fix> IncrementalAnalyzer::ReplaceParagraphs(size_t first, size_t kept, std::vector<Paragraph> replaced,
+                                                                             size_t offset)
+{
+    std::vector<Fix> fixes;
+    for (size_t i = first; i < kept; ++i)
+        AddFindings(paragraphs[i].findings, -1);
+    paragraphs.erase(paragraphs.begin() + first, paragraphs.begin() + kept);
+    paragraphs.insert(paragraphs.begin() + first, std::make_move_iterator(replaced.begin()), std::make_move_iterator(replaced.end()));
+    const size_t changedEnd = first + replaced.size();
+
+    // analyzes the new paragraphs, then the following ones while their starting state changed
+    Carry carry = first > 0 ? paragraphs[first - 1].exit : Carry();
+    for (size_t i = first; i < paragraphs.size(); ++i)
+    {
+        Paragraph& paragraph = paragraphs[i];
+        if (i >= changedEnd)
+        {
+            if (paragraph.entry == carry)
+                break;
+            AddFindings(paragraph.findings, -1);
+        }
+
+        std::string input = paragraph.text;
+        AnalyzeParagraph(paragraph, input, carry);
+        AddFindings(paragraph.findings, 1);
+        ++analyzedLastUpdate;
+
+        size_t length = input.size();
+        if (paragraph.text != input)
+            fixes.push_back(Fix{ offset, length, paragraph.text, std::move(input), i });
+        offset += length + 1;
+        carry = paragraph.exit;
+    }
+    return fixes;
+}
+
+void IncrementalAnalyzer::AnalyzeParagraph(Paragraph& paragraph, const std::string& text, const Carry& entry)
+{
+    AnalysisState state;
+    state.documentStart = entry.documentStart;
+    state.periodPending = entry.periodPending;
+    state.newSentence = entry.newSentence;
+    state.blocks = entry.blocks;
+
+    paragraph.text = text;
+    if (cache)
+        AnalyzePieceCached(paragraph.text, settings, rules, state, *cache);
+    else
+        AnalyzePiece(paragraph.text, settings, rules, state);
+
+    paragraph.entry = entry;
+    paragraph.exit.documentStart = state.documentStart;
+    paragraph.exit.periodPending = state.periodPending;
+    paragraph.exit.newSentence = state.newSentence;
+    paragraph.exit.blocks = state.blocks;
+    paragraph.exit.blocks.lineOpen = false; // the '\n' after the paragraph ends its line
+    paragraph.findings = std::move(state);
+}
+
+void IncrementalAnalyzer::AddFindings(const AnalysisState& findings, int sign)
+{
+    auto adjust = [sign](size_t& total, size_t amount) { total = sign > 0 ? total + amount : total - amount; };
+    adjust(firstLetterFixes, findings.firstLetterFixed ? 1 : 0);
+    adjust(spacingFixes, findings.spacingFixed ? 1 : 0);
+    adjust(afterPeriodFixes, findings.afterPeriodFixes);
+    adjust(spellingFixes, findings.spellingFixes);
+    for (int entry : findings.typoEntriesUsed)
+    {
+        size_t& uses = typoEntries[entry];
+        adjust(uses, 1);
+        if (uses == 0)
+            typoEntries.erase(entry);
+    }
+}
+
+AnalysisState IncrementalAnalyzer::Totals() const
+{
+    AnalysisState totals;
+    totals.documentStart = paragraphs.empty() || paragraphs.back().exit.documentStart;
+    totals.firstLetterFixed = firstLetterFixes > 0;
+    totals.spacingFixed = spacingFixes > 0;
+    totals.afterPeriodFixes = afterPeriodFixes;
+    totals.spellingFixes = spellingFixes;
+    for (const auto& entry : typoEntries)
+        totals.typoEntriesUsed.push_back(entry.first);
+    return totals;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "analyzer.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// re-analyzes only the paragraphs ('\n' separated lines) that changed since the last update
+// each paragraph remembers the sentence state it started from and ended with, so a change
+// only spreads to the following paragraphs while their starting state differs
+// paragraphs are analyzed separately, so unlike a whole document analysis the line breaks
+// are kept when the first letter pass re-joins the words
+class IncrementalAnalyzer
+{
+public:
+    // a corrected paragraph, offset and length are bytes in the text given to Update() (from
+    // the start of the first replaced paragraph for Replace())
+    struct Fix
+    {
+        size_t offset;
+        size_t length;
+        std::string corrected;
+        std::string original;
+        size_t paragraph; // index of the paragraph
+    };
+
+    explicit IncrementalAnalyzer(const AnalysisSettings& settings, const RulePack& rules = DefaultRulePack());
+
+    // analyzes what changed since the previous call and returns the fixes in ascending
+    // order, the caller applies them (last first so offsets stay valid) and the analyzer
+    // from then on assumes the document contains the corrected paragraphs
+    std::vector<Fix> Update(const std::string& text);
+
+    // like Update() for a caller that knows what changed: paragraphs [first, first + count)
+    // were replaced by texts (at least one, none containing '\n'), only those and the
+    // following ones whose starting state changed are analyzed, so the cost does not
+    // depend on the size of the document
+    std::vector<Fix> Replace(size_t first, size_t count, const std::vector<std::string>& texts);
+
+    // forgets the document, the next update analyzes everything (e.g. after a settings change)
+    void Reset(const AnalysisSettings& newSettings);
+
+    // takes the paragraphs analyzed before (by any analysis using the cache) from cache
+    // instead of analyzing them again (null stops)
+    void SetCache(ResultCache* newCache) { cache = newCache; }
+
+    // merged findings of all paragraphs, usable with CountMessages() and ComputeLikeness()
+    AnalysisState Totals() const;
+
+    size_t ParagraphCount() const { return paragraphs.size(); }
+    const std::string& ParagraphText(size_t index) const { return paragraphs[index].text; }
+    size_t ParagraphsAnalyzedLastUpdate() const { return analyzedLastUpdate; }
+
+private:
+    // the part of AnalysisState that crosses paragraph boundaries
+    struct Carry
+    {
+        bool documentStart = true;
+        bool periodPending = false;
+        bool newSentence = true;
+        BlockClassifierState blocks; // only changes with codingTerms
+
+        bool operator==(const Carry& other) const
+        {
+            return documentStart == other.documentStart && periodPending == other.periodPending && newSentence == other.newSentence
+                && blocks == other.blocks;
+        }
+    };
+
+    struct Paragraph
+    {
+        std::string text; // current text, already corrected
+        Carry entry;
+        Carry exit;
+        AnalysisState findings;
+    };
+
+    // puts replaced in place of paragraphs [first, kept) and analyzes from there, offset is
+    // where paragraph first starts in the offsets of the fixes
+    std::vector<Fix> ReplaceParagraphs(size_t first, size_t kept, std::vector<Paragraph> replaced, size_t offset);
+
+    // analyzes paragraph text starting from entry, fills the rest of the paragraph
+    void AnalyzeParagraph(Paragraph& paragraph, const std::string& text, const Carry& entry);
+    void AddFindings(const AnalysisState& findings, int sign);
+
+    AnalysisSettings settings;
+    const RulePack& rules;
+    ResultCache* cache = nullptr;
+    std::vector<Paragraph> paragraphs;
+    size_t analyzedLastUpdate = 0;
+
+    // running totals so merging does not walk every paragraph
+    size_t firstLetterFixes = 0;
+    size_t spacingFixes = 0;
+    size_t afterPeriodFixes = 0;
+    size_t spellingFixes = 0;
+    std::map<int, size_t> typoEntries; // entry -> number of paragraphs using it
+};
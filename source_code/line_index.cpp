@@ -0,0 +1,109 @@
+#include "line_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // bytes read from the document at once while indexing
+    const size_t INDEX_BLOCK_SIZE = 1 << 20;
+
+    // a row is at most this long, its line break or the rest of a cut UTF-8 character included
+    const size_t MAX_ROW_BYTES = LineIndex::ROW_BYTES + 3;
+
+    // start of the row after the one starting at start in data, which holds at least
+    // MAX_ROW_BYTES + 1 bytes from start unless atEnd (data ends with the document)
+    size_t NextRow(const char* data, size_t size, size_t start, bool atEnd)
+    {
+        size_t limit = std::min(size, start + LineIndex::ROW_BYTES);
+        const void* lineBreak = std::memchr(data + start, '\n', limit - start);
+        if (lineBreak != nullptr)
+            return static_cast<const char*>(lineBreak) - data + 1;
+        if (atEnd && limit == size)
+            return size;
+
+        // a long line is cut before the next character
+        size_t cut = limit;
+        while (cut < size && cut < start + MAX_ROW_BYTES && (static_cast<unsigned char>(data[cut]) & 0xC0) == 0x80) ++cut;
+        return cut;
+    }
+}
+
+void LineIndex::Build(const PieceTable& document)
+{
+    strideStarts.clear();
+    rowCount = 0;
+
+    const size_t size = document.Size();
+    std::string block;
+    size_t position = 0; // start of the next row
+    while (position < size)
+    {
+        block.clear();
+        document.Read(position, INDEX_BLOCK_SIZE + MAX_ROW_BYTES + 1, block);
+        const bool atEnd = position + block.size() == size;
+
+        size_t row = 0;
+        while (row < block.size() && (atEnd || row + MAX_ROW_BYTES + 1 <= block.size()))
+        {
+            if (rowCount % ROW_STRIDE == 0)
+                strideStarts.push_back(position + row);
+            ++rowCount;
+            row = NextRow(block.data(), block.size(), row, atEnd);
+        }
+        position += row;
+    }
+}
+
+void LineIndex::ReadRows(const PieceTable& document, size_t first, size_t count, std::vector<std::string>& rows) const
+{
+    if (first >= rowCount)
+        return;
+    count = std::min(count, rowCount - first);
+
+    // reads from the last indexed row before first, enough bytes for the longest rows
+    size_t stride = first / ROW_STRIDE;
+    size_t skip = first - stride * ROW_STRIDE;
+    size_t start = strideStarts[stride];
+    std::string text;
+    document.Read(start, (skip + count) * MAX_ROW_BYTES + 1, text);
+    const bool atEnd = start + text.size() == document.Size();
+
+    size_t row = 0;
+    for (size_t i = 0; i < skip + count && row < text.size(); ++i)
+    {
+        size_t next = NextRow(text.data(), text.size(), row, atEnd);
+        if (i >= skip)
+        {
+            size_t end = next;
+            while (end > row && (text[end - 1] == '\n' || text[end - 1] == '\r')) --end;
+            rows.emplace_back(text, row, end - row);
+        }
+        row = next;
+    }
+}
+
+size_t LineIndex::RowAt(const PieceTable& document, uint64_t offset) const
+{
+    if (rowCount == 0)
+        return 0;
+
+    // scans from the last indexed row at or before offset
+    size_t stride = std::upper_bound(strideStarts.begin(), strideStarts.end(), offset) - strideStarts.begin() - 1;
+    size_t row = stride * ROW_STRIDE;
+    uint64_t start = strideStarts[stride];
+    std::string text;
+    document.Read(start, ROW_STRIDE * MAX_ROW_BYTES + 1, text);
+    const bool atEnd = start + text.size() == document.Size();
+
+    size_t position = 0;
+    while (row + 1 < rowCount && position < text.size())
+    {
+        size_t next = NextRow(text.data(), text.size(), position, atEnd);
+        if (start + next > offset)
+            break;
+        position = next;
+        ++row;
+    }
+    return row;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "piece_table.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the rows a document is shown in: its lines, with lines longer than ROW_BYTES cut into
+// several rows (at the first UTF-8 character start after ROW_BYTES bytes)
+// only the start of every ROW_STRIDE-th row is kept, a row is found by scanning from the
+// one before it, so the index of a 1 GB document takes a few MB
+class LineIndex
+{
+public:
+    static const size_t ROW_BYTES = 1024;
+    static const size_t ROW_STRIDE = 64;
+
+    // indexes the rows of document, must be called again after it changed
+    void Build(const PieceTable& document);
+
+    size_t RowCount() const { return rowCount; }
+
+    // the text of count rows starting at row first, each without its line break, appended
+    // to rows; reads only those rows and the ones before them up to the last indexed row
+    void ReadRows(const PieceTable& document, size_t first, size_t count, std::vector<std::string>& rows) const;
+
+    // the row holding byte offset of document (the last row for offsets past its end)
+    size_t RowAt(const PieceTable& document, uint64_t offset) const;
+
+private:
+    std::vector<uint64_t> strideStarts; // start of rows 0, ROW_STRIDE, 2 * ROW_STRIDE, ...
+    size_t rowCount = 0;
+};
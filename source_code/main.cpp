@@ -1,23 +1,37 @@
 #include <wx/wx.h>
-#include <wx/scrolwin.h>
 #include <wx/filedlg.h>
 #include <wx/textfile.h>
 #include <wx/menu.h>
 #include <wx/choice.h>
 #include <wx/notebook.h>
 #include <wx/dialog.h>
+#include <wx/gauge.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <wx/vscroll.h>
+#include <algorithm>
 #include <iostream>
 #include <string>
-#include <regex>
-#include <map>
-#include <set>
 #include <chrono>
+#include <climits>
 #include <fstream>
-
-// global variables
-float likeness = 1.0f;
-float initialLikeness = 1.0f;
-float likenessChange = 0.0f;
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <thread>
+
+#include "analysis_diagnostics.h"
+#include "analysis_metrics.h"
+#include "analyzer.h"
+#include "atomic_file.h"
+#include "incremental_analyzer.h"
+#include "line_index.h"
+#include "piece_table.h"
+#include "result_cache.h"
+#include "text_loader.h"
+#include "undo_history.h"
 
 // IDs for events
 const int ID_ANALYZE_TEXT = 1001;
@@ -27,14 +41,256 @@ const int ID_NEW_FILE = 1004;
 const int ID_REVERT = 1005;
 const int ID_SETTINGS = 1006;
 const int ID_DOCUMENTATION = 1007;
+const int ID_ANALYZE_LARGE_FILE = 1008;
+const int ID_ANALYSIS_PROGRESS = 1009;
+const int ID_ANALYSIS_DONE = 1010;
+const int ID_LIVE_ANALYSIS = 1011;
+const int ID_LIVE_TIMER = 1012;
+const int ID_RECORD_METRICS = 1013;
+const int ID_SHOW_METRICS = 1014;
+const int ID_EXPORT_METRICS = 1015;
+const int ID_REDO = 1016;
+
+// pause in typing after which live analysis runs
+const int LIVE_ANALYSIS_DELAY_MS = 500;
+
+// memory the undo history of the editor may use
+const size_t UNDO_MEMORY_LIMIT = 64 << 20;
+
+// edits larger than this many are applied by replacing the whole editor text
+const size_t MAX_EDITOR_REPLACEMENTS = 1000;
+
+// at most this many fixes of an analysis are listed in the findings list
+const size_t MAX_LISTED_FINDINGS = 4000000;
+
+// files larger than this are opened in the read-only document view instead of the editor,
+// which gets very slow with text of a few MB
+const size_t EDITOR_SIZE_LIMIT = 16 << 20;
+
+// progress callback given to background analysis work, returns false when cancelled
+typedef std::function<bool(size_t, size_t)> ProgressCallback;
 
-// Enumeration for languages
-enum class Language
+// background analysis job, filled in by the worker thread and posted back to the frame
+struct AnalysisJob
 {
-    ENGLISH,
-    SPANISH,
-    FRENCH,
-    POLISH  
+    bool updatesEditor = false; // false for jobs that write their result to a file
+    uint64_t textVersion = 0;   // editor version the job started from
+    bool cancelled = false;
+    std::shared_ptr<const PieceTable> document; // analyzed document, read only while the job runs
+    std::vector<TextEdit> edits; // fixes, offsets in document
+    AnalysisReport report;
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+    std::string error;
+    std::shared_ptr<AnalysisMetrics> metrics; // per stage measurements, null unless recorded
+    std::shared_ptr<AnalysisDiagnostics> diagnostics; // the fixes for the findings list
+    std::vector<uint64_t> findingPositions; // offset of each fix in the corrected text
+
+    // jobs saving the document instead of analyzing, document is what they write
+    bool savesFile = false;
+
+    // jobs loading a file instead of analyzing
+    bool loadsFile = false;
+    std::shared_ptr<PieceTable> loadedDocument; // set when the file was loaded
+    bool loadedForView = false; // too large for the editor, shown in the document view
+    LineIndex loadedRows;       // rows of loadedDocument for the document view
+    wxString loadedEditorText;  // loadedDocument converted for the editor otherwise
+    size_t replacedBytes = 0;   // invalid UTF-8 bytes replaced while loading
+};
+
+// the UTF-8 bytes of editor text, NUL characters included (a file may contain them)
+static std::string ToUTF8String(const wxString& text)
+{
+    auto utf8 = text.ToUTF8();
+    return std::string(utf8.data(), utf8.length());
+}
+
+// converts ascending byte offsets in UTF-8 text, given as consecutive views, to wxTextCtrl
+// positions, which count characters (UTF-16 units where wchar_t is 16 bits)
+static std::vector<long> ToEditorPositions(const std::vector<std::string_view>& text, const std::vector<size_t>& offsets)
+{
+    std::vector<long> positions;
+    positions.reserve(offsets.size());
+    long position = 0;
+    size_t view = 0;
+    size_t inView = 0;
+    size_t i = 0;
+    for (size_t offset : offsets)
+    {
+        while (i < offset && view < text.size())
+        {
+            if (inView == text[view].size())
+            {
+                ++view;
+                inView = 0;
+                continue;
+            }
+            unsigned char c = text[view][inView++];
+            if ((c & 0xC0) != 0x80)
+                position += (sizeof(wchar_t) == 2 && c >= 0xF0) ? 2 : 1;
+            ++i;
+        }
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+// length of UTF-8 text in wxTextCtrl positions, counted like ToEditorPositions
+static long EditorLength(std::string_view text)
+{
+    long length = 0;
+    for (unsigned char c : text)
+    {
+        if ((c & 0xC0) != 0x80)
+            length += (sizeof(wchar_t) == 2 && c >= 0xF0) ? 2 : 1;
+    }
+    return length;
+}
+
+// read-only view of a document too large for the editor, only the rows in sight are read
+// from the document and drawn, so its size does not matter
+class DocumentView : public wxVScrolledWindow
+{
+public:
+    DocumentView(wxWindow* parent)
+        : wxVScrolledWindow(parent, wxID_ANY, wxDefaultPosition, wxSize(400, 600))
+    {
+        SetFont(wxFont(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+        SetBackgroundColour(wxColour(255, 255, 255));
+        rowHeight = GetCharHeight() + 2;
+        Bind(wxEVT_PAINT, &DocumentView::OnPaint, this);
+    }
+
+    // shows document (null for none) with its rows, the document must stay alive and
+    // unchanged until the next call
+    void SetDocument(const PieceTable* newDocument, LineIndex newRows)
+    {
+        document = newDocument;
+        rows = std::move(newRows);
+        SetRowCount(document ? rows.RowCount() : 0);
+        RefreshAll();
+    }
+
+    // scrolls to the row holding byte offset of the document
+    void ShowOffset(uint64_t offset)
+    {
+        if (document)
+            ScrollToRow(rows.RowAt(*document, offset));
+    }
+
+private:
+    wxCoord OnGetRowHeight(size_t row) const override { return rowHeight; }
+
+    void OnPaint(wxPaintEvent& event)
+    {
+        wxPaintDC dc(this);
+        dc.SetFont(GetFont());
+        if (!document)
+            return;
+
+        size_t first = GetVisibleRowsBegin();
+        std::vector<std::string> visible;
+        rows.ReadRows(*document, first, GetVisibleRowsEnd() - first, visible);
+        for (size_t i = 0; i < visible.size(); ++i)
+            dc.DrawText(wxString::FromUTF8(visible[i].data(), visible[i].size()), 4, static_cast<wxCoord>(i) * rowHeight);
+    }
+
+    const PieceTable* document = nullptr;
+    LineIndex rows;
+    wxCoord rowHeight;
+};
+
+// the fixes of the last analysis, a virtual list asks only for the text of the rows in
+// sight, so millions of findings cost no more than a few
+class FindingsList : public wxListCtrl
+{
+public:
+    FindingsList(wxWindow* parent)
+        : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxSize(400, 250), wxLC_REPORT | wxLC_VIRTUAL)
+    {
+        InsertColumn(0, wxT("Rule"), wxLIST_FORMAT_LEFT, 110);
+        InsertColumn(1, wxT("Position"), wxLIST_FORMAT_LEFT, 90);
+        InsertColumn(2, wxT("Replacement"), wxLIST_FORMAT_LEFT, 180);
+    }
+
+    // lists the records of diagnostics (null for none), positions holds the offset of each
+    // in the corrected text
+    void SetFindings(std::shared_ptr<const AnalysisDiagnostics> newDiagnostics, std::vector<uint64_t> newPositions)
+    {
+        diagnostics = std::move(newDiagnostics);
+        positions = std::move(newPositions);
+        Update();
+    }
+
+    // lists only the fixes of rule, all for AnalysisStage::COUNT
+    void SetRule(AnalysisStage newRule)
+    {
+        rule = newRule;
+        Update();
+    }
+
+    // sorts by the column, a second click on the same column reverses the order
+    void SortByColumn(int column)
+    {
+        DiagnosticOrder newOrder = column == 0 ? DiagnosticOrder::RULE : column == 2 ? DiagnosticOrder::REPLACEMENT : DiagnosticOrder::OFFSET;
+        descending = newOrder == order && !descending;
+        order = newOrder;
+        Update();
+    }
+
+    // offset in the corrected text and length of the fix in row, false if there is none
+    bool FindingAt(long row, uint64_t& position, uint32_t& length) const
+    {
+        if (row < 0 || static_cast<size_t>(row) >= shown.size())
+            return false;
+        uint32_t index = shown[row];
+        position = positions[index];
+        length = diagnostics->records[index].replacementLength;
+        return true;
+    }
+
+private:
+    void Update()
+    {
+        shown.clear();
+        if (diagnostics)
+            shown = SelectDiagnostics(*diagnostics, rule, order);
+        if (descending)
+            std::reverse(shown.begin(), shown.end());
+        SetItemCount(static_cast<long>(shown.size()));
+        if (!shown.empty())
+            RefreshItems(0, static_cast<long>(shown.size()) - 1);
+    }
+
+    wxString OnGetItemText(long item, long column) const override
+    {
+        const Diagnostic& diagnostic = diagnostics->records[shown[item]];
+        if (column == 0)
+            return StageName(diagnostic.stage);
+        if (column == 1)
+            return wxString::Format("%llu", static_cast<unsigned long long>(positions[shown[item]]));
+
+        // line breaks and tabs are shown escaped so each fix stays on one row
+        std::string replacement = "\"";
+        for (char c : diagnostics->Replacement(diagnostic))
+        {
+            if (c == '\n')
+                replacement += "\\n";
+            else if (c == '\t')
+                replacement += "\\t";
+            else
+                replacement += c;
+        }
+        replacement += '"';
+        return wxString::FromUTF8(replacement.data(), replacement.size());
+    }
+
+    std::shared_ptr<const AnalysisDiagnostics> diagnostics;
+    std::vector<uint64_t> positions;
+    std::vector<uint32_t> shown; // indices of the listed records, in list order
+    AnalysisStage rule = AnalysisStage::COUNT;
+    DiagnosticOrder order = DiagnosticOrder::OFFSET;
+    bool descending = false;
 };
 
 // dialog for settings
@@ -55,11 +311,13 @@ public:
         spacingCheckBox = new wxCheckBox(settingsPanel, wxID_ANY, "Fix Spacing Around Punctuation");
         periodCheckBox = new wxCheckBox(settingsPanel, wxID_ANY, "Capitalize After Period");
         codingCheckBox = new wxCheckBox(settingsPanel, wxID_ANY, "Ignore Coding Terms");
+        spellingCheckBox = new wxCheckBox(settingsPanel, wxID_ANY, "Suggest Spelling Corrections");
 
         settingsSizer->Add(capitalizeCheckBox, 0, wxALL, 5);
         settingsSizer->Add(spacingCheckBox, 0, wxALL, 5);
         settingsSizer->Add(periodCheckBox, 0, wxALL, 5);
-        settingsSizer->Add(codingCheckBox, 0, wxALL, 5); // ensures all checkboxes are added
+        settingsSizer->Add(codingCheckBox, 0, wxALL, 5);
+        settingsSizer->Add(spellingCheckBox, 0, wxALL, 5); // ensures all checkboxes are added
         
         settingsPanel->SetSizer(settingsSizer);
         notebook->AddPage(settingsPanel, "Settings");
@@ -94,6 +352,7 @@ public:
     }
 
     wxCheckBox* codingCheckBox;
+    wxCheckBox* spellingCheckBox;
     wxCheckBox* capitalizeCheckBox;
     wxCheckBox* spacingCheckBox;
     wxCheckBox* periodCheckBox;
@@ -204,6 +463,25 @@ private:
     }
 };
 
+// dialog showing the per stage measurements of the last analysis
+class MetricsDialog : public wxDialog
+{
+public:
+    MetricsDialog(wxWindow* parent, const AnalysisMetrics& metrics)
+        : wxDialog(parent, wxID_ANY, wxT("Analysis Metrics"), wxDefaultPosition, wxSize(720, 300), wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER)
+    {
+        wxBoxSizer* dialogSizer = new wxBoxSizer(wxVERTICAL);
+
+        wxTextCtrl* metricsTextCtrl = new wxTextCtrl(this, wxID_ANY, wxString::FromUTF8(FormatMetricsTable(metrics).c_str()),
+            wxDefaultPosition, wxSize(720, 240), wxTE_MULTILINE | wxTE_READONLY);
+        metricsTextCtrl->SetFont(wxFont(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL)); // keeps the columns aligned
+
+        dialogSizer->Add(metricsTextCtrl, 1, wxEXPAND | wxALL, 10);
+        dialogSizer->Add(new wxButton(this, wxID_OK, "OK"), 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
+        SetSizerAndFit(dialogSizer);
+    }
+};
+
 // main frame for the application
 class MyFrame : public wxFrame
 {
@@ -216,27 +494,129 @@ private:
     void OnSaveFile(wxCommandEvent& event);
     void OnNewFile(wxCommandEvent& event);
     void OnRevert(wxCommandEvent& event);
+    void OnRedo(wxCommandEvent& event);
     void OnShowSettings(wxCommandEvent& event);
     void OnShowDocumentation(wxCommandEvent& event);
+    void OnAnalyzeLargeFile(wxCommandEvent& event);
+    void OnAnalysisProgress(wxThreadEvent& event);
+    void OnAnalysisDone(wxThreadEvent& event);
+    void OnTextChanged(wxCommandEvent& event);
+    void OnEditorKeyDown(wxKeyEvent& event);
+    void OnEditorKeyUp(wxKeyEvent& event);
+    void OnToggleLiveAnalysis(wxCommandEvent& event);
+    void OnLiveTimer(wxTimerEvent& event);
+    void OnRecordMetrics(wxCommandEvent& event);
+    void OnShowMetrics(wxCommandEvent& event);
+    void OnExportMetrics(wxCommandEvent& event);
+    void OnClose(wxCloseEvent& event);
     void UpdateUIBasedOnLanguage();
+    void UpdateAnalyzeButton();
+    wxString FormatResultText(const wxString& analysisResult) const;
+
+    // runs work on a worker thread, progress and the finished job come back as thread events
+    void StartAnalysisJob(std::shared_ptr<AnalysisJob> job, std::function<void(AnalysisJob&, const ProgressCallback&)> work);
+    void CancelAnalysis();
+
+    // re-analyzes the paragraphs edited since the last run and fixes them in the editor
+    void RunLiveAnalysis();
+
+    // notes where the text change just made by a keystroke lies for live analysis
+    void NoteLiveEdit();
+
+    // moves liveCursor to the paragraph of the live analyzer holding editor position
+    // (its '\n' included), walking from where the cursor is
+    void MoveLiveCursor(long position);
+
+    // the result cache if it could be opened, else null
+    ResultCache* Cache() { return resultCache.IsOpen() ? &resultCache : nullptr; }
+
+    // records a change of the editor text made from version on as one undo step, the steps
+    // before it are forgotten if the text was typed into since the last recorded step
+    void RecordUndoStep(std::vector<TextEdit> edits, uint64_t version);
+
+    // applies ascending edits with byte offsets in the document to the document and to the
+    // changed ranges of the editor
+    void ApplyEditsToEditor(const std::vector<TextEdit>& edits);
+
+    // the document with the current editor text, read again from the editor only after it
+    // was typed into
+    PieceTable& SyncDocument();
+
+    // puts a file loaded by a job into the editor, or into the document view if it is too large
+    void ShowLoadedFile(AnalysisJob& job);
+
+    // shows the document view instead of the editor, or the editor again
+    void ShowDocumentView(bool show);
+
+    // lists the fixes of a finished analysis job, or none for a null job
+    void ShowFindings(AnalysisJob* job);
+    void OnRuleChosen(wxCommandEvent& event);
+    void OnFindingsColumnClick(wxListEvent& event);
+    void OnFindingSelected(wxListEvent& event);
 
     wxTextCtrl* textCtrl;
+    DocumentView* documentView;
     wxButton* analyzeButton;
     wxButton* openFileButton;
     wxButton* saveFileButton;
     wxButton* newFileButton;
     wxButton* revertButton;
+    wxButton* redoButton;
     wxTextCtrl* resultLabel;
-    wxScrolledWindow* scrolledWindow;
+    wxChoice* ruleChoice;
+    FindingsList* findingsList;
+    wxGauge* progressGauge;
 
     wxDECLARE_EVENT_TABLE();
 
-    std::string previousText;
+    std::shared_ptr<PieceTable> document = std::make_shared<PieceTable>();
+    uint64_t documentVersion = 0; // editor version the document holds
+    bool viewingDocument = false; // the document is shown in documentView, the editor is empty
+
+    UndoHistory undoHistory{ UNDO_MEMORY_LIMIT };
+    uint64_t undoTextVersion = 0; // editor version after the last recorded step
     bool codingTerms = false;
     bool capitalizeFirstLetter = false;
     bool fixSpacing = false;
     bool capitalizeAfterPeriod = false;
+    bool suggestSpelling = false;
     Language currentLanguage = Language::ENGLISH;
+
+    std::thread analysisThread;
+    std::shared_ptr<std::atomic<bool>> analysisCancelled;
+    bool analysisRunning = false;
+    uint64_t textVersion = 0; // increased on every change of the editor text
+
+    wxTimer liveTimer;
+    std::unique_ptr<IncrementalAnalyzer> liveAnalyzer; // set while live analysis is on
+    bool applyingEdits = false; // live analysis is not triggered by these changes
+
+    // the live analyzer holds the editor text of version liveVersion (liveLength positions)
+    // and the keystrokes since then changed only the text between the first livePrefix and
+    // the last liveSuffix positions; any other change makes the next update compare the
+    // whole text
+    bool liveSynced = false;
+    uint64_t liveVersion = 0;
+    long liveLength = 0;
+    long livePrefix = LONG_MAX;
+    long liveSuffix = LONG_MAX;
+    bool liveKeyPressed = false; // between key down and key up in the editor
+    long liveKeyStart = 0;       // start of the selection the key replaces
+
+    // a paragraph of the live analyzer with its editor position and byte offset, kept near
+    // the last edit so finding the edited paragraph costs the distance from it
+    struct LiveCursor
+    {
+        size_t paragraph = 0;
+        long position = 0;
+        size_t offset = 0;
+    } liveCursor;
+
+    bool recordMetrics = false;
+    std::shared_ptr<AnalysisMetrics> lastMetrics; // of the last finished analysis
+
+    // paragraphs analyzed before, in this or an earlier session, shared by all analyses
+    ResultCache resultCache;
 };
 
 wxBEGIN_EVENT_TABLE(MyFrame, wxFrame)
@@ -245,12 +625,22 @@ wxBEGIN_EVENT_TABLE(MyFrame, wxFrame)
     EVT_BUTTON(ID_SAVE_FILE, MyFrame::OnSaveFile)
     EVT_BUTTON(ID_NEW_FILE, MyFrame::OnNewFile)
     EVT_BUTTON(ID_REVERT, MyFrame::OnRevert)
+    EVT_BUTTON(ID_REDO, MyFrame::OnRedo)
     EVT_MENU(ID_SETTINGS, MyFrame::OnShowSettings)
     EVT_MENU(ID_DOCUMENTATION, MyFrame::OnShowDocumentation)
+    EVT_MENU(ID_ANALYZE_LARGE_FILE, MyFrame::OnAnalyzeLargeFile)
+    EVT_THREAD(ID_ANALYSIS_PROGRESS, MyFrame::OnAnalysisProgress)
+    EVT_THREAD(ID_ANALYSIS_DONE, MyFrame::OnAnalysisDone)
+    EVT_MENU(ID_LIVE_ANALYSIS, MyFrame::OnToggleLiveAnalysis)
+    EVT_TIMER(ID_LIVE_TIMER, MyFrame::OnLiveTimer)
+    EVT_MENU(ID_RECORD_METRICS, MyFrame::OnRecordMetrics)
+    EVT_MENU(ID_SHOW_METRICS, MyFrame::OnShowMetrics)
+    EVT_MENU(ID_EXPORT_METRICS, MyFrame::OnExportMetrics)
+    EVT_CLOSE(MyFrame::OnClose)
 wxEND_EVENT_TABLE()
 
 MyFrame::MyFrame(const wxString& title)
-    : wxFrame(NULL, wxID_ANY, title, wxDefaultPosition, wxSize(800, 500))
+    : wxFrame(NULL, wxID_ANY, title, wxDefaultPosition, wxSize(800, 500)), liveTimer(this, ID_LIVE_TIMER)
 {
     wxPanel* panel = new wxPanel(this, wxID_ANY);
 
@@ -258,43 +648,72 @@ MyFrame::MyFrame(const wxString& title)
     wxBoxSizer* leftSizer = new wxBoxSizer(wxVERTICAL);
 
     textCtrl = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(400, 600), wxTE_MULTILINE);
+    documentView = new DocumentView(panel);
+    documentView->Hide();
     analyzeButton = new wxButton(panel, ID_ANALYZE_TEXT, "Analyze Text");
     openFileButton = new wxButton(panel, ID_OPEN_FILE, "Open File");
     saveFileButton = new wxButton(panel, ID_SAVE_FILE, "Save File");
     newFileButton = new wxButton(panel, ID_NEW_FILE, "New File");
     revertButton = new wxButton(panel, ID_REVERT, "Revert Changes");
+    redoButton = new wxButton(panel, ID_REDO, "Redo Changes");
+    progressGauge = new wxGauge(panel, wxID_ANY, 100);
+    progressGauge->Hide();
+
+    // only the editor bumps the text version, not the results box
+    textCtrl->Bind(wxEVT_TEXT, &MyFrame::OnTextChanged, this);
+    textCtrl->Bind(wxEVT_KEY_DOWN, &MyFrame::OnEditorKeyDown, this);
+    textCtrl->Bind(wxEVT_KEY_UP, &MyFrame::OnEditorKeyUp, this);
 
     wxMenuBar* menuBar = new wxMenuBar;
     wxMenu* menu = new wxMenu;
     menu->Append(ID_SETTINGS, "Settings");
     menu->Append(ID_DOCUMENTATION, "Documentation");
+    menu->Append(ID_ANALYZE_LARGE_FILE, "Analyze Large File...");
+    menu->AppendCheckItem(ID_LIVE_ANALYSIS, "Live Analysis");
+    menu->AppendSeparator();
+    menu->AppendCheckItem(ID_RECORD_METRICS, "Record Metrics");
+    menu->Append(ID_SHOW_METRICS, "Show Metrics");
+    menu->Append(ID_EXPORT_METRICS, "Export Metrics...");
     menuBar->Append(menu, "Options");
     SetMenuBar(menuBar);
 
-    scrolledWindow = new wxScrolledWindow(panel, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxVSCROLL);
-    scrolledWindow->SetScrollRate(5, 5);
-    resultLabel = new wxTextCtrl(scrolledWindow, wxID_ANY, "", wxDefaultPosition, wxSize(400, 600), wxTE_MULTILINE | wxTE_READONLY);
-
-    wxBoxSizer* resultSizer = new wxBoxSizer(wxVERTICAL);
-    resultSizer->Add(resultLabel, 1, wxEXPAND | wxALL, 10);
-    scrolledWindow->SetSizer(resultSizer);
+    // the summary stays a few lines long, each fix is a row of the findings list
+    resultLabel = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(400, 150), wxTE_MULTILINE | wxTE_READONLY);
+    ruleChoice = new wxChoice(panel, wxID_ANY);
+    findingsList = new FindingsList(panel);
+    ShowFindings(nullptr);
+    ruleChoice->Bind(wxEVT_CHOICE, &MyFrame::OnRuleChosen, this);
+    findingsList->Bind(wxEVT_LIST_COL_CLICK, &MyFrame::OnFindingsColumnClick, this);
+    findingsList->Bind(wxEVT_LIST_ITEM_SELECTED, &MyFrame::OnFindingSelected, this);
 
     leftSizer->Add(textCtrl, 1, wxEXPAND | wxALL, 10);
+    leftSizer->Add(documentView, 1, wxEXPAND | wxALL, 10);
     leftSizer->Add(analyzeButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
+    leftSizer->Add(progressGauge, 0, wxEXPAND | wxLEFT | wxRIGHT, 10);
     leftSizer->Add(openFileButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
     leftSizer->Add(saveFileButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
     leftSizer->Add(newFileButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
     leftSizer->Add(revertButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
-    leftSizer->Add(scrolledWindow, 1, wxEXPAND | wxALL, 10);
+    leftSizer->Add(redoButton, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 10);
+    leftSizer->Add(resultLabel, 0, wxEXPAND | wxALL, 10);
+    leftSizer->Add(ruleChoice, 0, wxEXPAND | wxLEFT | wxRIGHT, 10);
+    leftSizer->Add(findingsList, 1, wxEXPAND | wxALL, 10);
 
     panel->SetSizer(leftSizer);
 
+    // without the cache (e.g. while another window of the program has it) everything is
+    // analyzed as before
+    std::string cacheError;
+    if (!resultCache.Open(DefaultResultCachePath(), ResultCache::DEFAULT_CAPACITY, cacheError))
+        std::cerr << "not using the result cache: " << cacheError << "\n";
+
     // initial update based on default language and settings
     UpdateUIBasedOnLanguage();
     capitalizeFirstLetter = false; 
     fixSpacing = false;            
     capitalizeAfterPeriod = false;
     codingTerms = false;
+    suggestSpelling = false;
 }
 
 void MyFrame::UpdateUIBasedOnLanguage()
@@ -302,171 +721,64 @@ void MyFrame::UpdateUIBasedOnLanguage()
     switch (currentLanguage)
     {
     case Language::ENGLISH:
-        analyzeButton->SetLabel(wxT("Analyze Text"));
         openFileButton->SetLabel(wxT("Open File"));
         saveFileButton->SetLabel(wxT("Save File"));
         newFileButton->SetLabel(wxT("New File"));
         revertButton->SetLabel(wxT("Revert Changes"));
+        redoButton->SetLabel(wxT("Redo Changes"));
         resultLabel->SetLabel(wxT("Analysis Results:"));\
         break;
     case Language::SPANISH:
-        analyzeButton->SetLabel(wxT("Analizar Texto"));
         openFileButton->SetLabel(wxT("Abrir Archivo"));
         saveFileButton->SetLabel(wxT("Guardar Archivo"));
         newFileButton->SetLabel(wxT("Nuevo Archivo"));
         revertButton->SetLabel(wxT("Revertir Cambios"));
+        redoButton->SetLabel(wxT("Rehacer Cambios"));
         resultLabel->SetLabel(wxT("Resultados del Análisis:"));
         break;
     case Language::FRENCH:
-        analyzeButton->SetLabel(wxT("Analyser le Texte"));
         openFileButton->SetLabel(wxT("Ouvrir le Fichier"));
         saveFileButton->SetLabel(wxT("Enregistrer le Fichier"));
         newFileButton->SetLabel(wxT("Nouveau Fichier"));
         revertButton->SetLabel(wxT("Annuler les Changements"));
+        redoButton->SetLabel(wxT("Rétablir les Changements"));
         resultLabel->SetLabel(wxT("Résultats de l'Analyse:"));
         break;
     case Language::POLISH:
-        analyzeButton->SetLabel(wxT("Analizuj Tekst"));
         openFileButton->SetLabel(wxT("Otwórz Plik"));
         saveFileButton->SetLabel(wxT("Zapisz Plik"));
         newFileButton->SetLabel(wxT("Nowy Plik"));
         revertButton->SetLabel(wxT("Cofnij Zmiany"));
+        redoButton->SetLabel(wxT("Ponów Zmiany"));
         resultLabel->SetLabel(wxT("Wyniki Analizy:"));
         break;
     }
+    UpdateAnalyzeButton();
 }
-std::string SprawdzPostawiene(std::string& text, bool capitalizeFirstLetter, bool fixSpacing, bool capitalizeAfterPeriod, bool codingTerms)
-{
-    std::string wynik;
-    initialLikeness = 1.0f;  
-    likeness = 1.0f;
-    likenessChange = 0.0f;
 
-    std::set<std::string> codingTermsWords = {"float","double", "int", "double"};
-
-    // checks if the first word should be capitalized
-    if (capitalizeFirstLetter && !text.empty())
-    {
-        // extracts the first word
-        std::string::size_type firstWordEnd = text.find_first_of(" ,.!;\n");
-        std::string firstWord = text.substr(0, firstWordEnd);
-
-        // checks if the first word is a coding term
-        bool isCodingTerm = codingTermsWords.find(firstWord) != codingTermsWords.end();
-        
-        // capitalize the first letter if it's not a coding term
-        if (!(codingTerms && isCodingTerm) && std::islower(text[0]))
-        {
-            text[0] = std::toupper(text[0]);
-            wynik += "Converted the first letter to uppercase.\n";
-            likeness -= 0.1f;
-        }
-    }
-
-    // process the entire text
-    std::string old_text = text;
-
-    if (fixSpacing)
-    {
-        text = std::regex_replace(text, std::regex("\\s+([,.])"), "$1");
-        text = std::regex_replace(text, std::regex("([,.])([a-zA-Z])"), "$1 $2");
-        text = std::regex_replace(text, std::regex("\\s{2,}"), " ");
-
-        if (text != old_text) {
-            wynik += "Fixed spaces around punctuation.\n";
-            likeness -= 0.1f;
-        }
-    }
-
-    if (capitalizeAfterPeriod)
-    {
-        for (size_t i = 0; i < text.length(); ++i)
-        {
-            if (text[i] == '.' && i < text.length() - 1)
-            {
-                size_t j = i + 1;
-                while (j < text.length() && std::isspace(text[j])) ++j;
-                std::string nextWord;
-                size_t nextWordStart = j;
-                while (j < text.length() && text[j] != ' ' && text[j] != '.' && text[j] != ',' && text[j] != '!' && text[j] != ';') {
-                    nextWord += text[j++];
-                }
-                
-                if (!nextWord.empty() && std::islower(nextWord[0]) && 
-                    (codingTerms ? codingTermsWords.find(nextWord) == codingTermsWords.end() : true))
-                {
-                    text[nextWordStart] = std::toupper(text[nextWordStart]);
-                    wynik += "Capitalized after period.\n";
-                    likeness -= 0.1f;
-                }
-            }
-        }
-    }
-
-    // capitalizes the first letter of each sentence unless it's a coding term
-    if (capitalizeFirstLetter && !codingTerms)
-    {
-        std::string new_text;
-        std::stringstream ss(text);
-        std::string word;
-        bool newSentence = true; // flag to see if a new sentence starts
-        while (ss >> word)
-        {
-            if (newSentence && codingTermsWords.find(word) == codingTermsWords.end())
-            {
-                if (std::islower(word[0]))
-                {
-                    word[0] = std::toupper(word[0]);
-                }
-            }
-            new_text += word + " ";
-            newSentence = (word.back() == '.'); // assumes sentence ends with a period
-        }
-        text = new_text;
-    }
-
-    std::map<std::string, std::string> replacements = {{"teh", "the"}, {"recieve", "receive"}, {"adn", "and"}};
-    for (const auto& pair : replacements)
-    {
-        std::regex word_regex("\\b" + pair.first + "\\b");
-        if (std::regex_search(text, word_regex))
-        {
-            text = std::regex_replace(text, word_regex, pair.second);
-            likeness -= 0.1f;
-        }
-    }
-
-    if (likeness != initialLikeness)
+// the analyze button turns into a cancel button while an analysis runs
+void MyFrame::UpdateAnalyzeButton()
+{
+    switch (currentLanguage)
     {
-        wynik += "Text analysis completed.\n";
-        likenessChange = initialLikeness - likeness;
+    case Language::ENGLISH:
+        analyzeButton->SetLabel(analysisRunning ? wxT("Cancel Analysis") : wxT("Analyze Text"));
+        break;
+    case Language::SPANISH:
+        analyzeButton->SetLabel(analysisRunning ? wxT("Cancelar Análisis") : wxT("Analizar Texto"));
+        break;
+    case Language::FRENCH:
+        analyzeButton->SetLabel(analysisRunning ? wxT("Annuler l'Analyse") : wxT("Analyser le Texte"));
+        break;
+    case Language::POLISH:
+        analyzeButton->SetLabel(analysisRunning ? wxT("Anuluj Analizę") : wxT("Analizuj Tekst"));
+        break;
     }
-
-    return wynik;
 }
 
-void MyFrame::OnAnalyze(wxCommandEvent& event)
+// adds the localized header to the analysis messages
+wxString MyFrame::FormatResultText(const wxString& analysisResult) const
 {
-    // stores the current text from textCtrl into previousText
-    previousText = textCtrl->GetValue().ToStdString();  // convert wxString to std::string
-    
-    // retrieves the text from wxTextCtrl and convert it to std::string
-    wxString text = textCtrl->GetValue();
-    std::string text_std = text.ToStdString(); // convert wxString to std::string
-
-    // starts timing
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    // analyzes the text
-    std::string analysis = SprawdzPostawiene(text_std, capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms);
-    
-    // stops timing
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = end - start;
-
-    // convertes analysis result from std::string to wxString
-    wxString analysisResult = wxString::FromUTF8(analysis.c_str());
-
     wxString resultText;
     switch (currentLanguage)
     {
@@ -503,22 +815,412 @@ void MyFrame::OnAnalyze(wxCommandEvent& event)
             break;
     }
 
-    resultLabel->SetValue(resultText);
+    return resultText;
+}
+
+void MyFrame::OnAnalyze(wxCommandEvent& event)
+{
+    // a click while an analysis is running cancels it
+    if (analysisRunning)
+    {
+        CancelAnalysis();
+        return;
+    }
+
+    auto job = std::make_shared<AnalysisJob>();
+    job->updatesEditor = true;
+    job->textVersion = textVersion;
+    if (recordMetrics)
+        job->metrics = std::make_shared<AnalysisMetrics>();
+
+    // the worker reads the document without copying it, the editor stays usable meanwhile
+    SyncDocument();
+    job->document = document;
+
+    // there are at most about as many fixes as bytes, the records grow with the fixes found
+    job->diagnostics = std::make_shared<AnalysisDiagnostics>(std::min<size_t>(document->Size() + 1, MAX_LISTED_FINDINGS));
+
+    AnalysisSettings settings{ capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms, suggestSpelling };
+    const RulePack* rules = &RulePackFor(currentLanguage);
+    ResultCache* cache = Cache();
+    StartAnalysisJob(job, [settings, rules, cache](AnalysisJob& job, const ProgressCallback& progress)
+    {
+        job.bytes = job.document->Size();
+        AnalysisState state;
+        if (!AnalyzeDocument(*job.document, settings, *rules, state, job.edits, progress, job.metrics.get(), job.diagnostics.get(),
+                             cache))
+            return;
+        job.report = FinishAnalysis(state);
+
+        // the list shows where each fix is in the corrected text, not in the analyzed one
+        job.findingPositions.reserve(job.diagnostics->records.size());
+        for (const Diagnostic& diagnostic : job.diagnostics->records)
+            job.findingPositions.push_back(diagnostic.offset);
+        MapOffsetsThroughEdits(job.edits, job.findingPositions);
+    });
+}
+
+void MyFrame::StartAnalysisJob(std::shared_ptr<AnalysisJob> job, std::function<void(AnalysisJob&, const ProgressCallback&)> work)
+{
+    analysisCancelled = std::make_shared<std::atomic<bool>>(false);
+    analysisRunning = true;
+    UpdateAnalyzeButton();
+    progressGauge->SetValue(0);
+    progressGauge->Show();
+    progressGauge->GetParent()->Layout();
+
+    std::shared_ptr<std::atomic<bool>> cancelled = analysisCancelled;
+    analysisThread = std::thread([this, job, work, cancelled]
+    {
+        int lastPercent = -1;
+        ProgressCallback progress = [this, cancelled, &lastPercent](size_t done, size_t total)
+        {
+            // posts only when the shown percentage changes
+            int percent = total > 0 ? static_cast<int>(done * 100 / total) : 100;
+            if (percent != lastPercent)
+            {
+                lastPercent = percent;
+                wxThreadEvent* event = new wxThreadEvent(wxEVT_THREAD, ID_ANALYSIS_PROGRESS);
+                event->SetInt(percent);
+                wxQueueEvent(this, event);
+            }
+            return !cancelled->load();
+        };
+
+        auto start = std::chrono::high_resolution_clock::now();
+        work(*job, progress);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        job->seconds = elapsed.count();
+        job->cancelled = cancelled->load();
+
+        wxThreadEvent* event = new wxThreadEvent(wxEVT_THREAD, ID_ANALYSIS_DONE);
+        event->SetPayload(job);
+        wxQueueEvent(this, event);
+    });
+}
+
+void MyFrame::CancelAnalysis()
+{
+    if (analysisCancelled)
+        analysisCancelled->store(true);
+}
+
+void MyFrame::OnAnalysisProgress(wxThreadEvent& event)
+{
+    if (analysisRunning)
+        progressGauge->SetValue(event.GetInt());
+}
+
+void MyFrame::OnAnalysisDone(wxThreadEvent& event)
+{
+    // the worker posts this as its last step, so joining does not block
+    if (analysisThread.joinable())
+        analysisThread.join();
+    analysisRunning = false;
+    UpdateAnalyzeButton();
+    progressGauge->Hide();
+    progressGauge->GetParent()->Layout();
+
+    std::shared_ptr<AnalysisJob> job = event.GetPayload<std::shared_ptr<AnalysisJob>>();
+    job->document.reset(); // the document can be changed in place again
+    if (job->cancelled)
+    {
+        resultLabel->SetValue(job->loadsFile ? wxT("Loading cancelled.") : job->savesFile ? wxT("Saving cancelled, the file was left as it was.") : wxT("Analysis cancelled."));
+        return;
+    }
+    if (!job->error.empty())
+    {
+        wxLogError("%s", wxString::FromUTF8(job->error.c_str()));
+        return;
+    }
+    if (job->loadsFile)
+    {
+        ShowLoadedFile(*job);
+        return;
+    }
+    if (job->savesFile)
+    {
+        wxString saveStr;
+        saveStr.Printf("Saved %.1f MB in %.4f seconds (%.1f MB/s)", job->bytes / 1e6, job->seconds,
+                       job->seconds > 0 ? job->bytes / 1e6 / job->seconds : 0.0);
+        resultLabel->SetValue(saveStr);
+        return;
+    }
+    if (job->metrics)
+        lastMetrics = job->metrics;
+
+    if (job->updatesEditor)
+    {
+        // results for a text that was edited meanwhile would overwrite the edits
+        if (job->textVersion != textVersion)
+        {
+            resultLabel->SetValue(wxT("The text was changed during the analysis, the results were discarded."));
+            return;
+        }
+
+        // replaces only the fixed ranges, the fixes are kept so they can be reverted
+        uint64_t version = textVersion;
+        ApplyEditsToEditor(job->edits);
+        RecordUndoStep(std::move(job->edits), version);
+        undoTextVersion = textVersion;
+    }
+
+    // convertes analysis result from std::string to wxString
+    // the messages are only put into words here, in the language of the interface
+    wxString analysisResult = wxString::FromUTF8(FormatFindings(job->report, currentLanguage).c_str());
+
+    resultLabel->SetValue(FormatResultText(analysisResult));
     // showes elapsed time
     wxString timeStr;
-    timeStr.Printf("\nTime taken for analysis: %.4f seconds", elapsed.count());
+    timeStr.Printf("\nTime taken for analysis: %.4f seconds (%.1f MB)", job->seconds, job->bytes / 1e6);
     resultLabel->AppendText(timeStr);
+    if (job->diagnostics && job->diagnostics->dropped > 0)
+        resultLabel->AppendText(wxString::Format("\nOnly the first %zu fixes are listed", job->diagnostics->records.size()));
 
-    // updates the wxTextCtrl with the analyzed text
-    textCtrl->SetValue(wxString::FromUTF8(text_std.c_str())); // convert std::string back to wxString
+    ShowFindings(job.get());
+}
 
-    // adjustes the scrollable window
-    scrolledWindow->FitInside();
+void MyFrame::OnTextChanged(wxCommandEvent& event)
+{
+    ++textVersion;
+    // live analysis waits for a pause in typing
+    if (liveAnalyzer && !applyingEdits)
+    {
+        NoteLiveEdit();
+        liveTimer.StartOnce(LIVE_ANALYSIS_DELAY_MS);
+    }
+    event.Skip();
 }
 
+void MyFrame::OnEditorKeyDown(wxKeyEvent& event)
+{
+    // shortcuts other than paste and cut (the native undo of some platforms) may change
+    // the text anywhere
+    int key = event.GetKeyCode();
+    long from = 0;
+    long to = 0;
+    textCtrl->GetSelection(&from, &to);
+    liveKeyPressed = !event.CmdDown() || key == 'V' || key == 'X';
+    liveKeyStart = from;
+    event.Skip();
+}
+
+void MyFrame::OnEditorKeyUp(wxKeyEvent& event)
+{
+    liveKeyPressed = false;
+    event.Skip();
+}
 
+void MyFrame::NoteLiveEdit()
+{
+    // a key changes the text from the start of the selection it replaced (or the caret,
+    // when deleting backwards) to the caret after the change; changes made otherwise (with
+    // the mouse, by an input method) are not located
+    bool located = liveSynced && liveKeyPressed && liveVersion + 1 == textVersion;
+    long length = textCtrl->GetLastPosition();
+    long caret = textCtrl->GetInsertionPoint();
+    long start = std::min(liveKeyStart, caret);
+    long suffix = length - caret;
+    if (located && start >= 0 && suffix >= 0)
+    {
+        livePrefix = std::min(livePrefix, start);
+        liveSuffix = std::min(liveSuffix, suffix);
+        liveVersion = textVersion;
+        located = livePrefix <= length - liveSuffix && livePrefix <= liveLength - liveSuffix;
+    }
+    liveSynced = located;
+    // a key making several changes continues from where the last one ended
+    liveKeyStart = caret;
+}
+
+void MyFrame::MoveLiveCursor(long position)
+{
+    LiveCursor& cursor = liveCursor;
+    while (cursor.paragraph > 0 && cursor.position > position)
+    {
+        const std::string& previous = liveAnalyzer->ParagraphText(--cursor.paragraph);
+        cursor.position -= EditorLength(previous) + 1;
+        cursor.offset -= previous.size() + 1;
+    }
+    while (cursor.paragraph + 1 < liveAnalyzer->ParagraphCount())
+    {
+        const std::string& text = liveAnalyzer->ParagraphText(cursor.paragraph);
+        long end = cursor.position + EditorLength(text);
+        if (position <= end)
+            break;
+        cursor.position = end + 1;
+        cursor.offset += text.size() + 1;
+        ++cursor.paragraph;
+    }
+}
 
-// opens a file with UTF-8 encoding
+void MyFrame::OnToggleLiveAnalysis(wxCommandEvent& event)
+{
+    if (event.IsChecked())
+    {
+        AnalysisSettings settings{ capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms, suggestSpelling };
+        liveAnalyzer = std::make_unique<IncrementalAnalyzer>(settings, RulePackFor(currentLanguage));
+        liveAnalyzer->SetCache(Cache());
+        liveSynced = false;
+        RunLiveAnalysis();
+    }
+    else
+    {
+        liveTimer.Stop();
+        liveAnalyzer.reset();
+    }
+}
+
+void MyFrame::OnLiveTimer(wxTimerEvent& event)
+{
+    RunLiveAnalysis();
+}
+
+void MyFrame::RunLiveAnalysis()
+{
+    // the document view cannot be typed into
+    if (!liveAnalyzer || viewingDocument)
+        return;
+    // a background analysis will replace the text, tries again after it
+    if (analysisRunning)
+    {
+        liveTimer.StartOnce(LIVE_ANALYSIS_DELAY_MS);
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<IncrementalAnalyzer::Fix> fixes;
+    std::vector<std::string_view> views; // the editor text the fixes were made in, from viewStart
+    std::string window;
+    long viewStart = 0;
+    size_t offsetStart = 0; // byte offset of viewStart in the document
+    std::string text;
+    if (liveSynced && liveVersion == textVersion)
+    {
+        if (livePrefix == LONG_MAX)
+            return; // not typed into since the last update
+
+        // reads only the paragraphs the keystrokes touched from the editor
+        MoveLiveCursor(livePrefix);
+        LiveCursor first = liveCursor;
+        MoveLiveCursor(liveLength - liveSuffix);
+        const size_t last = liveCursor.paragraph;
+        long oldEnd = liveCursor.position + EditorLength(liveAnalyzer->ParagraphText(last));
+        liveCursor = first;
+        long newEnd = oldEnd + textCtrl->GetLastPosition() - liveLength;
+        window = ToUTF8String(textCtrl->GetRange(first.position, newEnd));
+
+        std::vector<std::string> paragraphs;
+        for (size_t position = 0;;)
+        {
+            size_t newline = window.find('\n', position);
+            paragraphs.push_back(window.substr(position, newline == std::string::npos ? std::string::npos : newline - position));
+            if (newline == std::string::npos)
+                break;
+            position = newline + 1;
+        }
+        const size_t windowParagraphs = paragraphs.size();
+        fixes = liveAnalyzer->Replace(first.paragraph, last - first.paragraph + 1, paragraphs);
+
+        // the fixes may reach past the window into paragraphs the editor still holds as the
+        // analyzer had them
+        views.push_back(window);
+        size_t end = fixes.empty() ? 0 : fixes.back().paragraph + 1;
+        size_t fixIndex = 0;
+        for (size_t i = first.paragraph + windowParagraphs; i < end; ++i)
+        {
+            while (fixes[fixIndex].paragraph < i)
+                ++fixIndex;
+            views.push_back("\n");
+            if (fixes[fixIndex].paragraph == i)
+                views.push_back(fixes[fixIndex].original);
+            else
+                views.push_back(liveAnalyzer->ParagraphText(i));
+        }
+        viewStart = first.position;
+        offsetStart = first.offset;
+    }
+    else
+    {
+        text = ToUTF8String(textCtrl->GetValue());
+        fixes = liveAnalyzer->Update(text);
+        views.push_back(text);
+        liveCursor = LiveCursor();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    if (!fixes.empty())
+    {
+        std::vector<size_t> offsets;
+        for (const IncrementalAnalyzer::Fix& fix : fixes)
+        {
+            offsets.push_back(fix.offset);
+            offsets.push_back(fix.offset + fix.length);
+        }
+        std::vector<long> positions = ToEditorPositions(views, offsets);
+
+        // the fixed paragraphs become one undo step
+        std::vector<TextEdit> edits;
+        for (IncrementalAnalyzer::Fix& fix : fixes)
+            edits.push_back(TextEdit{ offsetStart + fix.offset, std::move(fix.original), fix.corrected });
+        uint64_t version = textVersion;
+
+        // replaces only the fixed paragraphs, last first so the earlier positions stay valid
+        long caret = textCtrl->GetInsertionPoint();
+        applyingEdits = true;
+        textCtrl->Freeze();
+        for (size_t i = fixes.size(); i-- > 0;)
+        {
+            long from = viewStart + positions[2 * i];
+            long to = viewStart + positions[2 * i + 1];
+            wxString corrected = wxString::FromUTF8(fixes[i].corrected.data(), fixes[i].corrected.size());
+            long correctedEnd = from + static_cast<long>(corrected.length());
+            textCtrl->Replace(from, to, corrected);
+
+            // keeps the caret at the same distance from the end of its paragraph
+            if (caret >= to)
+                caret += correctedEnd - to;
+            else if (caret > from)
+                caret = std::max(from, correctedEnd - (to - caret));
+        }
+        textCtrl->Thaw();
+        applyingEdits = false;
+        textCtrl->SetInsertionPoint(caret);
+
+        RecordUndoStep(std::move(edits), version);
+        undoTextVersion = textVersion;
+    }
+
+    // the analyzer now holds the editor text
+    liveSynced = true;
+    liveVersion = textVersion;
+    liveLength = textCtrl->GetLastPosition();
+    livePrefix = LONG_MAX;
+    liveSuffix = LONG_MAX;
+    if (liveAnalyzer->ParagraphsAnalyzedLastUpdate() == 0)
+        return;
+
+    wxString analysisResult = wxString::FromUTF8(FormatFindings(FinishAnalysis(liveAnalyzer->Totals()), currentLanguage).c_str());
+    resultLabel->SetValue(FormatResultText(analysisResult));
+    wxString liveStr;
+    liveStr.Printf("\nLive analysis: %zu of %zu paragraphs analyzed in %.4f seconds",
+                   liveAnalyzer->ParagraphsAnalyzedLastUpdate(), liveAnalyzer->ParagraphCount(), elapsed.count());
+    resultLabel->AppendText(liveStr);
+    // the positions listed by the last full analysis no longer hold
+    ShowFindings(nullptr);
+}
+
+// stops a running analysis before the frame goes away
+void MyFrame::OnClose(wxCloseEvent& event)
+{
+    liveTimer.Stop();
+    CancelAnalysis();
+    if (analysisThread.joinable())
+        analysisThread.join();
+    event.Skip();
+}
+
+// opens a file with UTF-8 encoding, on a worker thread with progress like an analysis
 void MyFrame::OnOpenFile(wxCommandEvent& event)
 {
     wxFileDialog openFileDialog(this, _("Open Text file"), "", "",
@@ -527,14 +1229,120 @@ void MyFrame::OnOpenFile(wxCommandEvent& event)
     if (openFileDialog.ShowModal() == wxID_CANCEL)
         return;
 
-    previousText = textCtrl->GetValue().ToStdString(); // Stores the current text
-    std::ifstream file(openFileDialog.GetPath().ToStdString(), std::ios::in | std::ios::binary);
-    if (file.is_open())
+    if (analysisRunning)
+    {
+        wxLogError("Wait for the running analysis to finish or cancel it first");
+        return;
+    }
+
+    std::string path = openFileDialog.GetPath().ToStdString();
+    auto job = std::make_shared<AnalysisJob>();
+    job->loadsFile = true;
+    StartAnalysisJob(job, [path](AnalysisJob& job, const ProgressCallback& progress)
+    {
+        // the file is mapped and validated as UTF-8, invalid bytes are replaced
+        LoadedText loaded;
+        if (!LoadTextFile(path, loaded, progress))
+        {
+            job.error = "Could not open file";
+            return;
+        }
+        job.bytes = loaded.text.size();
+        job.replacedBytes = loaded.replacedBytes;
+        job.loadedForView = loaded.text.size() > EDITOR_SIZE_LIMIT;
+
+        // the conversion for the editor (with its length, NUL bytes do not end it) and the
+        // rows of the document view are made here, not on the UI thread
+        if (!job.loadedForView)
+            job.loadedEditorText = wxString::FromUTF8(loaded.text.data(), loaded.text.size());
+        job.loadedDocument = std::make_shared<PieceTable>(std::move(loaded.text));
+        if (job.loadedForView)
+            job.loadedRows.Build(*job.loadedDocument);
+    });
+}
+
+void MyFrame::ShowLoadedFile(AnalysisJob& job)
+{
+    // the history starts over with the new file, a step holding both whole texts would
+    // take more memory than the file itself
+    undoHistory.Clear();
+    ShowDocumentView(job.loadedForView);
+    textCtrl->ChangeValue(job.loadedForView ? wxString() : job.loadedEditorText);
+    ++textVersion;
+    undoTextVersion = textVersion;
+    if (liveAnalyzer && !job.loadedForView)
+        liveTimer.StartOnce(LIVE_ANALYSIS_DELAY_MS);
+
+    document = job.loadedDocument;
+    documentVersion = textVersion;
+    documentView->SetDocument(job.loadedForView ? document.get() : nullptr, std::move(job.loadedRows));
+
+    wxString loadStr;
+    loadStr.Printf("Loaded %.1f MB in %.4f seconds", job.bytes / 1e6, job.seconds);
+    if (job.loadedForView)
+        loadStr += wxT(", too large for the editor, shown read-only");
+    if (job.replacedBytes > 0)
+        loadStr += wxString::Format(", %zu invalid UTF-8 bytes replaced", job.replacedBytes);
+    resultLabel->SetValue(loadStr);
+    ShowFindings(nullptr);
+}
+
+void MyFrame::ShowFindings(AnalysisJob* job)
+{
+    findingsList->SetFindings(job ? job->diagnostics : nullptr, job ? std::move(job->findingPositions) : std::vector<uint64_t>());
+
+    // one entry per rule with its number of fixes, the chosen rule stays chosen
+    int chosen = ruleChoice->GetSelection();
+    ruleChoice->Clear();
+    ruleChoice->Append(wxT("All rules"));
+    for (int s = 0; s < static_cast<int>(AnalysisStage::COUNT); ++s)
+    {
+        uint64_t count = job && job->diagnostics ? job->diagnostics->counts[s] : 0;
+        ruleChoice->Append(wxString::Format("%s (%llu)", StageName(static_cast<AnalysisStage>(s)), static_cast<unsigned long long>(count)));
+    }
+    ruleChoice->SetSelection(chosen > 0 ? chosen : 0);
+}
+
+void MyFrame::OnRuleChosen(wxCommandEvent& event)
+{
+    int chosen = ruleChoice->GetSelection();
+    findingsList->SetRule(chosen > 0 ? static_cast<AnalysisStage>(chosen - 1) : AnalysisStage::COUNT);
+}
+
+void MyFrame::OnFindingsColumnClick(wxListEvent& event)
+{
+    findingsList->SortByColumn(event.GetColumn());
+}
+
+// shows the fix of the clicked row in the editor or the document view
+void MyFrame::OnFindingSelected(wxListEvent& event)
+{
+    uint64_t position;
+    uint32_t length;
+    if (!findingsList->FindingAt(event.GetIndex(), position, length))
+        return;
+
+    // the text may have changed since, the position is kept inside it
+    PieceTable& current = SyncDocument();
+    position = std::min<uint64_t>(position, current.Size());
+    length = static_cast<uint32_t>(std::min<uint64_t>(length, current.Size() - position));
+    if (viewingDocument)
     {
-        std::string content((std::istreambuf_iterator<char>(file)),
-                             std::istreambuf_iterator<char>());
-        textCtrl->SetValue(wxString::FromUTF8(content.c_str()));
+        documentView->ShowOffset(position);
+        return;
     }
+
+    std::vector<long> positions = ToEditorPositions(current.Views(), { position, position + length });
+    textCtrl->SetSelection(positions[0], positions[1]);
+    textCtrl->ShowPosition(positions[0]);
+}
+
+void MyFrame::ShowDocumentView(bool show)
+{
+    viewingDocument = show;
+    textCtrl->Show(!show);
+    documentView->Show(show);
+    textCtrl->GetParent()->Layout();
 }
 
 // saves a file with UTF-8 encoding
@@ -548,43 +1356,150 @@ void MyFrame::OnSaveFile(wxCommandEvent& event)
     if (saveFileDialog.ShowModal() == wxID_CANCEL)
         return;
 
-    // gets the file path from the dialog
-    wxString filePath = saveFileDialog.GetPath();
-    
-    // open the file for writing in binary mode
-    std::ofstream file(filePath.ToStdString(), std::ios::out | std::ios::binary);
-    
-    // checks if the file was successfully opened
-    if (file.is_open())
-    {
-        // gets the text from the wxTextCtrl
-        std::string content = textCtrl->GetValue().ToStdString();
-        
-        // writes the content to the file
-        file << content;
-        
-        // closes the file
-        file.close();
-    }
-    else
+    if (analysisRunning)
     {
-        // handles error if the file could not be opened
-        wxLogError("Could not open file for saving");
+        wxLogError("Wait for the running analysis to finish or cancel it first");
+        return;
     }
+
+    // the worker writes the document as it is now, straight from its pieces, later edits go
+    // to a copy of it
+    std::string path = saveFileDialog.GetPath().ToStdString();
+    auto job = std::make_shared<AnalysisJob>();
+    job->savesFile = true;
+    SyncDocument();
+    job->document = document;
+    StartAnalysisJob(job, [path](AnalysisJob& job, const ProgressCallback& progress)
+    {
+        // written to a temporary file renamed over path when complete, a crash, a failed
+        // write or a cancel leaves the old file (a cancel is reported before the error)
+        job.bytes = job.document->Size();
+        if (!SaveDocument(*job.document, path, progress))
+            job.error = "Could not save the file";
+    });
 }
 
 
 
 void MyFrame::OnNewFile(wxCommandEvent& event)
 {
-    previousText = textCtrl->GetValue().ToStdString(); // stores the current text
+    if (viewingDocument)
+    {
+        // the viewed document is not in the undo history, there is nothing to revert to
+        undoHistory.Clear();
+        ShowDocumentView(false);
+        documentView->SetDocument(nullptr, LineIndex());
+        document = std::make_shared<PieceTable>();
+        documentVersion = textVersion;
+        undoTextVersion = textVersion;
+        resultLabel->Clear();
+        ShowFindings(nullptr);
+        return;
+    }
+
+    // clearing the text is one step, so it can be reverted
+    uint64_t version = textVersion;
+    std::string current = SyncDocument().Text();
     textCtrl->Clear();
     resultLabel->Clear();
+    ShowFindings(nullptr);
+    RecordUndoStep(std::vector<TextEdit>{ TextEdit{ 0, std::move(current), std::string() } }, version);
+    undoTextVersion = textVersion;
 }
 
+// undoes the last recorded change (analysis, live fixes, new file)
 void MyFrame::OnRevert(wxCommandEvent& event)
 {
-    textCtrl->SetValue(previousText);
+    if (textVersion != undoTextVersion)
+        undoHistory.Clear(); // typed into since, the recorded offsets no longer apply
+    if (!undoHistory.CanUndo())
+    {
+        resultLabel->SetValue(wxT("Nothing to revert."));
+        return;
+    }
+    ApplyEditsToEditor(undoHistory.Undo());
+    undoTextVersion = textVersion;
+}
+
+// applies the last reverted change again
+void MyFrame::OnRedo(wxCommandEvent& event)
+{
+    if (textVersion != undoTextVersion)
+        undoHistory.Clear();
+    if (!undoHistory.CanRedo())
+    {
+        resultLabel->SetValue(wxT("Nothing to redo."));
+        return;
+    }
+    ApplyEditsToEditor(undoHistory.Redo());
+    undoTextVersion = textVersion;
+}
+
+void MyFrame::RecordUndoStep(std::vector<TextEdit> edits, uint64_t version)
+{
+    if (version != undoTextVersion)
+        undoHistory.Clear();
+    undoHistory.Record(std::move(edits));
+}
+
+void MyFrame::ApplyEditsToEditor(const std::vector<TextEdit>& edits)
+{
+    // a running analysis may still read the document, the edits then go to a copy
+    SyncDocument();
+    if (document.use_count() > 1)
+        document = std::make_shared<PieceTable>(*document);
+    PieceTable& current = *document;
+
+    if (viewingDocument)
+    {
+        // the view reads the changed document, only its rows are indexed again
+        current.ApplyEdits(edits);
+        LineIndex rows;
+        rows.Build(current);
+        documentView->SetDocument(&current, std::move(rows));
+        ++textVersion;
+        documentVersion = textVersion;
+        return;
+    }
+
+    applyingEdits = true;
+    if (edits.size() > MAX_EDITOR_REPLACEMENTS)
+    {
+        // one change of the whole text is cheaper than thousands of replacements
+        current.ApplyEdits(edits);
+        std::string text = current.Text();
+        textCtrl->ChangeValue(wxString::FromUTF8(text.data(), text.size()));
+        ++textVersion;
+    }
+    else
+    {
+        std::vector<size_t> offsets;
+        for (const TextEdit& edit : edits)
+        {
+            offsets.push_back(edit.offset);
+            offsets.push_back(edit.offset + edit.removed.size());
+        }
+        std::vector<long> positions = ToEditorPositions(current.Views(), offsets);
+        current.ApplyEdits(edits);
+
+        // last first so the earlier positions stay valid
+        textCtrl->Freeze();
+        for (size_t i = edits.size(); i-- > 0;)
+            textCtrl->Replace(positions[2 * i], positions[2 * i + 1], wxString::FromUTF8(edits[i].inserted.data(), edits[i].inserted.size()));
+        textCtrl->Thaw();
+    }
+    applyingEdits = false;
+    documentVersion = textVersion;
+}
+
+PieceTable& MyFrame::SyncDocument()
+{
+    if (documentVersion != textVersion)
+    {
+        document = std::make_shared<PieceTable>(ToUTF8String(textCtrl->GetValue()));
+        documentVersion = textVersion;
+    }
+    return *document;
 }
 
 void MyFrame::OnShowSettings(wxCommandEvent& event)
@@ -596,6 +1511,7 @@ void MyFrame::OnShowSettings(wxCommandEvent& event)
     dialog.spacingCheckBox->SetValue(fixSpacing);
     dialog.periodCheckBox->SetValue(capitalizeAfterPeriod);
     dialog.codingCheckBox->SetValue(codingTerms);
+    dialog.spellingCheckBox->SetValue(suggestSpelling);
 
     // sets the selected language in the dialog
     switch (currentLanguage)
@@ -621,9 +1537,30 @@ void MyFrame::OnShowSettings(wxCommandEvent& event)
         fixSpacing = dialog.spacingCheckBox->GetValue();
         capitalizeAfterPeriod = dialog.periodCheckBox->GetValue();
         codingTerms = dialog.codingCheckBox->GetValue();
+        suggestSpelling = dialog.spellingCheckBox->GetValue();
+        Language previousLanguage = currentLanguage;
         currentLanguage = dialog.GetSelectedLanguage();
 
+        // maps the rule pack of the language the first time it is selected, later analyses
+        // find it loaded
+        const RulePack& rules = RulePackFor(currentLanguage);
+
         UpdateUIBasedOnLanguage();
+
+        // live analysis starts over with the new settings (and rules)
+        if (liveAnalyzer)
+        {
+            AnalysisSettings settings{ capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms, suggestSpelling };
+            if (currentLanguage != previousLanguage)
+            {
+                liveAnalyzer = std::make_unique<IncrementalAnalyzer>(settings, rules);
+                liveAnalyzer->SetCache(Cache());
+            }
+            else
+                liveAnalyzer->Reset(settings);
+            liveSynced = false;
+            RunLiveAnalysis();
+        }
     }
 }
 
@@ -634,6 +1571,131 @@ void MyFrame::OnShowDocumentation(wxCommandEvent& event)
     docDialog.ShowModal();
 }
 
+void MyFrame::OnRecordMetrics(wxCommandEvent& event)
+{
+    recordMetrics = event.IsChecked();
+}
+
+void MyFrame::OnShowMetrics(wxCommandEvent& event)
+{
+    if (!lastMetrics)
+    {
+        wxMessageBox(wxT("No metrics yet, turn on Options > Record Metrics and analyze a text."), wxT("Analysis Metrics"));
+        return;
+    }
+    MetricsDialog dialog(this, *lastMetrics);
+    dialog.ShowModal();
+}
+
+// saves the metrics of the last analysis as JSON totals or as a Chrome trace of every stage run
+void MyFrame::OnExportMetrics(wxCommandEvent& event)
+{
+    if (!lastMetrics)
+    {
+        wxMessageBox(wxT("No metrics yet, turn on Options > Record Metrics and analyze a text."), wxT("Analysis Metrics"));
+        return;
+    }
+
+    wxFileDialog saveFileDialog(this, _("Export metrics"), "", "",
+                                "Metrics JSON (*.json)|*.json|Chrome trace (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (saveFileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    std::string content = saveFileDialog.GetFilterIndex() == 1 ? MetricsToChromeTrace(*lastMetrics) : MetricsToJson(*lastMetrics);
+    std::ofstream file(saveFileDialog.GetPath().ToStdString(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file << content;
+    if (!file)
+        wxLogError("Could not write the metrics file");
+}
+
+// analyzes a file of any size straight from disk into a new file, in bounded memory,
+// without loading it into the editor
+void MyFrame::OnAnalyzeLargeFile(wxCommandEvent& event)
+{
+    wxFileDialog openFileDialog(this, _("Open Text file"), "", "",
+                                "Text files (*.txt)|*.txt", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+    if (openFileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    wxFileDialog saveFileDialog(this, _("Save analyzed file"), "", "",
+                                "Text files (*.txt)|*.txt", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (saveFileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    if (saveFileDialog.GetPath() == openFileDialog.GetPath())
+    {
+        wxLogError("The analyzed file must be saved under a different name");
+        return;
+    }
+
+    if (analysisRunning)
+    {
+        wxLogError("Wait for the running analysis to finish or cancel it first");
+        return;
+    }
+
+    std::string inputPath = openFileDialog.GetPath().ToStdString();
+    std::string outputPath = saveFileDialog.GetPath().ToStdString();
+    AnalysisSettings settings{ capitalizeFirstLetter, fixSpacing, capitalizeAfterPeriod, codingTerms, suggestSpelling };
+    const RulePack* rules = &RulePackFor(currentLanguage);
+    ResultCache* cache = Cache();
+
+    auto job = std::make_shared<AnalysisJob>();
+    if (recordMetrics)
+        job->metrics = std::make_shared<AnalysisMetrics>();
+
+    StartAnalysisJob(job, [inputPath, outputPath, settings, rules, cache](AnalysisJob& job, const ProgressCallback& progress)
+    {
+        // the chosen file is only replaced once the whole result is on disk, cancelling or a
+        // failed write leaves it as it was
+        std::ifstream input(inputPath, std::ios::in | std::ios::binary | std::ios::ate);
+        AtomicFile output;
+        if (!input.is_open() || !output.Open(outputPath))
+        {
+            job.error = "Could not open files for analysis";
+            return;
+        }
+        std::streamoff size = input.tellg();
+        input.seekg(0, std::ios::beg);
+
+        // corrected pieces are written as soon as they are done
+        bool written = true;
+        StreamAnalyzer analyzer(settings, [&output, &written](const std::string& piece)
+        {
+            written = written && output.Write(piece.data(), piece.size());
+        }, *rules);
+        analyzer.SetMetrics(job.metrics.get());
+        analyzer.SetCache(cache);
+
+        std::vector<char> block(StreamAnalyzer::DEFAULT_CHUNK_SIZE);
+        while (input)
+        {
+            input.read(block.data(), static_cast<std::streamsize>(block.size()));
+            analyzer.Write(block.data(), static_cast<size_t>(input.gcount()));
+            if (!progress(static_cast<size_t>(analyzer.BytesIn()), static_cast<size_t>(size)))
+            {
+                output.Discard();
+                return;
+            }
+        }
+        analyzer.Finish();
+        job.bytes = analyzer.BytesIn();
+
+        if (input.bad() || !written)
+        {
+            output.Discard();
+            job.error = "Could not analyze the file";
+            return;
+        }
+        if (!output.Commit())
+        {
+            job.error = "Could not save the analyzed file";
+            return;
+        }
+
+        job.report = FinishAnalysis(analyzer.State());
+    });
+}
 
 // application class
 class MyApp : public wxApp
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// a whole file mapped read-only into memory, pages are read from disk when first touched
+// so opening a large file costs the same as opening a small one
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // maps the file at path, replacing what was mapped before
+    // returns false if it could not be opened or mapped (an empty file maps to no data)
+    bool Open(const std::string& path);
+
+    void Close();
+
+    // exchanges the mappings of the two objects
+    void Swap(MappedFile& other);
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+    bool IsOpen() const { return data != nullptr; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping = nullptr; // HANDLE of the file mapping object
+#endif
+};
@@ -0,0 +1,184 @@
+#include "parallel_analysis.h"
+#include "analysis_diagnostics.h"
+#include "analysis_metrics.h"
+#include "char_classes.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+
+const size_t MIN_PARALLEL_SEGMENT = 1 << 20;
+
+namespace
+{
+    // bytes before a cut classified to guess the block state there (with codingTerms)
+    const size_t BLOCK_GUESS_WINDOW = 4096;
+
+    // segments per worker, more than one so stealing evens out slow segments
+    const size_t SEGMENTS_PER_WORKER = 4;
+
+    struct Segment
+    {
+        size_t offset = 0;
+        size_t length = 0;
+        AnalysisState entry; // sentence state the segment is analyzed from
+        AnalysisState exit;  // state after the segment, with its own findings only
+        std::string text;    // corrected text
+        std::unique_ptr<AnalysisMetrics> metrics;
+        std::unique_ptr<AnalysisDiagnostics> diagnostics;
+    };
+
+    // the part of AnalysisState that crosses a cut
+    bool SameCarry(const AnalysisState& a, const AnalysisState& b)
+    {
+        return a.documentStart == b.documentStart && a.periodPending == b.periodPending && a.newSentence == b.newSentence
+            && a.blocks == b.blocks;
+    }
+
+    // a state carrying what crosses the cut from previous, without findings
+    AnalysisState EntryFrom(const AnalysisState& previous, uint64_t inputOffset)
+    {
+        AnalysisState entry;
+        entry.documentStart = previous.documentStart;
+        entry.periodPending = previous.periodPending;
+        entry.newSentence = previous.newSentence;
+        entry.blocks = previous.blocks;
+        entry.inputOffset = inputOffset;
+        return entry;
+    }
+
+    // the state a serial run most likely has after before, the input up to a cut
+    // no pass adds or removes the period ending a sentence, so the input tells whether one
+    // is pending (unless it ends an abbreviation); with codingTerms a code block ends the sentence
+    AnalysisState GuessEntry(std::string_view before, const AnalysisSettings& settings, const RulePack& rules, uint64_t inputOffset)
+    {
+        AnalysisState entry;
+        entry.documentStart = false;
+        entry.inputOffset = inputOffset;
+
+        size_t end = before.size();
+        while (end > 0 && IsSpacingWhitespace(before[end - 1])) --end;
+        size_t tokenStart = end;
+        while (tokenStart > 0 && !IsSpacingWhitespace(before[tokenStart - 1])) --tokenStart;
+        bool period = end > 0 && before[end - 1] == '.' && !rules.IsAbbreviation(before.substr(tokenStart, end - tokenStart));
+        if (StageEnabled(AnalysisStage::AFTER_PERIOD, settings))
+            entry.periodPending = period;
+        if (StageEnabled(AnalysisStage::SENTENCE_CASE, settings))
+            entry.newSentence = period;
+
+        if (settings.codingTerms)
+        {
+            // classifies the last whole lines, fences opened before them are not seen
+            size_t start = 0;
+            if (before.size() > BLOCK_GUESS_WINDOW)
+            {
+                start = before.find('\n', before.size() - BLOCK_GUESS_WINDOW);
+                start = start == std::string_view::npos ? before.size() - BLOCK_GUESS_WINDOW : start + 1;
+            }
+            std::vector<TextBlock> blocks = ClassifyBlocks(before.substr(start), entry.blocks);
+            if (!blocks.empty() && blocks.back().kind == BlockKind::CODE)
+            {
+                entry.periodPending = false;
+                entry.newSentence = true;
+            }
+        }
+        return entry;
+    }
+
+    // diagnostics are collected if diagnosticsCapacity is not null
+    void AnalyzeSegment(const std::string& input, Segment& segment, const AnalysisSettings& settings, const RulePack& rules,
+                        const size_t* diagnosticsCapacity)
+    {
+        segment.text.assign(input, segment.offset, segment.length);
+        segment.exit = segment.entry;
+        if (diagnosticsCapacity)
+            segment.diagnostics.reset(new AnalysisDiagnostics(*diagnosticsCapacity));
+        AnalyzePiece(segment.text, settings, rules, segment.exit, segment.metrics.get(), segment.diagnostics.get());
+    }
+}
+
+size_t AnalyzeParallel(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                       WorkStealingPool& pool, AnalysisMetrics* metrics, AnalysisDiagnostics* diagnostics)
+{
+    if (pool.Size() < 2 || text.size() < 2 * MIN_PARALLEL_SEGMENT)
+    {
+        AnalyzePiece(text, settings, rules, state, metrics, diagnostics);
+        return 0;
+    }
+
+    // cuts are searched from the front so each one is a cut a stream of this text could make
+    const size_t segmentSize = std::max(MIN_PARALLEL_SEGMENT, text.size() / (pool.Size() * SEGMENTS_PER_WORKER));
+    const std::string_view input(text);
+    std::vector<Segment> segments;
+    for (size_t offset = 0; offset < text.size();)
+    {
+        size_t rest = text.size() - offset;
+        size_t length = rest;
+        // with codingTerms a line cut in two may be classified unlike the whole line of a
+        // serial run, so the window grows until it holds a cut at a line start
+        for (size_t limit = segmentSize; limit + segmentSize / 2 <= rest; limit *= 2)
+        {
+            length = FindPieceCut(input.substr(offset), limit, settings);
+            if (!settings.codingTerms || input[offset + length - 1] == '\n')
+                break;
+            length = rest;
+        }
+        segments.emplace_back();
+        Segment& segment = segments.back();
+        segment.offset = offset;
+        segment.length = length;
+        segment.entry = offset == 0 ? EntryFrom(state, state.inputOffset)
+                                    : GuessEntry(input.substr(0, offset), settings, rules, state.inputOffset + offset);
+        if (metrics)
+        {
+            segment.metrics.reset(new AnalysisMetrics());
+            segment.metrics->origin = metrics->origin;
+            segment.metrics->recordEvents = metrics->recordEvents;
+        }
+        offset += length;
+    }
+
+    // every segment may keep as many records as still fit, the merge drops the rest
+    size_t room = diagnostics ? diagnostics->capacity - std::min(diagnostics->capacity, diagnostics->records.size()) : 0;
+    const size_t* diagnosticsCapacity = diagnostics ? &room : nullptr;
+    for (Segment& segment : segments)
+        pool.Submit([&] { AnalyzeSegment(text, segment, settings, rules, diagnosticsCapacity); });
+    pool.Wait();
+
+    // resolves the cuts in document order, a wrong guess is fixed before the next cut is checked
+    size_t repeated = 0;
+    for (size_t i = 1; i < segments.size(); ++i)
+    {
+        if (SameCarry(segments[i - 1].exit, segments[i].entry))
+            continue;
+        segments[i].entry = EntryFrom(segments[i - 1].exit, segments[i].entry.inputOffset);
+        AnalyzeSegment(text, segments[i], settings, rules, diagnosticsCapacity);
+        ++repeated;
+    }
+
+    std::string result;
+    size_t resultSize = 0;
+    for (const Segment& segment : segments)
+        resultSize += segment.text.size();
+    result.reserve(resultSize);
+    for (Segment& segment : segments)
+    {
+        result += segment.text;
+        std::string().swap(segment.text);
+        MergeFindings(state, segment.exit);
+        if (metrics)
+            metrics->Merge(*segment.metrics);
+        if (diagnostics)
+            diagnostics->Merge(*segment.diagnostics);
+    }
+
+    const AnalysisState& last = segments.back().exit;
+    state.documentStart = last.documentStart;
+    state.periodPending = last.periodPending;
+    state.newSentence = last.newSentence;
+    state.blocks = last.blocks;
+    state.inputOffset += text.size();
+    text.swap(result);
+    return repeated;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "analyzer.h"
+
+class WorkStealingPool;
+
+// segments are at least this big, shorter texts are analyzed serially by AnalyzeParallel
+extern const size_t MIN_PARALLEL_SEGMENT;
+
+// analyzes one large text on all workers of a pool with the same result as a single
+// AnalyzePiece call over all of it
+// the text is cut into segments where FindPieceCut would cut a stream and each segment is
+// analyzed as a task, starting from the sentence state guessed from the bytes before it
+// (a period before the cut, the kind of the last lines with codingTerms); the segments are
+// then checked in order and a segment whose guess differs from the state the previous one
+// really ended with is analyzed again, so the output never depends on the guesses
+// findings are merged in document order, diagnostics get input offsets like a serial run
+// and metrics include the repeated runs
+// must not be called from a task of pool, which must not run other tasks meanwhile
+// returns the number of segments that had to be analyzed again
+size_t AnalyzeParallel(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                       WorkStealingPool& pool, AnalysisMetrics* metrics = nullptr, AnalysisDiagnostics* diagnostics = nullptr);
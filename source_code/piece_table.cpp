@@ -0,0 +1,152 @@
+#include "piece_table.h"
+
+#include <algorithm>
+#include <utility>
+
+PieceTable::PieceTable(std::string text)
+{
+    Reset(std::move(text));
+}
+
+void PieceTable::Reset(std::string text)
+{
+    original = std::move(text);
+    added.clear();
+    pieces.clear();
+    size = original.size();
+    if (size > 0)
+        pieces.push_back(Piece{ false, 0, size });
+    IndexPieces();
+}
+
+std::vector<std::string_view> PieceTable::Views() const
+{
+    std::vector<std::string_view> views;
+    views.reserve(pieces.size());
+    for (const Piece& piece : pieces)
+        views.emplace_back(Data(piece), piece.length);
+    return views;
+}
+
+void PieceTable::Read(size_t offset, size_t length, std::string& out) const
+{
+    if (offset >= size)
+        return;
+    // the piece holding offset is the last one starting at or before it
+    size_t index = std::upper_bound(pieceStarts.begin(), pieceStarts.end(), offset) - pieceStarts.begin();
+    for (--index; index < pieces.size() && length > 0; ++index)
+    {
+        const Piece& piece = pieces[index];
+        size_t from = offset - pieceStarts[index];
+        size_t take = std::min(piece.length - from, length);
+        out.append(Data(piece) + from, take);
+        offset += take;
+        length -= take;
+    }
+}
+
+std::string PieceTable::Text() const
+{
+    std::string text;
+    text.reserve(size);
+    for (const Piece& piece : pieces)
+        text.append(Data(piece), piece.length);
+    return text;
+}
+
+void PieceTable::Replace(size_t offset, size_t length, std::string_view inserted)
+{
+    ApplySpans(std::vector<Span>{ Span{ offset, length, inserted } });
+}
+
+void PieceTable::ApplyEdits(const std::vector<TextEdit>& edits)
+{
+    std::vector<Span> spans;
+    spans.reserve(edits.size());
+    for (const TextEdit& edit : edits)
+        spans.push_back(Span{ edit.offset, edit.removed.size(), edit.inserted });
+    ApplySpans(spans);
+}
+
+void PieceTable::ApplySpans(const std::vector<Span>& spans)
+{
+    if (spans.empty())
+        return;
+
+    std::vector<Piece> result;
+    result.reserve(pieces.size() + spans.size() * 2);
+
+    size_t index = 0;    // current piece
+    size_t inPiece = 0;  // bytes of the current piece already taken or skipped
+    size_t position = 0; // document offset of the next byte of the current piece
+
+    // takes the pieces up to offset, splitting the last one
+    auto keepUntil = [&](size_t offset)
+    {
+        while (position < offset && index < pieces.size())
+        {
+            const Piece& piece = pieces[index];
+            size_t take = std::min(piece.length - inPiece, offset - position);
+            result.push_back(Piece{ piece.added, piece.start + inPiece, take });
+            inPiece += take;
+            position += take;
+            if (inPiece == piece.length)
+            {
+                ++index;
+                inPiece = 0;
+            }
+        }
+    };
+
+    // skips length bytes, splitting the piece the skip ends in
+    auto skip = [&](size_t length)
+    {
+        while (length > 0 && index < pieces.size())
+        {
+            size_t take = std::min(pieces[index].length - inPiece, length);
+            inPiece += take;
+            position += take;
+            length -= take;
+            if (inPiece == pieces[index].length)
+            {
+                ++index;
+                inPiece = 0;
+            }
+        }
+    };
+
+    for (const Span& span : spans)
+    {
+        keepUntil(span.offset);
+        skip(span.length);
+        AppendInserted(result, span.inserted);
+        size = size - span.length + span.inserted.size();
+    }
+    keepUntil(static_cast<size_t>(-1));
+
+    pieces.swap(result);
+    IndexPieces();
+}
+
+void PieceTable::AppendInserted(std::vector<Piece>& result, std::string_view inserted)
+{
+    if (inserted.empty())
+        return;
+
+    if (!result.empty() && result.back().added && result.back().start + result.back().length == added.size())
+        result.back().length += inserted.size();
+    else
+        result.push_back(Piece{ true, added.size(), inserted.size() });
+    added.append(inserted.data(), inserted.size());
+}
+
+void PieceTable::IndexPieces()
+{
+    pieceStarts.resize(pieces.size());
+    size_t position = 0;
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        pieceStarts[i] = position;
+        position += pieces[i].length;
+    }
+}
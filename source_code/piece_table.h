@@ -0,0 +1,71 @@
+#pragma once
+
+#include "text_edit.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// UTF-8 document held once, as a piece table: the text it was loaded with stays untouched
+// and every inserted text is appended to a second buffer, the document is the list of
+// pieces of both buffers in order, so an edit only splits pieces instead of moving text
+class PieceTable
+{
+public:
+    PieceTable() = default;
+    explicit PieceTable(std::string text);
+
+    // replaces the whole document, both buffers start over
+    void Reset(std::string text);
+
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    size_t PieceCount() const { return pieces.size(); }
+
+    // the document in order as views into the buffers, valid until the next change
+    std::vector<std::string_view> Views() const;
+
+    // appends length bytes starting at offset to out, finds the first piece by binary search
+    void Read(size_t offset, size_t length, std::string& out) const;
+
+    // copy of the whole document
+    std::string Text() const;
+
+    // replaces length bytes at offset with inserted, which must not be a view of this document
+    void Replace(size_t offset, size_t length, std::string_view inserted);
+
+    // applies ascending, non-overlapping edits with offsets in the current document in one
+    // pass over the pieces, removed is only used for its length
+    void ApplyEdits(const std::vector<TextEdit>& edits);
+
+private:
+    struct Piece
+    {
+        bool added; // in the added buffer, otherwise in the original one
+        size_t start;
+        size_t length;
+    };
+
+    struct Span
+    {
+        size_t offset;
+        size_t length;
+        std::string_view inserted;
+    };
+
+    void ApplySpans(const std::vector<Span>& spans);
+
+    const char* Data(const Piece& piece) const { return (piece.added ? added : original).data() + piece.start; }
+
+    // appends a piece of inserted text, growing the previous piece when it ends where the text was put
+    void AppendInserted(std::vector<Piece>& result, std::string_view inserted);
+
+    // fills pieceStarts after the pieces changed
+    void IndexPieces();
+
+    std::string original;
+    std::string added;
+    std::vector<Piece> pieces;
+    std::vector<size_t> pieceStarts; // document offset of each piece
+    size_t size = 0;
+};
@@ -0,0 +1,724 @@
+#include "result_cache.h"
+
+#include "analysis_arena.h"
+#include "analysis_diagnostics.h"
+#include "char_classes.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // file layout: a header, the index slots, then the ring of entries; numbers are stored
+    // in the byte order of the machine that wrote the file, which BYTE_ORDER_MARK tells apart
+    const char CACHE_MAGIC[4] = { 'T', 'R', 'R', 'C' };
+    const uint32_t CACHE_VERSION = 1;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    const size_t RECORD_ALIGNMENT = 8;
+    const size_t DATA_ALIGNMENT = 64;
+
+    // the index has a slot for every this many bytes of the file and is kept at most 3/4 full
+    const uint64_t BYTES_PER_SLOT = 256;
+    const uint64_t MIN_SLOTS = 1024;
+
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t open; // set while a process has the file open
+        uint64_t fileSize;
+        uint64_t slotCount; // a power of two
+        uint64_t dataSize;  // bytes of the ring
+        uint64_t head;      // ring position the next entry is written at, counted from the start
+        uint64_t tail;      // ring position of the oldest entry, head - tail <= dataSize
+        uint64_t entries;   // slots in use
+    };
+
+    // an index slot, both halves of the hash are 0 in an empty one
+    struct Slot
+    {
+        uint64_t low;
+        uint64_t high;
+        uint64_t position; // of the entry in the ring
+    };
+
+    // the start of every entry, followed by the corrected text, the typo entries used
+    // (int32_t each), the fixes and their replacement bytes, padded to RECORD_ALIGNMENT
+    // the hash is 0 in the padding skipped at the end of the ring
+    struct RecordHeader
+    {
+        uint64_t low;
+        uint64_t high;
+        uint32_t size; // of the whole entry
+        uint32_t inputLength;
+        uint32_t textLength;
+        uint32_t typoCount;
+        uint32_t diagnosticCount;
+        uint32_t replacementBytes;
+        uint32_t afterPeriodFixes;
+        uint32_t spellingFixes;
+        uint32_t flags; // RECORD_* bits
+        uint32_t reserved;
+    };
+
+    // a fix with its offset in the paragraph
+    struct StoredDiagnostic
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t replacementLength;
+        uint32_t stage;
+    };
+
+    static_assert(sizeof(CacheHeader) == 64 && sizeof(Slot) == 24 && sizeof(RecordHeader) == 56 && sizeof(StoredDiagnostic) == 16,
+                  "cache files must have a fixed layout");
+    static_assert(sizeof(RecordHeader) % RECORD_ALIGNMENT == 0, "entries must stay aligned");
+
+    const uint32_t RECORD_DOCUMENT_START = 1 << 0;
+    const uint32_t RECORD_PERIOD_PENDING = 1 << 1;
+    const uint32_t RECORD_NEW_SENTENCE = 1 << 2;
+    const uint32_t RECORD_IN_FENCE = 1 << 3;
+    const uint32_t RECORD_PREVIOUS_CODE = 1 << 4;
+    const uint32_t RECORD_LINE_OPEN = 1 << 5;
+    const uint32_t RECORD_FIRST_LETTER_FIXED = 1 << 6;
+    const uint32_t RECORD_SPACING_FIXED = 1 << 7;
+    const uint32_t RECORD_HAS_DIAGNOSTICS = 1 << 8;
+
+    // the parts of the mapped file
+    struct Layout
+    {
+        CacheHeader* header;
+        Slot* slots;
+        char* data;
+    };
+
+    Layout LayoutOf(char* base)
+    {
+        Layout layout;
+        layout.header = reinterpret_cast<CacheHeader*>(base);
+        layout.slots = reinterpret_cast<Slot*>(base + sizeof(CacheHeader));
+        uint64_t dataStart = sizeof(CacheHeader) + layout.header->slotCount * sizeof(Slot);
+        layout.data = base + (dataStart + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+        return layout;
+    }
+
+    // the index and ring sizes of a file of fileSize bytes
+    void PlanLayout(uint64_t fileSize, uint64_t& slotCount, uint64_t& dataSize)
+    {
+        slotCount = MIN_SLOTS;
+        while (slotCount * 2 <= fileSize / BYTES_PER_SLOT)
+            slotCount *= 2;
+        uint64_t dataStart = (sizeof(CacheHeader) + slotCount * sizeof(Slot) + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+        dataSize = (fileSize - dataStart) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    }
+
+    size_t RoundUp(size_t size)
+    {
+        return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    }
+
+    // the slot holding hash, or the empty slot ending its probe sequence
+    size_t FindSlot(const Layout& layout, const Hash128& hash)
+    {
+        const uint64_t mask = layout.header->slotCount - 1;
+        size_t i = static_cast<size_t>(hash.low & mask);
+        while (true)
+        {
+            const Slot& slot = layout.slots[i];
+            if ((slot.low == hash.low && slot.high == hash.high) || (slot.low == 0 && slot.high == 0))
+                return i;
+            i = (i + 1) & mask;
+        }
+    }
+
+    bool IsEmpty(const Slot& slot)
+    {
+        return slot.low == 0 && slot.high == 0;
+    }
+
+    // empties slot i, moving later slots of the same probe sequences back so no lookup
+    // stops early at the hole
+    void RemoveSlot(const Layout& layout, size_t i)
+    {
+        const uint64_t mask = layout.header->slotCount - 1;
+        size_t j = i;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (IsEmpty(layout.slots[j]))
+                break;
+            size_t home = static_cast<size_t>(layout.slots[j].low & mask);
+            // the slot at j may move to i unless its home lies cyclically in (i, j]
+            bool homeBetween = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+            if (homeBetween)
+                continue;
+            layout.slots[i] = layout.slots[j];
+            i = j;
+        }
+        layout.slots[i] = Slot{ 0, 0, 0 };
+        --layout.header->entries;
+    }
+
+    template <typename T>
+    void Put(std::string& out, const T& value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // end of the paragraph starting at start: the first place after a '\n' where a stream
+    // could be cut before the next word (see FindPieceCut), else the end of text
+    size_t ParagraphEnd(std::string_view text, size_t start, const AnalysisSettings& settings)
+    {
+        for (size_t newline = text.find('\n', start); newline != std::string_view::npos; newline = text.find('\n', newline + 1))
+        {
+            size_t k = newline + 1;
+            if (settings.codingTerms)
+            {
+                // a single '\n' ending a line whose kind does not depend on the next line
+                if (k >= text.size())
+                    break;
+                if (newline == 0 || IsSpacingWhitespace(text[newline - 1]) || IsSpacingWhitespace(text[k])
+                    || std::strchr(SPACING_PUNCTUATION, text[k]) != nullptr)
+                    continue;
+                size_t lineStart = text.rfind('\n', newline - 1);
+                lineStart = lineStart == std::string_view::npos ? 0 : lineStart + 1;
+                if (!LineNeedsNextLine(text.substr(lineStart, k - lineStart)))
+                    return k;
+                continue;
+            }
+
+            while (k < text.size() && IsSpacingWhitespace(text[k]))
+                ++k;
+            if (k >= text.size())
+                break;
+            if (std::strchr(SPACING_PUNCTUATION, text[k]) == nullptr)
+                return k;
+            newline = k - 1;
+        }
+        return text.size();
+    }
+
+    void CopySentenceState(const AnalysisState& from, AnalysisState& to)
+    {
+        to.documentStart = from.documentStart;
+        to.periodPending = from.periodPending;
+        to.newSentence = from.newSentence;
+        to.blocks = from.blocks;
+    }
+
+    // emptied per-thread collector for the fixes of one paragraph
+    AnalysisDiagnostics& OverflowDiagnostics()
+    {
+        thread_local AnalysisDiagnostics overflow(4096);
+        overflow.records.clear();
+        overflow.replacements.clear();
+        std::fill(std::begin(overflow.counts), std::end(overflow.counts), 0);
+        overflow.dropped = 0;
+        return overflow;
+    }
+
+    // analyzes one paragraph of a piece through the cache, continuing state
+    void AnalyzeParagraph(std::string& paragraph, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                          ResultCache& cache, AnalysisDiagnostics* diagnostics)
+    {
+        const ResultCache::Key key = ResultCache::KeyFor(paragraph, settings, rules, state);
+        AnalysisState result;
+        CopySentenceState(state, result);
+        result.inputOffset = state.inputOffset;
+        if (!cache.Find(key, paragraph, result, diagnostics, state.inputOffset))
+        {
+            // once diagnostics is full the fixes are collected aside and only counted in it,
+            // so the entry still gets them for later runs
+            AnalysisDiagnostics* collected = diagnostics;
+            if (diagnostics && diagnostics->records.size() >= diagnostics->capacity)
+                collected = &OverflowDiagnostics();
+
+            // the fixes are only stored if all of them were recorded
+            size_t firstRecord = collected ? collected->records.size() : 0;
+            uint64_t dropped = collected ? collected->dropped : 0;
+            AnalyzePiece(paragraph, settings, rules, result, nullptr, collected);
+            bool complete = collected && collected->dropped == dropped;
+            cache.Store(key, paragraph, result, complete ? collected : nullptr, firstRecord, state.inputOffset);
+            if (collected != diagnostics)
+                diagnostics->Merge(*collected);
+        }
+        MergeFindings(state, result);
+        CopySentenceState(result, state);
+        state.inputOffset += key.length;
+    }
+}
+
+ResultCache::~ResultCache()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool ResultCache::Open(const std::string& path, uint64_t capacity, std::string& error)
+{
+    Close();
+    capacity = capacity < MIN_CAPACITY ? MIN_CAPACITY : capacity / 4096 * 4096;
+    std::error_code ignored;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory, ignored);
+
+    // no sharing, a second process fails to open the file instead of corrupting it
+    HANDLE newFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (newFile == INVALID_HANDLE_VALUE)
+    {
+        error = GetLastError() == ERROR_SHARING_VIOLATION ? path + " is in use by another process" : "could not open " + path;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = static_cast<LONGLONG>(capacity);
+    HANDLE newMapping = nullptr;
+    void* view = nullptr;
+    if (SetFilePointerEx(newFile, fileSize, nullptr, FILE_BEGIN) && SetEndOfFile(newFile))
+        newMapping = CreateFileMappingA(newFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(capacity >> 32),
+                                        static_cast<DWORD>(capacity & 0xFFFFFFFF), nullptr);
+    if (newMapping)
+        view = MapViewOfFile(newMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view)
+    {
+        if (newMapping)
+            CloseHandle(newMapping);
+        CloseHandle(newFile);
+        error = "could not map " + path;
+        return false;
+    }
+    file = newFile;
+    mapping = newMapping;
+    base = static_cast<char*>(view);
+    size = capacity;
+    return OpenMapped();
+}
+
+void ResultCache::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (base)
+    {
+        reinterpret_cast<CacheHeader*>(base)->open = 0;
+        UnmapViewOfFile(base);
+    }
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    base = nullptr;
+    size = 0;
+    mapping = nullptr;
+    file = nullptr;
+}
+
+#else
+
+bool ResultCache::Open(const std::string& path, uint64_t capacity, std::string& error)
+{
+    Close();
+    capacity = capacity < MIN_CAPACITY ? MIN_CAPACITY : capacity / 4096 * 4096;
+    std::error_code ignored;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory, ignored);
+
+    int newFd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (newFd < 0)
+    {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    // a second process fails to lock the file instead of corrupting it
+    if (flock(newFd, LOCK_EX | LOCK_NB) != 0)
+    {
+        close(newFd);
+        error = path + " is in use by another process";
+        return false;
+    }
+
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(newFd, &info) == 0 && (static_cast<uint64_t>(info.st_size) == capacity || ftruncate(newFd, static_cast<off_t>(capacity)) == 0))
+        view = mmap(nullptr, static_cast<size_t>(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, newFd, 0);
+    if (view == MAP_FAILED)
+    {
+        error = path + ": " + std::strerror(errno);
+        close(newFd);
+        return false;
+    }
+    fd = newFd;
+    base = static_cast<char*>(view);
+    size = capacity;
+    return OpenMapped();
+}
+
+void ResultCache::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (base)
+    {
+        reinterpret_cast<CacheHeader*>(base)->open = 0;
+        munmap(base, static_cast<size_t>(size));
+    }
+    if (fd >= 0)
+        close(fd); // releases the lock
+    base = nullptr;
+    size = 0;
+    fd = -1;
+}
+
+#endif
+
+bool ResultCache::OpenMapped()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    statistics = Statistics();
+    statistics.capacity = size;
+
+    // anything that does not look like a file this process could have closed starts over
+    CacheHeader& header = *reinterpret_cast<CacheHeader*>(base);
+    uint64_t slotCount;
+    uint64_t dataSize;
+    PlanLayout(size, slotCount, dataSize);
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+        || header.byteOrder != BYTE_ORDER_MARK || header.open != 0 || header.fileSize != size || header.slotCount != slotCount
+        || header.dataSize != dataSize || header.tail > header.head || header.head - header.tail > dataSize
+        || header.entries > slotCount)
+    {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.fileSize = size;
+        header.slotCount = slotCount;
+        header.dataSize = dataSize;
+        Reset();
+    }
+    header.open = 1;
+    statistics.entries = header.entries;
+    return true;
+}
+
+void ResultCache::Reset()
+{
+    Layout layout = LayoutOf(base);
+    std::memset(layout.slots, 0, static_cast<size_t>(layout.header->slotCount * sizeof(Slot)));
+    layout.header->head = 0;
+    layout.header->tail = 0;
+    layout.header->entries = 0;
+}
+
+ResultCache::Key ResultCache::KeyFor(std::string_view text, const AnalysisSettings& settings, const RulePack& rules, const AnalysisState& state)
+{
+    uint64_t options = (settings.capitalizeFirstLetter ? 1 : 0) | (settings.fixSpacing ? 2 : 0) | (settings.capitalizeAfterPeriod ? 4 : 0)
+        | (settings.codingTerms ? 8 : 0) | (settings.suggestSpelling ? 16 : 0) | (state.documentStart ? 32 : 0)
+        | (state.periodPending ? 64 : 0) | (state.newSentence ? 128 : 0) | (state.blocks.inFence ? 256 : 0)
+        | (state.blocks.previousCode ? 512 : 0) | (state.blocks.lineOpen ? 1024 : 0);
+    uint64_t seed = HashCombine(HashCombine(CACHE_VERSION, rules.Fingerprint()), (options << 8) | static_cast<uint64_t>(rules.GetLanguage()));
+
+    Key key;
+    key.hash = HashBytes(text.data(), text.size(), seed);
+    key.hash.high |= 1; // never the empty slot
+    key.length = static_cast<uint32_t>(text.size());
+    return key;
+}
+
+bool ResultCache::Find(const Key& key, std::string& text, AnalysisState& paragraph, AnalysisDiagnostics* diagnostics, uint64_t offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!base)
+        return false;
+    Layout layout = LayoutOf(base);
+    const CacheHeader& header = *layout.header;
+
+    size_t index = FindSlot(layout, key.hash);
+    const Slot& slot = layout.slots[index];
+    if (IsEmpty(slot))
+    {
+        ++statistics.misses;
+        return false;
+    }
+
+    // an entry that does not check out is dropped
+    const uint64_t position = slot.position;
+    const uint64_t start = position % header.dataSize;
+    RecordHeader record;
+    bool valid = position >= header.tail && position < header.head && header.dataSize - start >= sizeof(RecordHeader);
+    if (valid)
+    {
+        std::memcpy(&record, layout.data + start, sizeof(record));
+        uint64_t contents = sizeof(RecordHeader) + uint64_t(record.textLength) + uint64_t(record.typoCount) * sizeof(int32_t)
+            + uint64_t(record.diagnosticCount) * sizeof(StoredDiagnostic) + record.replacementBytes;
+        valid = record.low == key.hash.low && record.high == key.hash.high && record.inputLength == key.length
+            && record.size <= header.dataSize - start && record.size <= header.head - position && contents <= record.size;
+    }
+    if (!valid)
+    {
+        RemoveSlot(layout, index);
+        ++statistics.misses;
+        return false;
+    }
+    if (diagnostics && (record.flags & RECORD_HAS_DIAGNOSTICS) == 0)
+    {
+        ++statistics.misses;
+        return false;
+    }
+
+    const char* data = layout.data + start + sizeof(RecordHeader);
+    text.assign(data, record.textLength);
+    data += record.textLength;
+
+    paragraph.documentStart = (record.flags & RECORD_DOCUMENT_START) != 0;
+    paragraph.periodPending = (record.flags & RECORD_PERIOD_PENDING) != 0;
+    paragraph.newSentence = (record.flags & RECORD_NEW_SENTENCE) != 0;
+    paragraph.blocks.inFence = (record.flags & RECORD_IN_FENCE) != 0;
+    paragraph.blocks.previousCode = (record.flags & RECORD_PREVIOUS_CODE) != 0;
+    paragraph.blocks.lineOpen = (record.flags & RECORD_LINE_OPEN) != 0;
+    paragraph.firstLetterFixed = (record.flags & RECORD_FIRST_LETTER_FIXED) != 0;
+    paragraph.spacingFixed = (record.flags & RECORD_SPACING_FIXED) != 0;
+    paragraph.afterPeriodFixes = record.afterPeriodFixes;
+    paragraph.spellingFixes = record.spellingFixes;
+    paragraph.typoEntriesUsed.resize(record.typoCount);
+    if (record.typoCount > 0)
+        std::memcpy(paragraph.typoEntriesUsed.data(), data, record.typoCount * sizeof(int32_t));
+    data += record.typoCount * sizeof(int32_t);
+
+    if (diagnostics)
+    {
+        const char* replacement = data + record.diagnosticCount * sizeof(StoredDiagnostic);
+        for (uint32_t d = 0; d < record.diagnosticCount; ++d)
+        {
+            StoredDiagnostic stored;
+            std::memcpy(&stored, data + d * sizeof(StoredDiagnostic), sizeof(stored));
+            diagnostics->Add(static_cast<AnalysisStage>(stored.stage), offset + stored.offset, stored.length,
+                             std::string_view(replacement, stored.replacementLength));
+            replacement += stored.replacementLength;
+        }
+    }
+    ++statistics.hits;
+
+    // an entry used again before it is dropped moves to the front
+    if (header.head - position > header.dataSize / 2)
+    {
+        promoted.assign(layout.data + start, record.size);
+        Append(promoted.data(), promoted.size(), key.hash);
+    }
+    return true;
+}
+
+void ResultCache::Store(const Key& key, std::string_view text, const AnalysisState& paragraph, const AnalysisDiagnostics* diagnostics,
+                        size_t firstRecord, uint64_t offset)
+{
+    if (!base)
+        return;
+
+    RecordHeader record = {};
+    record.low = key.hash.low;
+    record.high = key.hash.high;
+    record.inputLength = key.length;
+    record.textLength = static_cast<uint32_t>(text.size());
+    record.typoCount = static_cast<uint32_t>(paragraph.typoEntriesUsed.size());
+    record.afterPeriodFixes = static_cast<uint32_t>(paragraph.afterPeriodFixes);
+    record.spellingFixes = static_cast<uint32_t>(paragraph.spellingFixes);
+    record.flags = (paragraph.documentStart ? RECORD_DOCUMENT_START : 0) | (paragraph.periodPending ? RECORD_PERIOD_PENDING : 0)
+        | (paragraph.newSentence ? RECORD_NEW_SENTENCE : 0) | (paragraph.blocks.inFence ? RECORD_IN_FENCE : 0)
+        | (paragraph.blocks.previousCode ? RECORD_PREVIOUS_CODE : 0) | (paragraph.blocks.lineOpen ? RECORD_LINE_OPEN : 0)
+        | (paragraph.firstLetterFixed ? RECORD_FIRST_LETTER_FIXED : 0) | (paragraph.spacingFixed ? RECORD_SPACING_FIXED : 0)
+        | (diagnostics ? RECORD_HAS_DIAGNOSTICS : 0);
+    if (diagnostics)
+    {
+        record.diagnosticCount = static_cast<uint32_t>(diagnostics->records.size() - firstRecord);
+        for (size_t d = firstRecord; d < diagnostics->records.size(); ++d)
+            record.replacementBytes += diagnostics->records[d].replacementLength;
+    }
+    uint64_t contents = sizeof(RecordHeader) + uint64_t(record.textLength) + uint64_t(record.typoCount) * sizeof(int32_t)
+        + uint64_t(record.diagnosticCount) * sizeof(StoredDiagnostic) + record.replacementBytes;
+    if (contents > size / 4)
+        return;
+    record.size = static_cast<uint32_t>(RoundUp(static_cast<size_t>(contents)));
+
+    // built outside the lock, other threads keep using the cache meanwhile
+    ScratchString scratch;
+    std::string& bytes = scratch.Get();
+    bytes.reserve(record.size);
+    Put(bytes, record);
+    bytes.append(text.data(), text.size());
+    for (int entry : paragraph.typoEntriesUsed)
+        Put(bytes, static_cast<int32_t>(entry));
+    if (diagnostics)
+    {
+        for (size_t d = firstRecord; d < diagnostics->records.size(); ++d)
+        {
+            const Diagnostic& diagnostic = diagnostics->records[d];
+            StoredDiagnostic stored = { static_cast<uint32_t>(diagnostic.offset - offset), diagnostic.length,
+                                        diagnostic.replacementLength, static_cast<uint32_t>(diagnostic.stage) };
+            Put(bytes, stored);
+        }
+        for (size_t d = firstRecord; d < diagnostics->records.size(); ++d)
+            bytes += diagnostics->Replacement(diagnostics->records[d]);
+    }
+    bytes.resize(record.size, '\0');
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!base || record.size > LayoutOf(base).header->dataSize / 4)
+        return;
+    Append(bytes.data(), bytes.size(), key.hash);
+    ++statistics.stores;
+}
+
+void ResultCache::Append(const char* record, size_t recordSize, const Hash128& hash)
+{
+    Layout layout = LayoutOf(base);
+    CacheHeader& header = *layout.header;
+
+    // an entry never wraps around the end of the ring, the rest of the ring is skipped
+    uint64_t position = header.head;
+    uint64_t room = header.dataSize - position % header.dataSize;
+    if (recordSize > room)
+        position += room;
+
+    // the oldest entries are dropped until the new one fits and the index has room
+    while (header.head > header.tail && (position + recordSize - header.tail > header.dataSize || header.entries >= header.slotCount / 4 * 3))
+    {
+        if (!DropOldest())
+            break;
+    }
+    if (header.head == header.tail)
+    {
+        // empty (also after a reset), the skip is no longer needed
+        position = header.head;
+        room = header.dataSize - position % header.dataSize;
+        if (recordSize > room)
+            position += room;
+        header.tail = position;
+    }
+
+    if (position != header.head && room >= sizeof(RecordHeader))
+    {
+        RecordHeader padding = {};
+        padding.size = static_cast<uint32_t>(room);
+        std::memcpy(layout.data + header.head % header.dataSize, &padding, sizeof(padding));
+    }
+    std::memcpy(layout.data + position % header.dataSize, record, recordSize);
+
+    size_t index = FindSlot(layout, hash);
+    Slot& slot = layout.slots[index];
+    if (IsEmpty(slot))
+    {
+        slot.low = hash.low;
+        slot.high = hash.high;
+        ++header.entries;
+    }
+    slot.position = position; // an older copy is left for DropOldest to skip
+    header.head = position + recordSize;
+    statistics.entries = header.entries;
+}
+
+bool ResultCache::DropOldest()
+{
+    Layout layout = LayoutOf(base);
+    CacheHeader& header = *layout.header;
+    if (header.tail >= header.head)
+        return false;
+
+    uint64_t start = header.tail % header.dataSize;
+    uint64_t room = header.dataSize - start;
+    if (room < sizeof(RecordHeader))
+    {
+        header.tail += room;
+        return true;
+    }
+
+    RecordHeader record;
+    std::memcpy(&record, layout.data + start, sizeof(record));
+    if (record.size < sizeof(RecordHeader) || record.size > room || record.size % RECORD_ALIGNMENT != 0
+        || record.size > header.head - header.tail)
+    {
+        Reset();
+        statistics.entries = 0;
+        return false;
+    }
+    if (record.low != 0 || record.high != 0)
+    {
+        Hash128 hash;
+        hash.low = record.low;
+        hash.high = record.high;
+        size_t index = FindSlot(layout, hash);
+        if (!IsEmpty(layout.slots[index]) && layout.slots[index].position == header.tail)
+        {
+            RemoveSlot(layout, index);
+            ++statistics.evictions;
+        }
+    }
+    header.tail += record.size;
+    statistics.entries = header.entries;
+    return true;
+}
+
+ResultCache::Statistics ResultCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+std::string DefaultResultCachePath()
+{
+#ifdef _WIN32
+    const char* localAppData = std::getenv("LOCALAPPDATA");
+    std::string directory = localAppData && *localAppData ? std::string(localAppData) : std::string(".");
+    return directory + "\\trace\\results.cache";
+#else
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome)
+        return std::string(cacheHome) + "/trace/results.cache";
+    const char* home = std::getenv("HOME");
+    return std::string(home && *home ? home : "/tmp") + "/.cache/trace/results.cache";
+#endif
+}
+
+void AnalyzePieceCached(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                        ResultCache& cache, AnalysisDiagnostics* diagnostics)
+{
+    if (text.empty())
+        return;
+    if (!cache.IsOpen())
+    {
+        AnalyzePiece(text, settings, rules, state, nullptr, diagnostics);
+        return;
+    }
+
+    ScratchString resultScratch;
+    ScratchString paragraphScratch;
+    std::string& result = resultScratch.Get();
+    std::string& paragraph = paragraphScratch.Get();
+    result.reserve(text.size() + text.size() / 16);
+    for (size_t start = 0; start < text.size();)
+    {
+        size_t end = ParagraphEnd(text, start, settings);
+        paragraph.assign(text, start, end - start);
+        AnalyzeParagraph(paragraph, settings, rules, state, cache, diagnostics);
+        result += paragraph;
+        start = end;
+    }
+    text.swap(result);
+}
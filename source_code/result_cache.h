@@ -0,0 +1,118 @@
+#pragma once
+
+#include "analyzer.h"
+#include "content_hash.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct AnalysisDiagnostics;
+
+// results of analyzing paragraphs kept in a file from one run to the next, so text analyzed
+// before (the same boilerplate in many files, the unchanged paragraphs of a document saved
+// again) is copied instead of analyzed
+// an entry is what AnalyzePiece made of one paragraph, found by a hash of its bytes, the
+// settings, the rules (RulePack::Fingerprint) and the sentence state it started from; it
+// holds the corrected text, the state after it, its findings and, if they were collected,
+// its fixes
+// the file has a fixed size (the capacity) and is memory-mapped: entries are written one
+// after the other into a ring indexed by an open addressing table, the oldest are dropped
+// when the ring is full, and a hit on an entry in the older half of the ring copies it to
+// the front, so what is dropped is what was not used for the longest time
+// one process uses a file at a time (it is locked while open), the methods are thread safe
+class ResultCache
+{
+public:
+    static const uint64_t DEFAULT_CAPACITY = 64ull << 20;
+    static const uint64_t MIN_CAPACITY = 1ull << 20;
+
+    struct Key
+    {
+        Hash128 hash;
+        uint32_t length = 0; // bytes of the paragraph
+    };
+
+    struct Statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t evictions = 0; // entries dropped to make room
+        uint64_t entries = 0;   // in the file now
+        uint64_t capacity = 0;  // bytes of the file
+    };
+
+    ResultCache() = default;
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // opens the cache file at path, creating it and its directory if missing
+    // capacity is the size of the file (at least MIN_CAPACITY), a file of another size is
+    // resized and a file of another version or byte order, or one a process did not close,
+    // starts over empty; returns false with error set if it could not be created, mapped or
+    // locked (another process has it open)
+    bool Open(const std::string& path, uint64_t capacity, std::string& error);
+
+    void Close();
+
+    bool IsOpen() const { return base != nullptr; }
+
+    // the key of analyzing text from the sentence state in state (its findings do not matter)
+    static Key KeyFor(std::string_view text, const AnalysisSettings& settings, const RulePack& rules, const AnalysisState& state);
+
+    // on a hit sets text to the corrected paragraph, the sentence state of paragraph to the
+    // state after it and its findings to those of the paragraph, and adds its fixes to
+    // diagnostics (if not null) at offset
+    // an entry stored without fixes is a miss when diagnostics are wanted
+    bool Find(const Key& key, std::string& text, AnalysisState& paragraph, AnalysisDiagnostics* diagnostics, uint64_t offset);
+
+    // stores the corrected text of the paragraph with its state and findings in paragraph and,
+    // if diagnostics is not null, its fixes: the records from firstRecord on, at offset
+    // entries larger than a quarter of the ring are not stored
+    void Store(const Key& key, std::string_view text, const AnalysisState& paragraph, const AnalysisDiagnostics* diagnostics,
+               size_t firstRecord, uint64_t offset);
+
+    Statistics GetStatistics() const;
+
+private:
+    // checks the header of the file just mapped, a file this version could not have written
+    // and closed starts over empty
+    bool OpenMapped();
+
+    // drops every entry
+    void Reset();
+
+    // writes a whole entry to the front of the ring, dropping the oldest ones to make room
+    void Append(const char* record, size_t size, const Hash128& hash);
+
+    // drops the oldest entry (or skips the padding at the end of the ring), false if the
+    // ring is empty or damaged (it is then reset)
+    bool DropOldest();
+
+    mutable std::mutex mutex;
+    char* base = nullptr; // the mapped file
+    uint64_t size = 0;
+    Statistics statistics;
+    std::string promoted; // an entry being copied to the front
+#ifdef _WIN32
+    void* file = nullptr;    // HANDLE, opened without sharing
+    void* mapping = nullptr; // HANDLE of the file mapping object
+#else
+    int fd = -1; // holds the lock
+#endif
+};
+
+// path of the cache the GUI uses: results.cache in $XDG_CACHE_HOME/trace (~/.cache/trace) or
+// %LOCALAPPDATA%\trace on Windows
+std::string DefaultResultCachePath();
+
+// analyzes text like AnalyzePiece (same text and state), one paragraph at a time: the text
+// is cut where a new line starts (at the places FindPieceCut may cut) and each paragraph is
+// looked up in cache, analyzed and stored only if it is not there
+// fixes are recorded per paragraph, as if the paragraphs were pieces of a stream
+void AnalyzePieceCached(std::string& text, const AnalysisSettings& settings, const RulePack& rules, AnalysisState& state,
+                        ResultCache& cache, AnalysisDiagnostics* diagnostics = nullptr);
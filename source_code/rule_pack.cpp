@@ -0,0 +1,380 @@
+#include "rule_pack.h"
+
+#include "content_hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+    // pack file layout: a header followed by the sections, each starting at a multiple of 8
+    // bytes; numbers are stored in the byte order of the machine that wrote the pack, which
+    // BYTE_ORDER_MARK tells apart
+    const char PACK_MAGIC[4] = { 'T', 'R', 'P', 'K' };
+    const uint32_t PACK_VERSION = 3;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    const size_t SECTION_ALIGNMENT = 8;
+
+    enum Section
+    {
+        TYPO_NODES,
+        TYPO_EDGES,
+        TYPO_ROOT,
+        TYPO_REPLACEMENT_OFFSETS,
+        TYPO_REPLACEMENT_BYTES,
+        ABBREVIATION_OFFSETS,
+        ABBREVIATION_BYTES,
+        CODING_TERM_OFFSETS,
+        CODING_TERM_BYTES,
+        SPELLING_WORD_OFFSETS,
+        SPELLING_WORD_BYTES,
+        SPELLING_FREQUENCIES,
+        SPELLING_BUCKETS,
+        SPELLING_ENTRIES,
+        SECTION_COUNT
+    };
+
+    struct PackHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t language;
+        uint64_t fingerprint; // RulePack::Fingerprint of the rules
+        uint64_t sectionOffset[SECTION_COUNT];
+        uint64_t sectionSize[SECTION_COUNT];
+    };
+
+    static_assert(sizeof(WordReplacer::Node) == 12 && sizeof(WordReplacer::Edge) == 8 && sizeof(SpellingIndex::Entry) == 8,
+                  "pack arrays must have a fixed layout");
+    static_assert(sizeof(PackHeader) % SECTION_ALIGNMENT == 0, "sections must start aligned");
+
+    // abbreviations are short, longer tokens are not looked up
+    const size_t MAX_ABBREVIATION = 32;
+
+    // coding terms known without a coding_terms.txt
+    const char* const BUILTIN_CODING_TERMS[] = { "float", "double", "int" };
+
+    // reads a word list, one word per line, empty lines and lines starting with '#' skipped
+    bool LoadWords(const std::string& path, std::vector<std::string>& words, bool lowerCase)
+    {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+                line.pop_back();
+            if (line.empty() || line[0] == '#')
+                continue;
+            if (lowerCase)
+            {
+                for (char& c : line)
+                {
+                    if (c >= 'A' && c <= 'Z')
+                        c = static_cast<char>(c - 'A' + 'a');
+                }
+            }
+            words.push_back(line);
+        }
+        return true;
+    }
+
+    struct SectionData
+    {
+        const void* data;
+        size_t size;
+    };
+
+    // the arrays of a pack in section order
+    void CollectSections(const WordReplacer::Tables& tables, const WordList& abbreviations, const WordList& codingTerms,
+                         const SpellingIndex::Tables& words, SectionData* sections)
+    {
+        SectionData collected[SECTION_COUNT] = {
+            { tables.nodes, tables.nodeCount * sizeof(WordReplacer::Node) },
+            { tables.edges, tables.edgeCount * sizeof(WordReplacer::Edge) },
+            { tables.rootChild, tables.rootChild ? 256 * sizeof(int32_t) : 0 },
+            { tables.replacementOffsets, tables.replacementOffsets ? (tables.entryCount + 1) * sizeof(uint32_t) : 0 },
+            { tables.replacementBytes, tables.replacementOffsets ? tables.replacementOffsets[tables.entryCount] : 0 },
+            { abbreviations.Offsets(), (abbreviations.Size() + 1) * sizeof(uint32_t) },
+            { abbreviations.Bytes(), abbreviations.Offsets()[abbreviations.Size()] },
+            { codingTerms.Offsets(), (codingTerms.Size() + 1) * sizeof(uint32_t) },
+            { codingTerms.Bytes(), codingTerms.Offsets()[codingTerms.Size()] },
+            { words.wordOffsets, (words.wordCount + 1) * sizeof(uint32_t) },
+            { words.wordBytes, words.wordOffsets[words.wordCount] },
+            { words.frequencies, words.wordCount * sizeof(uint64_t) },
+            { words.bucketStarts, words.bucketStarts ? (words.bucketCount + 1) * sizeof(uint32_t) : 0 },
+            { words.entries, words.entryCount * sizeof(SpellingIndex::Entry) },
+        };
+        std::copy(std::begin(collected), std::end(collected), sections);
+    }
+
+    // hash of the language and every section, the same for rules built from the same
+    // sources whether they were mapped from a pack or built in memory
+    uint64_t HashSections(Language language, const SectionData* sections)
+    {
+        uint64_t fingerprint = HashCombine(PACK_VERSION, static_cast<uint64_t>(language));
+        for (int s = 0; s < SECTION_COUNT; ++s)
+            fingerprint = HashCombine(fingerprint, sections[s].size > 0 ? HashBytes(sections[s].data, sections[s].size, s).low : 0);
+        return fingerprint;
+    }
+}
+
+const char* LanguageCode(Language language)
+{
+    switch (language)
+    {
+    case Language::SPANISH: return "es";
+    case Language::FRENCH: return "fr";
+    case Language::POLISH: return "pl";
+    default: return "en";
+    }
+}
+
+bool ParseLanguageCode(const std::string& code, Language& language)
+{
+    if (code == "en") language = Language::ENGLISH;
+    else if (code == "es") language = Language::SPANISH;
+    else if (code == "fr") language = Language::FRENCH;
+    else if (code == "pl") language = Language::POLISH;
+    else return false;
+    return true;
+}
+
+void WordList::Assign(std::vector<std::string> words)
+{
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    offsets.assign(1, 0);
+    bytes.clear();
+    for (const std::string& word : words)
+    {
+        bytes += word;
+        offsets.push_back(static_cast<uint32_t>(bytes.size()));
+    }
+    external = false;
+}
+
+void WordList::UseTables(const uint32_t* newOffsets, const char* newBytes, uint32_t count)
+{
+    offsets.assign(1, 0);
+    bytes.clear();
+    externalOffsets = newOffsets;
+    externalBytes = newBytes;
+    externalCount = count;
+    external = true;
+}
+
+bool WordList::Contains(std::string_view word) const
+{
+    const uint32_t* wordOffsets = Offsets();
+    const char* wordBytes = Bytes();
+    size_t lo = 0;
+    size_t hi = Size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        std::string_view entry(wordBytes + wordOffsets[mid], wordOffsets[mid + 1] - wordOffsets[mid]);
+        int order = entry.compare(word);
+        if (order == 0)
+            return true;
+        if (order < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
+
+const char* const RULE_PACK_DIRECTORY = "dictionaries";
+
+std::string RulePackPath(Language language)
+{
+    return std::string(RULE_PACK_DIRECTORY) + "/" + LanguageCode(language) + ".pack";
+}
+
+bool RulePack::BuildFromSources(Language newLanguage, const std::string& directory, const std::string& typoPath)
+{
+    mapping.Close();
+    language = newLanguage;
+    const std::string code = LanguageCode(language);
+
+    WordReplacer replacer;
+    if (language == Language::ENGLISH)
+        AddBuiltinTypos(replacer);
+    bool typosRead = true;
+    if (typoPath.empty())
+        replacer.LoadFromFile(directory + "/typos_" + code + ".txt");
+    else
+        typosRead = replacer.LoadFromFile(typoPath);
+    replacer.Compile();
+    typos = std::move(replacer);
+
+    std::vector<std::string> words;
+    LoadWords(directory + "/abbreviations_" + code + ".txt", words, true);
+    abbreviations.Assign(std::move(words));
+
+    words.assign(std::begin(BUILTIN_CODING_TERMS), std::end(BUILTIN_CODING_TERMS));
+    LoadWords(directory + "/coding_terms.txt", words, false);
+    codingTerms.Assign(std::move(words));
+
+    std::vector<std::pair<std::string, uint64_t>> frequencies;
+    SpellingIndex::LoadWordList(directory + "/words_" + code + ".txt", frequencies);
+    spelling.Build(std::move(frequencies));
+
+    SectionData sections[SECTION_COUNT];
+    CollectSections(typos.CompiledTables(), abbreviations, codingTerms, spelling.CompiledTables(), sections);
+    fingerprint = HashSections(language, sections);
+    return typosRead;
+}
+
+bool RulePack::WritePack(const std::string& path) const
+{
+    SectionData sections[SECTION_COUNT];
+    CollectSections(typos.CompiledTables(), abbreviations, codingTerms, spelling.CompiledTables(), sections);
+
+    PackHeader header = {};
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.language = static_cast<uint32_t>(language);
+    header.fingerprint = fingerprint;
+    uint64_t offset = sizeof(PackHeader);
+    for (int s = 0; s < SECTION_COUNT; ++s)
+    {
+        header.sectionOffset[s] = offset;
+        header.sectionSize[s] = sections[s].size;
+        offset += (sections[s].size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[SECTION_ALIGNMENT] = {};
+    for (const SectionData& section : sections)
+    {
+        if (section.size > 0)
+            file.write(static_cast<const char*>(section.data), section.size);
+        file.write(padding, (SECTION_ALIGNMENT - section.size % SECTION_ALIGNMENT) % SECTION_ALIGNMENT);
+    }
+    return static_cast<bool>(file.flush());
+}
+
+bool RulePack::MapPack(Language newLanguage, const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(PackHeader))
+        return false;
+
+    PackHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header.version != PACK_VERSION
+        || header.byteOrder != BYTE_ORDER_MARK || header.language != static_cast<uint32_t>(newLanguage))
+        return false;
+
+    const uint64_t fileSize = file.Size();
+    for (int s = 0; s < SECTION_COUNT; ++s)
+    {
+        if (header.sectionOffset[s] % SECTION_ALIGNMENT != 0 || header.sectionOffset[s] > fileSize
+            || header.sectionSize[s] > fileSize - header.sectionOffset[s])
+            return false;
+    }
+    auto section = [&](Section s) { return file.Data() + header.sectionOffset[s]; };
+    auto count = [&](Section s, size_t elementSize) { return header.sectionSize[s] / elementSize; };
+    auto offsetsMatch = [&](Section offsets, Section bytes)
+    {
+        // the last offset is the size of the bytes
+        uint64_t entries = count(offsets, sizeof(uint32_t));
+        return header.sectionSize[offsets] % sizeof(uint32_t) == 0 && entries >= 1
+            && reinterpret_cast<const uint32_t*>(section(offsets))[entries - 1] == header.sectionSize[bytes];
+    };
+    if (header.sectionSize[TYPO_NODES] % sizeof(WordReplacer::Node) != 0 || count(TYPO_NODES, sizeof(WordReplacer::Node)) == 0
+        || header.sectionSize[TYPO_EDGES] % sizeof(WordReplacer::Edge) != 0 || header.sectionSize[TYPO_ROOT] != 256 * sizeof(int32_t)
+        || !offsetsMatch(TYPO_REPLACEMENT_OFFSETS, TYPO_REPLACEMENT_BYTES) || !offsetsMatch(ABBREVIATION_OFFSETS, ABBREVIATION_BYTES)
+        || !offsetsMatch(CODING_TERM_OFFSETS, CODING_TERM_BYTES) || !offsetsMatch(SPELLING_WORD_OFFSETS, SPELLING_WORD_BYTES))
+        return false;
+
+    // the spelling buckets are a power of two, their last start is the number of entries
+    const uint64_t wordCount = count(SPELLING_WORD_OFFSETS, sizeof(uint32_t)) - 1;
+    const uint64_t bucketCount = count(SPELLING_BUCKETS, sizeof(uint32_t)) - 1;
+    const uint64_t entryCount = count(SPELLING_ENTRIES, sizeof(SpellingIndex::Entry));
+    if (header.sectionSize[SPELLING_FREQUENCIES] != wordCount * sizeof(uint64_t) || header.sectionSize[SPELLING_BUCKETS] % sizeof(uint32_t) != 0
+        || count(SPELLING_BUCKETS, sizeof(uint32_t)) < 2 || (bucketCount & (bucketCount - 1)) != 0
+        || header.sectionSize[SPELLING_ENTRIES] % sizeof(SpellingIndex::Entry) != 0
+        || reinterpret_cast<const uint32_t*>(section(SPELLING_BUCKETS))[bucketCount] != entryCount)
+        return false;
+
+    WordReplacer::Tables tables;
+    tables.nodes = reinterpret_cast<const WordReplacer::Node*>(section(TYPO_NODES));
+    tables.nodeCount = static_cast<uint32_t>(count(TYPO_NODES, sizeof(WordReplacer::Node)));
+    tables.edges = reinterpret_cast<const WordReplacer::Edge*>(section(TYPO_EDGES));
+    tables.edgeCount = static_cast<uint32_t>(count(TYPO_EDGES, sizeof(WordReplacer::Edge)));
+    tables.rootChild = reinterpret_cast<const int32_t*>(section(TYPO_ROOT));
+    tables.replacementOffsets = reinterpret_cast<const uint32_t*>(section(TYPO_REPLACEMENT_OFFSETS));
+    tables.replacementBytes = section(TYPO_REPLACEMENT_BYTES);
+    tables.entryCount = static_cast<uint32_t>(count(TYPO_REPLACEMENT_OFFSETS, sizeof(uint32_t)) - 1);
+    typos.UseTables(tables);
+
+    abbreviations.UseTables(reinterpret_cast<const uint32_t*>(section(ABBREVIATION_OFFSETS)), section(ABBREVIATION_BYTES),
+                            static_cast<uint32_t>(count(ABBREVIATION_OFFSETS, sizeof(uint32_t)) - 1));
+    codingTerms.UseTables(reinterpret_cast<const uint32_t*>(section(CODING_TERM_OFFSETS)), section(CODING_TERM_BYTES),
+                          static_cast<uint32_t>(count(CODING_TERM_OFFSETS, sizeof(uint32_t)) - 1));
+
+    SpellingIndex::Tables words;
+    words.wordOffsets = reinterpret_cast<const uint32_t*>(section(SPELLING_WORD_OFFSETS));
+    words.wordBytes = section(SPELLING_WORD_BYTES);
+    words.frequencies = reinterpret_cast<const uint64_t*>(section(SPELLING_FREQUENCIES));
+    words.wordCount = static_cast<uint32_t>(wordCount);
+    words.bucketStarts = reinterpret_cast<const uint32_t*>(section(SPELLING_BUCKETS));
+    words.bucketCount = static_cast<uint32_t>(bucketCount);
+    words.entries = reinterpret_cast<const SpellingIndex::Entry*>(section(SPELLING_ENTRIES));
+    words.entryCount = static_cast<uint32_t>(entryCount);
+    spelling.UseTables(words);
+
+    // the tables point into the new mapping, the old one is released by the swap
+    mapping.Swap(file);
+    language = newLanguage;
+    fingerprint = header.fingerprint;
+    return true;
+}
+
+bool RulePack::IsAbbreviation(std::string_view token) const
+{
+    while (!token.empty() && (token.back() == ',' || token.back() == ';' || token.back() == ':'))
+        token.remove_suffix(1);
+    if (token.empty() || token.size() > MAX_ABBREVIATION || abbreviations.Empty())
+        return false;
+
+    char lower[MAX_ABBREVIATION];
+    for (size_t i = 0; i < token.size(); ++i)
+    {
+        char c = token[i];
+        lower[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return abbreviations.Contains(std::string_view(lower, token.size()));
+}
+
+const RulePack& RulePackFor(Language language)
+{
+    static RulePack packs[LANGUAGE_COUNT];
+    static std::once_flag loaded[LANGUAGE_COUNT];
+
+    size_t index = static_cast<size_t>(language);
+    std::call_once(loaded[index], [language, index]
+    {
+        RulePack& pack = packs[index];
+        if (!pack.MapPack(language, RulePackPath(language)))
+            pack.BuildFromSources(language, RULE_PACK_DIRECTORY);
+    });
+    return packs[index];
+}
+
+const RulePack& DefaultRulePack()
+{
+    return RulePackFor(Language::ENGLISH);
+}
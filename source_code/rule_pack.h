@@ -0,0 +1,125 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "spelling_index.h"
+#include "word_replacer.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Enumeration for languages
+enum class Language
+{
+    ENGLISH,
+    SPANISH,
+    FRENCH,
+    POLISH
+};
+
+const size_t LANGUAGE_COUNT = 4;
+
+// ISO 639-1 code of a language, e.g. "pl"
+const char* LanguageCode(Language language);
+
+// the language of a code, returns false for an unknown code
+bool ParseLanguageCode(const std::string& code, Language& language);
+
+// a sorted set of words stored back to back, looked up by binary search
+class WordList
+{
+public:
+    // replaces the list with words, sorted and without duplicates
+    void Assign(std::vector<std::string> words);
+
+    // uses count words stored elsewhere (offsets has count + 1 entries) instead of the own ones
+    void UseTables(const uint32_t* offsets, const char* bytes, uint32_t count);
+
+    bool Contains(std::string_view word) const;
+    bool Empty() const { return Size() == 0; }
+    size_t Size() const { return external ? externalCount : offsets.size() - 1; }
+
+    const uint32_t* Offsets() const { return external ? externalOffsets : offsets.data(); }
+    const char* Bytes() const { return external ? externalBytes : bytes.data(); }
+
+private:
+    std::vector<uint32_t> offsets = std::vector<uint32_t>(1, 0);
+    std::string bytes;
+
+    bool external = false;
+    const uint32_t* externalOffsets = nullptr;
+    const char* externalBytes = nullptr;
+    uint32_t externalCount = 0;
+};
+
+// directory the rule packs and their sources are looked up in, relative to the working directory
+extern const char* const RULE_PACK_DIRECTORY;
+
+// path of the compiled pack of a language, e.g. "dictionaries/pl.pack"
+std::string RulePackPath(Language language);
+
+// the rules of one language: typo replacements, abbreviations whose period does not end a
+// sentence, the coding terms left as they are and the word list spelling suggestions come from
+// packs are compiled offline (trace_pack) into one file holding the arrays the lookups use,
+// so loading a pack maps the file and reads nothing until a lookup touches its pages
+class RulePack
+{
+public:
+    RulePack() = default;
+    RulePack(const RulePack&) = delete;
+    RulePack& operator=(const RulePack&) = delete;
+
+    // builds the rules from the text sources in directory: typos_<code>.txt (or typoPath if
+    // not empty, see WordReplacer::LoadFromFile), abbreviations_<code>.txt and
+    // coding_terms.txt with one word per line, words_<code>.txt with one word and its
+    // frequency per line (see SpellingIndex::LoadWordList), plus the built-in entries
+    // missing sources leave the built-in entries only, returns false if typoPath could not be read
+    bool BuildFromSources(Language language, const std::string& directory, const std::string& typoPath = "");
+
+    // writes the rules as a pack file, returns false if it could not be written
+    bool WritePack(const std::string& path) const;
+
+    // maps a pack file of language written by WritePack, the rules then point into the
+    // mapping; returns false (keeping the rules) if the file is missing, of another language,
+    // version or byte order, or truncated
+    // the arrays themselves are not checked, packs are trusted build output
+    bool MapPack(Language language, const std::string& path);
+
+    Language GetLanguage() const { return language; }
+
+    // hash of all the rules, equal for packs with the same rules, so results stored by one
+    // run (see ResultCache) are only reused by a later one with the same rules
+    uint64_t Fingerprint() const { return fingerprint; }
+    bool IsMapped() const { return mapping.IsOpen(); }
+
+    const WordReplacer& Typos() const { return typos; }
+
+    // true if word is a coding term whose case the capitalization passes keep, e.g. "int"
+    bool IsCodingTerm(std::string_view word) const { return codingTerms.Contains(word); }
+
+    // true if token (a word with its punctuation, e.g. "Dr." or "e.g.,") is an abbreviation
+    // whose periods do not end a sentence; trailing ",;:" are ignored and ASCII letters
+    // compared lower-case
+    bool IsAbbreviation(std::string_view token) const;
+    bool HasAbbreviations() const { return !abbreviations.Empty(); }
+
+    // the word list of the spelling pass, empty without a words_<code>.txt
+    const SpellingIndex& Spelling() const { return spelling; }
+
+private:
+    Language language = Language::ENGLISH;
+    uint64_t fingerprint = 0;
+    WordReplacer typos;
+    WordList abbreviations; // lower-case
+    WordList codingTerms;
+    SpellingIndex spelling;
+    MappedFile mapping;
+};
+
+// the rules of a language, loaded on first use from its pack in RULE_PACK_DIRECTORY or, if
+// there is no valid pack, built from the sources there; safe to call from any thread
+const RulePack& RulePackFor(Language language);
+
+// the English rules
+const RulePack& DefaultRulePack();
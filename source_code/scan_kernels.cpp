@@ -0,0 +1,409 @@
+#include "scan_kernels.h"
+#include "char_classes.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRACE_SCAN_SSE2 1
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define TRACE_SCAN_AVX2 1
+#define TRACE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define TRACE_SCAN_AVX2 1
+#define TRACE_TARGET_AVX2
+#endif
+#endif
+
+ByteSet::ByteSet(const char* text)
+{
+    for (const char* p = text; *p && count < MAX_BYTES; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (member[c])
+            continue;
+        member[c] = true;
+        bytes[count++] = c;
+    }
+}
+
+namespace
+{
+    // scalar versions, also used for the bytes after the last full vector
+
+    size_t FindFirstOfScalar(const char* data, size_t size, size_t from, const ByteSet& set)
+    {
+        while (from < size && !set.Contains(static_cast<unsigned char>(data[from]))) ++from;
+        return from;
+    }
+
+    size_t SkipWhitespaceScalar(const char* data, size_t size, size_t from)
+    {
+        while (from < size && IsSpacingWhitespace(data[from])) ++from;
+        return from;
+    }
+
+    size_t FindWordEndScalar(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        while (from < size && !IsSpacingWhitespace(data[from]) && !stops.Contains(static_cast<unsigned char>(data[from]))) ++from;
+        return from;
+    }
+
+    size_t FindSpacingFixScalar(const char* data, size_t size, size_t from, const ByteSet& punctuation)
+    {
+        for (; from + 1 < size; ++from)
+        {
+            unsigned char c = data[from];
+            unsigned char next = data[from + 1];
+            if (IsSpacingWhitespace(c) && (IsSpacingWhitespace(next) || punctuation.Contains(next)))
+                return from;
+            if (punctuation.Contains(c) && IsAsciiLetter(next))
+                return from;
+        }
+        return size;
+    }
+
+    size_t FindPlainWordsEndScalar(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        for (; from < size; ++from)
+        {
+            unsigned char c = data[from];
+            if (stops.Contains(c))
+                return from;
+            if (IsSpacingWhitespace(c)
+                && (c != ' ' || from + 1 == size || IsSpacingWhitespace(data[from + 1]) || stops.Contains(static_cast<unsigned char>(data[from + 1]))))
+                return from;
+        }
+        return size;
+    }
+
+#if defined(TRACE_SCAN_SSE2) || defined(TRACE_SCAN_AVX2)
+    inline unsigned LowestBit(unsigned mask)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+#ifdef TRACE_SCAN_SSE2
+    // 0xFF in the bytes of v that are whitespace, '\t' to '\r' compared unsigned
+    inline __m128i WhitespaceSse2(__m128i v)
+    {
+        __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+        return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    }
+
+    inline __m128i MatchSse2(__m128i v, const ByteSet& set)
+    {
+        __m128i found = _mm_setzero_si128();
+        for (int b = 0; b < set.Count(); ++b)
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(set.Byte(b)))));
+        return found;
+    }
+
+    inline __m128i LetterSse2(__m128i v)
+    {
+        __m128i shifted = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('z' - 'a')), shifted);
+    }
+
+    size_t FindFirstOfSse2(const char* data, size_t size, size_t from, const ByteSet& set)
+    {
+        for (; from + 16 <= size; from += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(MatchSse2(v, set)));
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return FindFirstOfScalar(data, size, from, set);
+    }
+
+    size_t SkipWhitespaceSse2(const char* data, size_t size, size_t from)
+    {
+        for (; from + 16 <= size; from += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(WhitespaceSse2(v))) & 0xFFFF;
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return SkipWhitespaceScalar(data, size, from);
+    }
+
+    size_t FindWordEndSse2(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        for (; from + 16 <= size; from += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(WhitespaceSse2(v), MatchSse2(v, stops))));
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return FindWordEndScalar(data, size, from, stops);
+    }
+
+    // the bit masks are shifted by one byte to look at the following byte, so only the first
+    // 15 bytes of each load are decided and the next load overlaps by one
+    size_t FindSpacingFixSse2(const char* data, size_t size, size_t from, const ByteSet& punctuation)
+    {
+        for (; from + 16 <= size; from += 15)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            unsigned whitespace = static_cast<unsigned>(_mm_movemask_epi8(WhitespaceSse2(v)));
+            unsigned punct = static_cast<unsigned>(_mm_movemask_epi8(MatchSse2(v, punctuation)));
+            unsigned letter = static_cast<unsigned>(_mm_movemask_epi8(LetterSse2(v)));
+            unsigned fixes = ((whitespace & ((whitespace | punct) >> 1)) | (punct & (letter >> 1))) & 0x7FFF;
+            if (fixes != 0)
+                return from + LowestBit(fixes);
+        }
+        return FindSpacingFixScalar(data, size, from, punctuation);
+    }
+
+    size_t FindPlainWordsEndSse2(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        for (; from + 16 <= size; from += 15)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            unsigned whitespace = static_cast<unsigned>(_mm_movemask_epi8(WhitespaceSse2(v)));
+            unsigned space = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+            unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(MatchSse2(v, stops)));
+            unsigned ends = (stop | (whitespace & ~space) | (space & ((whitespace | stop) >> 1))) & 0x7FFF;
+            if (ends != 0)
+                return from + LowestBit(ends);
+        }
+        return FindPlainWordsEndScalar(data, size, from, stops);
+    }
+#endif
+
+#ifdef TRACE_SCAN_AVX2
+    TRACE_TARGET_AVX2 inline __m256i WhitespaceAvx2(__m256i v)
+    {
+        __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+        return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    }
+
+    TRACE_TARGET_AVX2 inline __m256i MatchAvx2(__m256i v, const ByteSet& set)
+    {
+        __m256i found = _mm256_setzero_si256();
+        for (int b = 0; b < set.Count(); ++b)
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(set.Byte(b)))));
+        return found;
+    }
+
+    TRACE_TARGET_AVX2 inline __m256i LetterAvx2(__m256i v)
+    {
+        __m256i shifted = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('z' - 'a')), shifted);
+    }
+
+    TRACE_TARGET_AVX2 size_t FindFirstOfAvx2(const char* data, size_t size, size_t from, const ByteSet& set)
+    {
+        for (; from + 32 <= size; from += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(MatchAvx2(v, set)));
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return FindFirstOfScalar(data, size, from, set);
+    }
+
+    TRACE_TARGET_AVX2 size_t SkipWhitespaceAvx2(const char* data, size_t size, size_t from)
+    {
+        for (; from + 32 <= size; from += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(WhitespaceAvx2(v)));
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return SkipWhitespaceScalar(data, size, from);
+    }
+
+    TRACE_TARGET_AVX2 size_t FindWordEndAvx2(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        for (; from + 32 <= size; from += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(WhitespaceAvx2(v), MatchAvx2(v, stops))));
+            if (mask != 0)
+                return from + LowestBit(mask);
+        }
+        return FindWordEndScalar(data, size, from, stops);
+    }
+
+    TRACE_TARGET_AVX2 size_t FindSpacingFixAvx2(const char* data, size_t size, size_t from, const ByteSet& punctuation)
+    {
+        for (; from + 32 <= size; from += 31)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            unsigned whitespace = static_cast<unsigned>(_mm256_movemask_epi8(WhitespaceAvx2(v)));
+            unsigned punct = static_cast<unsigned>(_mm256_movemask_epi8(MatchAvx2(v, punctuation)));
+            unsigned letter = static_cast<unsigned>(_mm256_movemask_epi8(LetterAvx2(v)));
+            unsigned fixes = ((whitespace & ((whitespace | punct) >> 1)) | (punct & (letter >> 1))) & 0x7FFFFFFF;
+            if (fixes != 0)
+                return from + LowestBit(fixes);
+        }
+        return FindSpacingFixScalar(data, size, from, punctuation);
+    }
+
+    TRACE_TARGET_AVX2 size_t FindPlainWordsEndAvx2(const char* data, size_t size, size_t from, const ByteSet& stops)
+    {
+        for (; from + 32 <= size; from += 31)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            unsigned whitespace = static_cast<unsigned>(_mm256_movemask_epi8(WhitespaceAvx2(v)));
+            unsigned space = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+            unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(MatchAvx2(v, stops)));
+            unsigned ends = (stop | (whitespace & ~space) | (space & ((whitespace | stop) >> 1))) & 0x7FFFFFFF;
+            if (ends != 0)
+                return from + LowestBit(ends);
+        }
+        return FindPlainWordsEndScalar(data, size, from, stops);
+    }
+
+    bool CpuHasAvx2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+#endif
+
+    struct ScanKernels
+    {
+        size_t (*findFirstOf)(const char*, size_t, size_t, const ByteSet&);
+        size_t (*skipWhitespace)(const char*, size_t, size_t);
+        size_t (*findWordEnd)(const char*, size_t, size_t, const ByteSet&);
+        size_t (*findSpacingFix)(const char*, size_t, size_t, const ByteSet&);
+        size_t (*findPlainWordsEnd)(const char*, size_t, size_t, const ByteSet&);
+    };
+
+    const ScanKernels SCALAR_KERNELS = { FindFirstOfScalar, SkipWhitespaceScalar, FindWordEndScalar, FindSpacingFixScalar, FindPlainWordsEndScalar };
+#ifdef TRACE_SCAN_SSE2
+    const ScanKernels SSE2_KERNELS = { FindFirstOfSse2, SkipWhitespaceSse2, FindWordEndSse2, FindSpacingFixSse2, FindPlainWordsEndSse2 };
+#endif
+#ifdef TRACE_SCAN_AVX2
+    const ScanKernels AVX2_KERNELS = { FindFirstOfAvx2, SkipWhitespaceAvx2, FindWordEndAvx2, FindSpacingFixAvx2, FindPlainWordsEndAvx2 };
+#endif
+
+    const ScanKernels& KernelsFor(ScanLevel level)
+    {
+        switch (level)
+        {
+#ifdef TRACE_SCAN_AVX2
+        case ScanLevel::AVX2: return AVX2_KERNELS;
+#endif
+#ifdef TRACE_SCAN_SSE2
+        case ScanLevel::SSE2: return SSE2_KERNELS;
+#endif
+        default: return SCALAR_KERNELS;
+        }
+    }
+
+    // the kernels in use, chosen on first use
+    std::atomic<const ScanKernels*>& ActiveKernels()
+    {
+        static std::atomic<const ScanKernels*> kernels{ &KernelsFor(SupportedScanLevel()) };
+        return kernels;
+    }
+
+    inline const ScanKernels& Kernels()
+    {
+        return *ActiveKernels().load(std::memory_order_relaxed);
+    }
+}
+
+ScanLevel SupportedScanLevel()
+{
+    static const ScanLevel level = []
+    {
+#ifdef TRACE_SCAN_AVX2
+        if (CpuHasAvx2())
+            return ScanLevel::AVX2;
+#endif
+#ifdef TRACE_SCAN_SSE2
+        return ScanLevel::SSE2;
+#else
+        return ScanLevel::SCALAR;
+#endif
+    }();
+    return level;
+}
+
+void SetScanLevel(ScanLevel level)
+{
+    if (static_cast<int>(level) > static_cast<int>(SupportedScanLevel()))
+        level = SupportedScanLevel();
+    ActiveKernels().store(&KernelsFor(level), std::memory_order_relaxed);
+}
+
+ScanLevel CurrentScanLevel()
+{
+    const ScanKernels* kernels = &Kernels();
+#ifdef TRACE_SCAN_AVX2
+    if (kernels == &AVX2_KERNELS)
+        return ScanLevel::AVX2;
+#endif
+#ifdef TRACE_SCAN_SSE2
+    if (kernels == &SSE2_KERNELS)
+        return ScanLevel::SSE2;
+#endif
+    return ScanLevel::SCALAR;
+}
+
+const char* ScanLevelName(ScanLevel level)
+{
+    switch (level)
+    {
+    case ScanLevel::SSE2: return "sse2";
+    case ScanLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+size_t FindFirstOf(std::string_view text, size_t from, const ByteSet& set)
+{
+    return Kernels().findFirstOf(text.data(), text.size(), from, set);
+}
+
+size_t SkipWhitespace(std::string_view text, size_t from)
+{
+    return Kernels().skipWhitespace(text.data(), text.size(), from);
+}
+
+size_t FindWordEnd(std::string_view text, size_t from, const ByteSet& stops)
+{
+    return Kernels().findWordEnd(text.data(), text.size(), from, stops);
+}
+
+size_t FindSpacingFix(std::string_view text, size_t from, const ByteSet& punctuation)
+{
+    return Kernels().findSpacingFix(text.data(), text.size(), from, punctuation);
+}
+
+size_t FindPlainWordsEnd(std::string_view text, size_t from, const ByteSet& stops)
+{
+    return Kernels().findPlainWordsEnd(text.data(), text.size(), from, stops);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// scanning primitives of the analysis passes, each in a scalar, an SSE2 and an AVX2 version
+// the best version the CPU supports is chosen at runtime on first use, so one binary runs
+// everywhere and still compares 16 or 32 bytes per step where it can
+// every primitive returns text.size() when nothing is found
+
+// a few bytes searched for together, e.g. the sentence terminators ".!?"
+class ByteSet
+{
+public:
+    static const int MAX_BYTES = 16;
+
+    // the bytes of a zero terminated string, at most MAX_BYTES (the rest is ignored)
+    explicit ByteSet(const char* bytes);
+
+    bool Contains(unsigned char c) const { return member[c]; }
+    int Count() const { return count; }
+    unsigned char Byte(int index) const { return bytes[index]; }
+
+private:
+    unsigned char bytes[MAX_BYTES] = {};
+    int count = 0;
+    bool member[256] = {};
+};
+
+enum class ScanLevel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// the best level this CPU and build support
+ScanLevel SupportedScanLevel();
+
+// level used from now on, lowered to SupportedScanLevel() (for benchmarks and comparisons)
+void SetScanLevel(ScanLevel level);
+ScanLevel CurrentScanLevel();
+const char* ScanLevelName(ScanLevel level);
+
+// first position at or after from holding a byte of set
+size_t FindFirstOf(std::string_view text, size_t from, const ByteSet& set);
+
+// first position at or after from that is not whitespace (see IsSpacingWhitespace)
+size_t SkipWhitespace(std::string_view text, size_t from);
+
+// first position at or after from that is whitespace or a byte of stops, i.e. the end of
+// the word starting at from
+size_t FindWordEnd(std::string_view text, size_t from, const ByteSet& stops);
+
+// first position at or after from where NormalizeSpacing has something to fix: whitespace
+// followed by whitespace or a byte of punctuation, or punctuation followed by an ASCII letter
+size_t FindSpacingFix(std::string_view text, size_t from, const ByteSet& punctuation);
+
+// first position at or after from that ends a run of words separated by single spaces: a
+// byte of stops, whitespace other than a space, or a space followed by whitespace, a byte of
+// stops or the end of the text
+size_t FindPlainWordsEnd(std::string_view text, size_t from, const ByteSet& stops);
@@ -0,0 +1,284 @@
+#include "spelling_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+    static_assert(SpellingIndex::MAX_EDIT_DISTANCE == 2, "DeleteHashes makes up to two deletes");
+
+    // the deletes of a prefix: itself, one character and two characters removed
+    const size_t MAX_DELETES = 1 + SpellingIndex::PREFIX_LENGTH + SpellingIndex::PREFIX_LENGTH * (SpellingIndex::PREFIX_LENGTH - 1) / 2;
+
+    // decodes word into chars (room for MAX_WORD_LENGTH), false if it is empty, longer or
+    // not valid UTF-8
+    bool DecodeWord(std::string_view word, char32_t* chars, size_t& length)
+    {
+        length = 0;
+        size_t i = 0;
+        while (i < word.size())
+        {
+            if (length == SpellingIndex::MAX_WORD_LENGTH)
+                return false;
+            unsigned char lead = word[i];
+            size_t size = lead < 0x80 ? 1 : lead >= 0xC2 && lead <= 0xDF ? 2 : lead >= 0xE0 && lead <= 0xEF ? 3 : lead >= 0xF0 && lead <= 0xF4 ? 4 : 0;
+            if (size == 0 || i + size > word.size())
+                return false;
+            char32_t c = size == 1 ? lead : lead & (0x7F >> size);
+            for (size_t k = 1; k < size; ++k)
+            {
+                unsigned char next = word[i + k];
+                if ((next & 0xC0) != 0x80)
+                    return false;
+                c = (c << 6) | (next & 0x3F);
+            }
+            chars[length++] = c;
+            i += size;
+        }
+        return length > 0;
+    }
+
+    // FNV-1a over the characters of chars except the ones at skipA and skipB
+    uint64_t HashWithout(const char32_t* chars, size_t length, size_t skipA, size_t skipB)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (i == skipA || i == skipB)
+                continue;
+            hash = (hash ^ chars[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // hashes of the strings left by deleting up to distance characters of the prefix of
+    // chars, each once; returns how many were written to hashes (room for MAX_DELETES)
+    size_t DeleteHashes(const char32_t* chars, size_t length, size_t distance, uint64_t* hashes)
+    {
+        const size_t none = length;
+        length = std::min(length, SpellingIndex::PREFIX_LENGTH);
+        size_t count = 0;
+        hashes[count++] = HashWithout(chars, length, none, none);
+        for (size_t a = 0; distance >= 1 && a < length; ++a)
+        {
+            hashes[count++] = HashWithout(chars, length, a, none);
+            for (size_t b = a + 1; distance >= 2 && b < length; ++b)
+                hashes[count++] = HashWithout(chars, length, a, b);
+        }
+        std::sort(hashes, hashes + count);
+        return std::unique(hashes, hashes + count) - hashes;
+    }
+
+    // source of SpellingIndex::Version, unique across all indexes
+    std::atomic<uint64_t> nextVersion(1);
+
+    // optimal string alignment distance (edits of single characters and swaps of neighbours),
+    // limit + 1 for anything larger than limit
+    size_t EditDistance(const char32_t* a, size_t n, const char32_t* b, size_t m, size_t limit)
+    {
+        if (n > m + limit || m > n + limit)
+            return limit + 1;
+
+        size_t rows[3][SpellingIndex::MAX_WORD_LENGTH + 1];
+        size_t* beforePrevious = rows[0];
+        size_t* previous = rows[1];
+        size_t* current = rows[2];
+        for (size_t j = 0; j <= m; ++j)
+            previous[j] = j;
+        for (size_t i = 1; i <= n; ++i)
+        {
+            current[0] = i;
+            size_t rowMinimum = i;
+            for (size_t j = 1; j <= m; ++j)
+            {
+                size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                size_t value = std::min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+                if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                    value = std::min(value, beforePrevious[j - 2] + 1);
+                current[j] = value;
+                rowMinimum = std::min(rowMinimum, value);
+            }
+            // every later row is at least this far off
+            if (rowMinimum > limit)
+                return limit + 1;
+            std::swap(beforePrevious, previous);
+            std::swap(previous, current);
+        }
+        return std::min(previous[m], limit + 1);
+    }
+}
+
+void SpellingIndex::Build(std::vector<std::pair<std::string, uint64_t>> words)
+{
+    std::sort(words.begin(), words.end());
+    wordOffsets.assign(1, 0);
+    wordBytes.clear();
+    frequencies.clear();
+    external = false;
+    version = nextVersion++;
+
+    // the deletes of each word with its number, bucketed once all are known
+    std::vector<std::pair<uint64_t, uint32_t>> deletes;
+    char32_t chars[MAX_WORD_LENGTH];
+    uint64_t hashes[MAX_DELETES];
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        if (!frequencies.empty() && std::string_view(wordBytes).substr(wordOffsets[frequencies.size() - 1]) == words[i].first)
+        {
+            frequencies.back() += words[i].second;
+            continue;
+        }
+        size_t length;
+        if (!DecodeWord(words[i].first, chars, length))
+            continue;
+
+        uint32_t word = static_cast<uint32_t>(frequencies.size());
+        wordBytes += words[i].first;
+        wordOffsets.push_back(static_cast<uint32_t>(wordBytes.size()));
+        frequencies.push_back(words[i].second);
+        size_t count = DeleteHashes(chars, length, MAX_EDIT_DISTANCE, hashes);
+        for (size_t d = 0; d < count; ++d)
+            deletes.emplace_back(hashes[d], word);
+    }
+
+    // about two entries per bucket, the buckets are filled by a counting sort
+    uint32_t bucketCount = 1;
+    while (bucketCount < deletes.size() / 2)
+        bucketCount *= 2;
+    bucketStarts.assign(bucketCount + 1, 0);
+    for (const auto& entry : deletes)
+        ++bucketStarts[(static_cast<uint32_t>(entry.first >> 32) & (bucketCount - 1)) + 1];
+    for (uint32_t b = 0; b < bucketCount; ++b)
+        bucketStarts[b + 1] += bucketStarts[b];
+    entries.resize(deletes.size());
+    std::vector<uint32_t> next(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (const auto& entry : deletes)
+        entries[next[static_cast<uint32_t>(entry.first >> 32) & (bucketCount - 1)]++] = Entry{ static_cast<uint32_t>(entry.first), entry.second };
+}
+
+bool SpellingIndex::LoadWordList(const std::string& path, std::vector<std::pair<std::string, uint64_t>>& words)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        size_t space = line.find_first_of(" \t");
+        uint64_t count = space == std::string::npos ? 1 : std::strtoull(line.c_str() + space + 1, nullptr, 10);
+        words.emplace_back(line.substr(0, space), count);
+    }
+    return true;
+}
+
+void SpellingIndex::UseTables(const Tables& tables)
+{
+    wordOffsets.assign(1, 0);
+    wordBytes.clear();
+    frequencies.clear();
+    bucketStarts.clear();
+    entries.clear();
+    externalTables = tables;
+    external = true;
+    version = nextVersion++;
+}
+
+SpellingIndex::Tables SpellingIndex::View() const
+{
+    if (external)
+        return externalTables;
+
+    Tables tables;
+    tables.wordOffsets = wordOffsets.data();
+    tables.wordBytes = wordBytes.data();
+    tables.frequencies = frequencies.data();
+    tables.wordCount = static_cast<uint32_t>(frequencies.size());
+    if (!bucketStarts.empty())
+    {
+        tables.bucketStarts = bucketStarts.data();
+        tables.bucketCount = static_cast<uint32_t>(bucketStarts.size() - 1);
+    }
+    tables.entries = entries.data();
+    tables.entryCount = static_cast<uint32_t>(entries.size());
+    return tables;
+}
+
+template <typename Found>
+void SpellingIndex::Probe(const Tables& tables, uint64_t hash, Found found)
+{
+    if (tables.bucketCount == 0)
+        return;
+    uint32_t bucket = static_cast<uint32_t>(hash >> 32) & (tables.bucketCount - 1);
+    uint32_t check = static_cast<uint32_t>(hash);
+    for (uint32_t e = tables.bucketStarts[bucket]; e < tables.bucketStarts[bucket + 1]; ++e)
+    {
+        if (tables.entries[e].check == check)
+            found(tables.entries[e].word);
+    }
+}
+
+bool SpellingIndex::Contains(std::string_view word) const
+{
+    const Tables tables = View();
+    char32_t chars[MAX_WORD_LENGTH];
+    size_t length;
+    if (tables.wordCount == 0 || !DecodeWord(word, chars, length))
+        return false;
+
+    // a listed word is indexed under its own prefix
+    bool found = false;
+    Probe(tables, HashWithout(chars, std::min(length, PREFIX_LENGTH), length, length), [&](uint32_t id)
+    {
+        found = found || std::string_view(tables.wordBytes + tables.wordOffsets[id], tables.wordOffsets[id + 1] - tables.wordOffsets[id]) == word;
+    });
+    return found;
+}
+
+std::string_view SpellingIndex::Suggest(std::string_view word, size_t maxDistance) const
+{
+    const Tables tables = View();
+    char32_t chars[MAX_WORD_LENGTH];
+    size_t length;
+    if (tables.wordCount == 0 || !DecodeWord(word, chars, length))
+        return std::string_view();
+    maxDistance = std::min(maxDistance, MAX_EDIT_DISTANCE);
+
+    uint64_t hashes[MAX_DELETES];
+    size_t hashCount = DeleteHashes(chars, length, maxDistance, hashes);
+    std::vector<uint32_t> candidates;
+    for (size_t h = 0; h < hashCount; ++h)
+        Probe(tables, hashes[h], [&candidates](uint32_t id) { candidates.push_back(id); });
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::string_view best;
+    size_t bestDistance = maxDistance + 1;
+    uint64_t bestFrequency = 0;
+    char32_t candidateChars[MAX_WORD_LENGTH];
+    for (uint32_t id : candidates)
+    {
+        std::string_view candidate(tables.wordBytes + tables.wordOffsets[id], tables.wordOffsets[id + 1] - tables.wordOffsets[id]);
+        if (candidate == word)
+            return std::string_view();
+        size_t candidateLength;
+        if (!DecodeWord(candidate, candidateChars, candidateLength))
+            continue;
+        size_t distance = EditDistance(chars, length, candidateChars, candidateLength, std::min(bestDistance, maxDistance));
+        if (distance > maxDistance)
+            continue;
+        if (distance < bestDistance || (distance == bestDistance && tables.frequencies[id] > bestFrequency))
+        {
+            best = candidate;
+            bestDistance = distance;
+            bestFrequency = tables.frequencies[id];
+        }
+    }
+    return best;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// suggests the correction of a word missing from a word list: the listed word within
+// MAX_EDIT_DISTANCE edits (insertions, deletions, substitutions and swaps of neighbouring
+// characters) with the fewest edits, the most frequent one among those
+// uses the symmetric delete method: every listed word is indexed under each string left by
+// deleting up to MAX_EDIT_DISTANCE characters of its first PREFIX_LENGTH characters, a
+// lookup makes the same deletes of the word and only compares the words found under them,
+// so it costs a few dozen hash probes whatever the size of the list
+// characters are UTF-8 code points, the list is expected in lower case
+class SpellingIndex
+{
+public:
+    static constexpr size_t MAX_EDIT_DISTANCE = 2;
+    static constexpr size_t PREFIX_LENGTH = 7;
+    static constexpr size_t MAX_WORD_LENGTH = 32; // in characters, longer words are neither listed nor looked up
+
+    // one listed word under one delete, check is the low half of the delete's hash (the high
+    // bits select the bucket)
+    struct Entry
+    {
+        uint32_t check;
+        uint32_t word;
+    };
+
+    // the index as plain arrays, so it can be written to a file and used from a mapping of
+    // it (see rule_pack.h), valid while the index (or the memory given to UseTables) is
+    struct Tables
+    {
+        const uint32_t* wordOffsets = nullptr; // wordCount + 1 offsets into wordBytes, words sorted
+        const char* wordBytes = nullptr;
+        const uint64_t* frequencies = nullptr; // of each word
+        uint32_t wordCount = 0;
+        const uint32_t* bucketStarts = nullptr; // 2^n + 1 offsets into entries
+        uint32_t bucketCount = 0;               // 2^n, a power of two
+        const Entry* entries = nullptr;
+        uint32_t entryCount = 0;
+    };
+
+    // indexes words with their frequencies, a word listed twice counts with the sum of both
+    // invalid UTF-8 and words longer than MAX_WORD_LENGTH are left out
+    void Build(std::vector<std::pair<std::string, uint64_t>> words);
+
+    // reads a frequency list, one "word count" per line (the count may be left out and then
+    // is 1), empty lines and lines starting with '#' skipped, and appends it to words
+    // returns false if the file could not be opened
+    static bool LoadWordList(const std::string& path, std::vector<std::pair<std::string, uint64_t>>& words);
+
+    Tables CompiledTables() const { return View(); }
+
+    // uses arrays built earlier instead of the own ones
+    void UseTables(const Tables& tables);
+
+    // changes whenever the index is built or given other tables, for caches of its suggestions
+    uint64_t Version() const { return version; }
+
+    size_t Size() const { return View().wordCount; }
+    bool Empty() const { return Size() == 0; }
+
+    bool Contains(std::string_view word) const;
+
+    // the correction of word within maxDistance edits (at most MAX_EDIT_DISTANCE), empty if
+    // word is listed, is not valid UTF-8 or too long, or no listed word is that close
+    std::string_view Suggest(std::string_view word, size_t maxDistance = MAX_EDIT_DISTANCE) const;
+
+private:
+    // the own arrays or the ones given to UseTables
+    Tables View() const;
+
+    // the entries under the delete with hash, calls found(word) for each
+    template <typename Found>
+    static void Probe(const Tables& tables, uint64_t hash, Found found);
+
+    std::vector<uint32_t> wordOffsets = std::vector<uint32_t>(1, 0);
+    std::string wordBytes;
+    std::vector<uint64_t> frequencies;
+    std::vector<uint32_t> bucketStarts;
+    std::vector<Entry> entries;
+
+    bool external = false; // set by UseTables
+    Tables externalTables;
+    uint64_t version = 0;
+};
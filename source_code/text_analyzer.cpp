@@ -0,0 +1,15 @@
+#include "text_analyzer.h"
+
+AnalysisResult TextAnalyzer::Analyze(std::string_view text) const
+{
+    AnalysisResult result;
+    result.text.assign(text.data(), text.size());
+    if (diagnosticsLimit > 0)
+        result.diagnostics = AnalysisDiagnostics(diagnosticsLimit);
+
+    AnalysisState state;
+    AnalyzePiece(result.text, settings, rules, state, nullptr, diagnosticsLimit > 0 ? &result.diagnostics : nullptr);
+    result.changed = result.text != text;
+    result.report = FinishAnalysis(state);
+    return result;
+}
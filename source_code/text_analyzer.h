@@ -0,0 +1,42 @@
+#pragma once
+
+#include "analysis_diagnostics.h"
+#include "analyzer.h"
+
+#include <string>
+#include <string_view>
+
+// everything one analysis of a text produces, owned by the caller
+struct AnalysisResult
+{
+    std::string text; // the corrected text
+    bool changed = false;
+    AnalysisReport report;
+    AnalysisDiagnostics diagnostics{ 0 }; // the fixes, only kept up to the diagnostics limit
+};
+
+// the entry point for code that analyzes whole texts, e.g. a service answering requests
+// from many threads: the settings and rules are fixed when it is made, Analyze keeps its
+// state on the caller's stack and returns everything by value, so any number of threads
+// can share one analyzer (and one RulePack) without locks
+class TextAnalyzer
+{
+public:
+    // rules must outlive the analyzer (the packs of RulePackFor live as long as the process)
+    // with diagnosticsLimit 0 no fixes are recorded, only counted in the report, and the
+    // stages run fused (see RunFusedStages)
+    explicit TextAnalyzer(const AnalysisSettings& settings, const RulePack& rules = DefaultRulePack(), size_t diagnosticsLimit = 0)
+        : settings(settings), rules(rules), diagnosticsLimit(diagnosticsLimit)
+    {
+    }
+
+    AnalysisResult Analyze(std::string_view text) const;
+
+    const AnalysisSettings& Settings() const { return settings; }
+    const RulePack& Rules() const { return rules; }
+
+private:
+    const AnalysisSettings settings;
+    const RulePack& rules;
+    const size_t diagnosticsLimit;
+};
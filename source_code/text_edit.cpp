@@ -0,0 +1,172 @@
+#include "text_edit.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // bytes that must match after a difference before the texts count as in step again
+    const size_t SYNC_LENGTH = 4;
+
+    // how many bytes of both texts together a difference may span
+    const size_t MAX_DIFFERENCE = 64;
+
+    // a difference may also remove or insert up to this many bytes (a collapsed whitespace
+    // run, a joined paragraph) while the other text changes by at most SHORT_SIDE bytes
+    const size_t MAX_ONE_SIDED = 4096;
+    const size_t SHORT_SIDE = 2;
+
+    // bytes replaced on both sides when no way back in step is found, the search starts
+    // again after them
+    const size_t BLOCK_LENGTH = 64;
+
+    // true if before at i and after at j continue with SYNC_LENGTH equal bytes, or with
+    // equal bytes up to the end of both
+    bool InStep(const std::string& before, size_t i, const std::string& after, size_t j)
+    {
+        if (i > before.size() || j > after.size())
+            return false;
+        size_t left = std::min(before.size() - i, after.size() - j);
+        size_t length = std::min(left, SYNC_LENGTH);
+        if (length < SYNC_LENGTH && before.size() - i != after.size() - j)
+            return false;
+        return std::memcmp(before.data() + i, after.data() + j, length) == 0;
+    }
+
+    // finds how many bytes of before at i and after at j to replace to get in step again,
+    // the shortest difference first, then long one-sided ones
+    bool FindStep(const std::string& before, size_t i, const std::string& after, size_t j, size_t& removed, size_t& inserted)
+    {
+        for (size_t span = 1; span <= MAX_DIFFERENCE; ++span)
+        {
+            for (removed = 0; removed <= span; ++removed)
+            {
+                inserted = span - removed;
+                if (InStep(before, i + removed, after, j + inserted))
+                    return true;
+            }
+        }
+        for (size_t length = MAX_DIFFERENCE / 2; length <= MAX_ONE_SIDED; ++length)
+        {
+            for (size_t other = 0; other <= SHORT_SIDE; ++other)
+            {
+                removed = length;
+                inserted = other;
+                if (InStep(before, i + removed, after, j + inserted))
+                    return true;
+                removed = other;
+                inserted = length;
+                if (InStep(before, i + removed, after, j + inserted))
+                    return true;
+            }
+        }
+        return false;
+    }
+}
+
+std::vector<TextEdit> DiffText(const std::string& before, const std::string& after)
+{
+    std::vector<TextEdit> edits;
+    size_t i = 0;
+    size_t j = 0;
+
+    // adds a difference, joined to the previous one when nothing equal lies between them
+    auto addEdit = [&](size_t removed, size_t inserted)
+    {
+        if (!edits.empty() && edits.back().offset + edits.back().removed.size() == i)
+        {
+            edits.back().removed.append(before, i, removed);
+            edits.back().inserted.append(after, j, inserted);
+        }
+        else
+        {
+            edits.push_back(TextEdit{ i, before.substr(i, removed), after.substr(j, inserted) });
+        }
+        i += removed;
+        j += inserted;
+    };
+
+    while (true)
+    {
+        while (i < before.size() && j < after.size() && before[i] == after[j])
+        {
+            ++i;
+            ++j;
+        }
+        if (i == before.size() && j == after.size())
+            break;
+
+        size_t removed;
+        size_t inserted;
+        if (FindStep(before, i, after, j, removed, inserted))
+        {
+            addEdit(removed, inserted);
+        }
+        else if (before.size() - i <= BLOCK_LENGTH || after.size() - j <= BLOCK_LENGTH)
+        {
+            // near the end of one text, the rest up to the common suffix
+            size_t suffix = 0;
+            while (suffix < before.size() - i && suffix < after.size() - j && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix])
+                ++suffix;
+            addEdit(before.size() - i - suffix, after.size() - j - suffix);
+        }
+        else
+        {
+            addEdit(BLOCK_LENGTH, BLOCK_LENGTH);
+        }
+    }
+    return edits;
+}
+
+void ApplyEdits(std::string& text, const std::vector<TextEdit>& edits)
+{
+    if (edits.empty())
+        return;
+
+    size_t size = text.size();
+    for (const TextEdit& edit : edits)
+        size = size - edit.removed.size() + edit.inserted.size();
+
+    std::string result;
+    result.reserve(size);
+    size_t position = 0;
+    for (const TextEdit& edit : edits)
+    {
+        result.append(text, position, edit.offset - position);
+        result += edit.inserted;
+        position = edit.offset + edit.removed.size();
+    }
+    result.append(text, position, std::string::npos);
+    text.swap(result);
+}
+
+void MapOffsetsThroughEdits(const std::vector<TextEdit>& edits, std::vector<uint64_t>& offsets)
+{
+    // one pass over the edits with the offsets in ascending order
+    std::vector<size_t> order(offsets.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&offsets](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+    size_t next = 0;   // first edit not entirely before the current offset
+    int64_t shift = 0; // size change of the edits before it
+    for (size_t index : order)
+    {
+        uint64_t& offset = offsets[index];
+        // an insertion right at offset counts as after it, so offset points at the inserted text
+        while (next < edits.size() && edits[next].offset + edits[next].removed.size() <= offset
+               && !(edits[next].removed.empty() && edits[next].offset == offset))
+        {
+            shift += static_cast<int64_t>(edits[next].inserted.size()) - static_cast<int64_t>(edits[next].removed.size());
+            ++next;
+        }
+        // inside a removed range the distance into it is scaled to the inserted text, the
+        // differences of a long edit are spread over it
+        if (next < edits.size() && edits[next].offset < offset)
+        {
+            const TextEdit& edit = edits[next];
+            offset = edit.offset + (offset - edit.offset) * edit.inserted.size() / edit.removed.size();
+        }
+        offset = static_cast<uint64_t>(static_cast<int64_t>(offset) + shift);
+    }
+}
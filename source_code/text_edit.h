@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one replacement in a text, offset is in bytes of the text the edit is applied to
+struct TextEdit
+{
+    size_t offset;
+    std::string removed;
+    std::string inserted;
+};
+
+// edits turning before into after, in ascending order with offsets in before
+// the texts are compared in one pass that resynchronizes after each difference, so the
+// small scattered changes of an analysis give one small edit each; differences it cannot
+// resynchronize end in a single edit covering the rest up to the common suffix
+std::vector<TextEdit> DiffText(const std::string& before, const std::string& after);
+
+// applies ascending, non-overlapping edits with offsets in text
+void ApplyEdits(std::string& text, const std::vector<TextEdit>& edits);
+
+// moves offsets in the text before ascending, non-overlapping edits (in any order) to the
+// same places in the text after them, an offset inside a removed range goes to the same
+// share of the inserted text
+void MapOffsetsThroughEdits(const std::vector<TextEdit>& edits, std::vector<uint64_t>& offsets);
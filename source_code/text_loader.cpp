@@ -0,0 +1,135 @@
+#include "text_loader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    // bytes validated between two progress calls
+    const size_t LOAD_CHUNK_SIZE = 4 << 20;
+
+    const char REPLACEMENT_CHARACTER[] = "\xEF\xBF\xBD";
+
+    // length of the valid UTF-8 sequence starting at text[i], 0 if there is none
+    size_t SequenceLength(const unsigned char* text, size_t i, size_t size)
+    {
+        unsigned char lead = text[i];
+        size_t length;
+        unsigned char low = 0x80; // allowed range of the second byte, narrower after some leads
+        unsigned char high = 0xBF;
+        if (lead < 0x80)
+            return 1;
+        else if (lead >= 0xC2 && lead <= 0xDF)
+            length = 2;
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            if (lead == 0xE0)
+                low = 0xA0; // overlong
+            else if (lead == 0xED)
+                high = 0x9F; // surrogates
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            if (lead == 0xF0)
+                low = 0x90; // overlong
+            else if (lead == 0xF4)
+                high = 0x8F; // above U+10FFFF
+        }
+        else
+            return 0;
+
+        if (i + length > size || text[i + 1] < low || text[i + 1] > high)
+            return 0;
+        for (size_t k = 2; k < length; ++k)
+        {
+            if ((text[i + k] & 0xC0) != 0x80)
+                return 0;
+        }
+        return length;
+    }
+
+    // end of the ASCII run starting at i, checked eight bytes at a time
+    size_t SkipAscii(const unsigned char* text, size_t i, size_t size)
+    {
+        while (i + 8 <= size)
+        {
+            uint64_t word;
+            std::memcpy(&word, text + i, 8);
+            if (word & 0x8080808080808080ull)
+                break;
+            i += 8;
+        }
+        while (i < size && text[i] < 0x80) ++i;
+        return i;
+    }
+
+    // decodes input[from, to) into output, a sequence starting before to may end after it
+    // returns where decoding stopped (at or after to) and adds the bytes replaced to replaced
+    size_t DecodeRange(std::string_view input, size_t from, size_t to, std::string& output, size_t& replaced)
+    {
+        const unsigned char* text = reinterpret_cast<const unsigned char*>(input.data());
+        size_t i = from;
+        size_t copiedUpTo = from;
+        while (i < to)
+        {
+            i = SkipAscii(text, i, to);
+            if (i >= to)
+                break;
+            size_t length = SequenceLength(text, i, input.size());
+            if (length > 0)
+            {
+                i += length;
+                continue;
+            }
+            // valid text is copied in runs, only the invalid byte is replaced
+            output.append(input.data() + copiedUpTo, i - copiedUpTo);
+            output += REPLACEMENT_CHARACTER;
+            ++replaced;
+            ++i;
+            copiedUpTo = i;
+        }
+        output.append(input.data() + copiedUpTo, i - copiedUpTo);
+        return i;
+    }
+}
+
+size_t DecodeUtf8(std::string_view input, std::string& output)
+{
+    size_t replaced = 0;
+    DecodeRange(input, 0, input.size(), output, replaced);
+    return replaced;
+}
+
+bool LoadTextFile(const std::string& path, LoadedText& loaded, const std::function<bool(size_t, size_t)>& progress)
+{
+    loaded.text.clear();
+    loaded.replacedBytes = 0;
+
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        // an empty file maps to nothing but is still a text
+        std::ifstream empty(path, std::ios::in | std::ios::binary | std::ios::ate);
+        return empty.is_open() && empty.tellg() == 0 && progress(0, 0);
+    }
+
+    std::string_view input(file.Data(), file.Size());
+    loaded.text.reserve(input.size());
+    size_t done = 0;
+    while (done < input.size())
+    {
+        size_t chunkEnd = std::min(input.size(), done + LOAD_CHUNK_SIZE);
+        done = DecodeRange(input, done, chunkEnd, loaded.text, loaded.replacedBytes);
+        if (!progress(done, input.size()))
+        {
+            loaded.text.clear();
+            return false;
+        }
+    }
+    return true;
+}
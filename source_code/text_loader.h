@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// appends input to output as valid UTF-8, each byte that does not start or continue a valid
+// sequence (overlong forms, surrogates and code points above U+10FFFF included) is replaced
+// by U+FFFD; NUL bytes are kept
+// returns the number of bytes replaced
+size_t DecodeUtf8(std::string_view input, std::string& output);
+
+// a text file read by LoadTextFile
+struct LoadedText
+{
+    std::string text;        // valid UTF-8
+    size_t replacedBytes = 0; // invalid bytes of the file replaced by U+FFFD
+};
+
+// reads a whole file through a memory mapping, validating it as UTF-8 in chunks and calling
+// progress(bytesDone, bytesTotal) after each; the file is read once and copied once
+// returns false if the file could not be opened or progress returned false
+bool LoadTextFile(const std::string& path, LoadedText& loaded, const std::function<bool(size_t, size_t)>& progress);
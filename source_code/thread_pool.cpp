@@ -0,0 +1,113 @@
+#include "thread_pool.h"
+
+namespace
+{
+    // pool and queue index of the worker running on this thread
+    thread_local const WorkStealingPool* currentPool = nullptr;
+    thread_local unsigned currentWorker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    for (unsigned i = 0; i < threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void WorkStealingPool::Submit(std::function<void()> task)
+{
+    unsigned index = (currentPool == this)
+        ? currentWorker
+        : static_cast<unsigned>(nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+
+    pending.fetch_add(1);
+    {
+        // taking the lock makes sure a worker about to sleep sees the new task
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    workAvailable.notify_one();
+}
+
+void WorkStealingPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this] { return pending.load() == 0; });
+}
+
+bool WorkStealingPool::TryPop(unsigned index, std::function<void()>& task)
+{
+    Queue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::TrySteal(unsigned thief, std::function<void()>& task)
+{
+    for (size_t offset = 1; offset < queues.size(); ++offset)
+    {
+        Queue& queue = *queues[(thief + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(unsigned index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    std::function<void()> task;
+    while (true)
+    {
+        if (TryPop(index, task) || TrySteal(index, task))
+        {
+            queued.fetch_sub(1);
+            task();
+            task = nullptr;
+
+            if (pending.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0)
+            return;
+    }
+}
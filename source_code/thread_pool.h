@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// thread pool with one task queue per worker
+// a worker takes its newest own task first and steals the oldest task of another
+// worker when its queue runs dry, so uneven tasks (small and huge files) balance out
+class WorkStealingPool
+{
+public:
+    // threads == 0 uses one worker per hardware thread
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // queues a task, tasks submitted from a worker go to that worker's own queue
+    void Submit(std::function<void()> task);
+
+    // blocks until every submitted task has finished
+    void Wait();
+
+    unsigned Size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void WorkerLoop(unsigned index);
+    bool TryPop(unsigned index, std::function<void()>& task);
+    bool TrySteal(unsigned thief, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    std::atomic<size_t> queued{ 0 };  // tasks waiting in queues
+    std::atomic<size_t> pending{ 0 }; // tasks submitted but not finished
+    std::atomic<size_t> nextQueue{ 0 };
+    bool stopping = false;
+};
@@ -0,0 +1,473 @@
+// benchmark of the analysis passes on generated text, does not use wxWidgets
+//
+// usage: trace_bench [options]
+// every stage is measured alone and the whole pipeline with all 16 flag combinations, for
+// each corpus kind and size; results go to stdout and optionally to a JSON report so runs
+// of different releases can be compared
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "analyzer.h"
+#include "char_classes.h"
+#include "corpus_generator.h"
+#include "parallel_analysis.h"
+#include "scan_kernels.h"
+#include "thread_pool.h"
+
+namespace
+{
+    // corpora are analyzed in pieces of about this size so a 1 GB run needs no 1 GB copies
+    const size_t PIECE_SIZE = 16u << 20;
+
+    // corpora above this size need only one repetition
+    const size_t LARGE_CORPUS = 64u << 20;
+    const int MIN_REPETITIONS = 3;
+    const int MAX_REPETITIONS = 1000;
+
+    struct Options
+    {
+        std::vector<CorpusKind> corpora;
+        std::vector<size_t> sizes;
+        double minTime = 0.1;
+        uint64_t seed = 1;
+        bool stages = true;
+        bool pipelines = true;
+        ScanLevel scanLevel = SupportedScanLevel();
+        unsigned threads = 0; // workers of the parallel runs, 0 measures none
+        std::string dictionaryPath;
+        std::string reportPath;
+    };
+
+    struct RunResult
+    {
+        std::string corpus;
+        size_t bytes = 0;
+        std::string run;
+        std::vector<double> seconds; // one per repetition
+        uint64_t allocations = 0;
+    };
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "usage: trace_bench [options]\n"
+            "\n"
+            "  -c, --corpus LIST        comma separated corpus kinds: prose, code, diacritics,\n"
+            "                           whitespace (default all)\n"
+            "  -s, --sizes LIST         comma separated sizes with K, M or G suffix, from 1K to 1G\n"
+            "                           (default 1K,64K,1M)\n"
+            "  -t, --min-time SECONDS   minimum time spent on each measurement (default 0.1)\n"
+            "      --seed N             corpus generator seed (default 1)\n"
+            "      --stages-only        measure only the single stages\n"
+            "      --pipeline-only      measure only the 16 flag combinations\n"
+            "      --scan LEVEL         scanning kernels: scalar, sse2 or avx2 (default the best\n"
+            "                           the CPU supports)\n"
+            "  -j, --threads N          also measure csp- and cspk split over N worker threads\n"
+            "                           (parallel:csp-, parallel:cspk)\n"
+            "  -d, --dictionary PATH    typo dictionary used instead of the one of the English\n"
+            "                           rule pack (" << RULE_PACK_DIRECTORY << "/en.pack)\n"
+            "  -r, --report PATH        write a JSON report to PATH (- for stdout)\n";
+    }
+
+    std::vector<std::string> SplitList(const std::string& list)
+    {
+        std::vector<std::string> items;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    bool ParseSize(const std::string& text, size_t& size)
+    {
+        char* end = nullptr;
+        unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+        if (end == text.c_str())
+            return false;
+        std::string suffix = end;
+        if (suffix == "K" || suffix == "k") value <<= 10;
+        else if (suffix == "M" || suffix == "m") value <<= 20;
+        else if (suffix == "G" || suffix == "g") value <<= 30;
+        else if (!suffix.empty()) return false;
+        size = static_cast<size_t>(value);
+        return size > 0;
+    }
+
+    // returns false on a usage error
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](std::string& out)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                out = argv[++i];
+                return true;
+            };
+
+            std::string text;
+            if (arg == "-c" || arg == "--corpus")
+            {
+                if (!value(text))
+                    return false;
+                for (const std::string& name : SplitList(text))
+                {
+                    CorpusKind kind;
+                    if (!ParseCorpusKind(name, kind))
+                        return false;
+                    options.corpora.push_back(kind);
+                }
+            }
+            else if (arg == "-s" || arg == "--sizes")
+            {
+                if (!value(text))
+                    return false;
+                for (const std::string& item : SplitList(text))
+                {
+                    size_t size;
+                    if (!ParseSize(item, size))
+                        return false;
+                    options.sizes.push_back(size);
+                }
+            }
+            else if (arg == "-t" || arg == "--min-time")
+            {
+                if (!value(text))
+                    return false;
+                options.minTime = std::strtod(text.c_str(), nullptr);
+            }
+            else if (arg == "--seed")
+            {
+                if (!value(text))
+                    return false;
+                options.seed = std::strtoull(text.c_str(), nullptr, 10);
+            }
+            else if (arg == "--stages-only") options.pipelines = false;
+            else if (arg == "--pipeline-only") options.stages = false;
+            else if (arg == "--scan")
+            {
+                if (!value(text))
+                    return false;
+                if (text == "scalar") options.scanLevel = ScanLevel::SCALAR;
+                else if (text == "sse2") options.scanLevel = ScanLevel::SSE2;
+                else if (text == "avx2") options.scanLevel = ScanLevel::AVX2;
+                else return false;
+            }
+            else if (arg == "-j" || arg == "--threads")
+            {
+                if (!value(text))
+                    return false;
+                options.threads = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10));
+            }
+            else if (arg == "-d" || arg == "--dictionary")
+            {
+                if (!value(options.dictionaryPath))
+                    return false;
+            }
+            else if (arg == "-r" || arg == "--report")
+            {
+                if (!value(options.reportPath))
+                    return false;
+            }
+            else
+            {
+                if (arg != "-h" && arg != "--help")
+                    std::cerr << "unknown option: " << arg << "\n";
+                return false;
+            }
+        }
+
+        if (options.corpora.empty())
+        {
+            for (int k = 0; k < static_cast<int>(CorpusKind::COUNT); ++k)
+                options.corpora.push_back(static_cast<CorpusKind>(k));
+        }
+        if (options.sizes.empty())
+            options.sizes = { 1u << 10, 64u << 10, 1u << 20 };
+        return options.stages || options.pipelines;
+    }
+
+    // piece boundaries of a corpus, cut before a word that follows whitespace like
+    // StreamAnalyzer does, so analyzing the pieces in order matches the whole text
+    std::vector<size_t> FindPieceEnds(const std::string& corpus)
+    {
+        std::vector<size_t> ends;
+        size_t start = 0;
+        while (corpus.size() - start > PIECE_SIZE)
+        {
+            size_t k = start + PIECE_SIZE;
+            while (k < corpus.size() && !(IsSpacingWhitespace(corpus[k - 1]) && !IsSpacingWhitespace(corpus[k])
+                                          && std::strchr(SPACING_PUNCTUATION, corpus[k]) == nullptr))
+                ++k;
+            if (k >= corpus.size())
+                break;
+            ends.push_back(k);
+            start = k;
+        }
+        ends.push_back(corpus.size());
+        return ends;
+    }
+
+    // runs analyze over the corpus pieces until minTime is spent, only the analysis is timed
+    RunResult Measure(const std::string& corpus, const std::vector<size_t>& pieceEnds, double minTime,
+                      const std::function<void(std::string&, AnalysisState&)>& analyze)
+    {
+        RunResult result;
+        result.bytes = corpus.size();
+        const int minRepetitions = corpus.size() > LARGE_CORPUS ? 1 : MIN_REPETITIONS;
+
+        std::string piece;
+        double total = 0.0;
+        while (static_cast<int>(result.seconds.size()) < MAX_REPETITIONS
+               && (total < minTime || static_cast<int>(result.seconds.size()) < minRepetitions))
+        {
+            AnalysisState state;
+            double seconds = 0.0;
+            size_t start = 0;
+            for (size_t end : pieceEnds)
+            {
+                piece.assign(corpus, start, end - start);
+                start = end;
+
+                uint64_t allocationsBefore = ThreadAllocationCount();
+                auto begin = std::chrono::steady_clock::now();
+                analyze(piece, state);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+                result.allocations += ThreadAllocationCount() - allocationsBefore;
+                seconds += elapsed.count();
+            }
+            result.seconds.push_back(seconds);
+            total += seconds;
+        }
+        return result;
+    }
+
+    std::string FlagsName(const AnalysisSettings& settings)
+    {
+        std::string name = "flags:";
+        name += settings.capitalizeFirstLetter ? 'c' : '-';
+        name += settings.fixSpacing ? 's' : '-';
+        name += settings.capitalizeAfterPeriod ? 'p' : '-';
+        name += settings.codingTerms ? 'k' : '-';
+        return name;
+    }
+
+    // settings that enable a stage, the others stay off
+    AnalysisSettings SettingsForStage(AnalysisStage stage)
+    {
+        AnalysisSettings settings;
+        settings.capitalizeFirstLetter = stage == AnalysisStage::FIRST_LETTER || stage == AnalysisStage::SENTENCE_CASE;
+        settings.fixSpacing = stage == AnalysisStage::SPACING;
+        settings.capitalizeAfterPeriod = stage == AnalysisStage::AFTER_PERIOD;
+        settings.suggestSpelling = stage == AnalysisStage::SPELLING;
+        return settings;
+    }
+
+    // nearest rank percentile of sorted samples
+    double Percentile(const std::vector<double>& sorted, double percent)
+    {
+        size_t rank = static_cast<size_t>(percent / 100.0 * sorted.size() + 0.999999);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    struct Summary
+    {
+        double mbPerSecond = 0.0;
+        double allocationsPerMb = 0.0;
+        double p50 = 0.0, p90 = 0.0, p99 = 0.0; // milliseconds
+    };
+
+    Summary Summarize(const RunResult& result)
+    {
+        Summary summary;
+        std::vector<double> sorted = result.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double seconds : sorted)
+            total += seconds;
+        double megabytes = result.bytes / 1e6 * sorted.size();
+        summary.mbPerSecond = total > 0 ? megabytes / total : 0.0;
+        summary.allocationsPerMb = megabytes > 0 ? result.allocations / megabytes : 0.0;
+        summary.p50 = Percentile(sorted, 50) * 1e3;
+        summary.p90 = Percentile(sorted, 90) * 1e3;
+        summary.p99 = Percentile(sorted, 99) * 1e3;
+        return summary;
+    }
+
+    std::string FormatSize(size_t bytes)
+    {
+        char buffer[32];
+        if (bytes >= (1u << 30) && bytes % (1u << 30) == 0) std::snprintf(buffer, sizeof(buffer), "%zuG", bytes >> 30);
+        else if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) std::snprintf(buffer, sizeof(buffer), "%zuM", bytes >> 20);
+        else if (bytes >= (1u << 10) && bytes % (1u << 10) == 0) std::snprintf(buffer, sizeof(buffer), "%zuK", bytes >> 10);
+        else std::snprintf(buffer, sizeof(buffer), "%zu", bytes);
+        return buffer;
+    }
+
+    void PrintResult(const RunResult& result)
+    {
+        Summary summary = Summarize(result);
+        std::printf("%-11s %6s  %-20s %5zu %10.2f %10.1f %10.4f %10.4f %10.4f\n",
+                    result.corpus.c_str(), FormatSize(result.bytes).c_str(), result.run.c_str(), result.seconds.size(),
+                    summary.mbPerSecond, summary.allocationsPerMb, summary.p50, summary.p90, summary.p99);
+        std::fflush(stdout);
+    }
+
+    void WriteReport(std::ostream& out, const Options& options, const std::vector<RunResult>& results)
+    {
+        out << "{\n";
+        out << "  \"settings\": {\"seed\": " << options.seed << ", \"min_time\": " << options.minTime
+            << ", \"piece_size\": " << PIECE_SIZE << ", \"scan\": \"" << ScanLevelName(CurrentScanLevel()) << "\""
+            << ", \"threads\": " << options.threads << "},\n";
+        out << "  \"runs\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const RunResult& result = results[i];
+            Summary summary = Summarize(result);
+            out << "    {\"corpus\": \"" << result.corpus << "\", \"bytes\": " << result.bytes
+                << ", \"run\": \"" << result.run << "\", \"repetitions\": " << result.seconds.size()
+                << ", \"mb_per_second\": " << summary.mbPerSecond
+                << ", \"allocations_per_mb\": " << summary.allocationsPerMb
+                << ", \"p50_ms\": " << summary.p50 << ", \"p90_ms\": " << summary.p90 << ", \"p99_ms\": " << summary.p99
+                << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    RulePack customRules;
+    const RulePack* rules = &DefaultRulePack();
+    if (!options.dictionaryPath.empty())
+    {
+        if (!customRules.BuildFromSources(Language::ENGLISH, RULE_PACK_DIRECTORY, options.dictionaryPath))
+        {
+            std::cerr << "could not open dictionary " << options.dictionaryPath << "\n";
+            return 2;
+        }
+        rules = &customRules;
+    }
+
+    SetScanLevel(options.scanLevel);
+    std::printf("scanning kernels: %s\n", ScanLevelName(CurrentScanLevel()));
+    std::printf("%-11s %6s  %-20s %5s %10s %10s %10s %10s %10s\n",
+                "corpus", "size", "run", "reps", "MB/s", "allocs/MB", "p50 ms", "p90 ms", "p99 ms");
+
+    std::unique_ptr<WorkStealingPool> pool;
+    if (options.threads > 0)
+        pool.reset(new WorkStealingPool(options.threads));
+
+    std::vector<RunResult> results;
+    for (CorpusKind kind : options.corpora)
+    {
+        for (size_t size : options.sizes)
+        {
+            const std::string corpus = GenerateCorpus(kind, size, options.seed);
+            const std::vector<size_t> pieceEnds = FindPieceEnds(corpus);
+
+            // each stage alone, with the settings it needs
+            for (int s = 0; options.stages && s < static_cast<int>(AnalysisStage::COUNT); ++s)
+            {
+                AnalysisStage stage = static_cast<AnalysisStage>(s);
+                AnalysisSettings settings = SettingsForStage(stage);
+                RunResult result = Measure(corpus, pieceEnds, options.minTime, [&](std::string& piece, AnalysisState& state)
+                {
+                    RunStage(stage, piece, settings, *rules, state);
+                });
+                result.corpus = CorpusName(kind);
+                result.run = std::string("stage:") + StageName(stage);
+                PrintResult(result);
+                results.push_back(std::move(result));
+            }
+
+            // the prose and code split done before the stages when coding terms are ignored
+            if (options.stages)
+            {
+                RunResult result = Measure(corpus, pieceEnds, options.minTime, [](std::string& piece, AnalysisState& state)
+                {
+                    ClassifyBlocks(piece, state.blocks);
+                });
+                result.corpus = CorpusName(kind);
+                result.run = "classify";
+                PrintResult(result);
+                results.push_back(std::move(result));
+            }
+
+            // the whole pipeline with every combination of flags
+            for (int flags = 0; options.pipelines && flags < 16; ++flags)
+            {
+                AnalysisSettings settings{ (flags & 1) != 0, (flags & 2) != 0, (flags & 4) != 0, (flags & 8) != 0 };
+                RunResult result = Measure(corpus, pieceEnds, options.minTime, [&](std::string& piece, AnalysisState& state)
+                {
+                    AnalyzePiece(piece, settings, *rules, state);
+                });
+                result.corpus = CorpusName(kind);
+                result.run = FlagsName(settings);
+                PrintResult(result);
+                results.push_back(std::move(result));
+            }
+
+            // every pass on, each piece split over the workers (allocations of the workers
+            // are not counted)
+            for (int codingTerms = 0; pool && options.pipelines && codingTerms < 2; ++codingTerms)
+            {
+                AnalysisSettings settings{ true, true, true, codingTerms != 0 };
+                RunResult result = Measure(corpus, pieceEnds, options.minTime, [&](std::string& piece, AnalysisState& state)
+                {
+                    AnalyzeParallel(piece, settings, *rules, state, *pool);
+                });
+                result.corpus = CorpusName(kind);
+                result.run = "parallel:" + FlagsName(settings).substr(6);
+                PrintResult(result);
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    if (!options.reportPath.empty())
+    {
+        if (options.reportPath == "-")
+        {
+            WriteReport(std::cout, options, results);
+        }
+        else
+        {
+            std::ofstream report(options.reportPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!report.is_open())
+            {
+                std::cerr << "could not write report " << options.reportPath << "\n";
+                return 1;
+            }
+            WriteReport(report, options, results);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,655 @@
+// command line version of TRACE for batch analysis, does not use wxWidgets
+//
+// usage: trace_cli [options] <file|directory|->...
+// directories are searched recursively for .txt files, "-" reads stdin and writes the
+// corrected text to stdout
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analysis_diagnostics.h"
+#include "analysis_metrics.h"
+#include "analyzer.h"
+#include "atomic_file.h"
+#include "parallel_analysis.h"
+#include "result_cache.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // files at least this big are analyzed as a stream unless --parallel is given
+    const uint64_t STREAM_THRESHOLD = 64ull << 20;
+
+    struct Options
+    {
+        bool capitalizeFirstLetter = false;
+        bool fixSpacing = false;
+        bool capitalizeAfterPeriod = false;
+        bool codingTerms = false;
+        bool suggestSpelling = false;
+        Language language = Language::ENGLISH;
+        std::string dictionaryPath;
+        std::string outputDir;
+        std::string reportPath;
+        std::string metricsPath;
+        std::string tracePath;
+        std::string cachePath;
+        uint64_t cacheBytes = ResultCache::DEFAULT_CAPACITY;
+        bool inPlace = false;
+        bool stream = false;
+        bool parallel = false; // one file at a time, split over all workers
+        unsigned jobs = 0;
+        size_t diagnosticsLimit = 0; // fixes listed per file in the report, 0 lists none
+        std::vector<std::string> inputs;
+    };
+
+    // one input file, inputRoot is the directory argument it was found under (empty for files)
+    struct InputFile
+    {
+        fs::path path;
+        fs::path inputRoot;
+    };
+
+    struct FileResult
+    {
+        uint64_t bytes = 0;
+        bool changed = false;
+        float likeness = 1.0f;
+        std::map<std::string, size_t> messages; // message -> how many times it was reported
+        std::shared_ptr<AnalysisDiagnostics> diagnostics; // null unless fixes are listed
+        std::string error;
+    };
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "usage: trace_cli [options] <file|directory|->...\n"
+            "\n"
+            "  -c, --capitalize         capitalize the first letter and sentence starts\n"
+            "  -s, --spacing            fix spacing around punctuation\n"
+            "  -p, --after-period       capitalize after period\n"
+            "  -k, --coding-terms       ignore coding terms and leave code blocks as they are\n"
+            "  -S, --spelling           replace lower-case words missing from the language's word\n"
+            "                           list by the closest listed word (needs words_LANG.txt)\n"
+            "  -l, --language LANG      rules and report language: en, es, fr or pl (default en)\n"
+            "  -d, --dictionary PATH    typo dictionary used instead of the one of the language's\n"
+            "                           rule pack (" << RULE_PACK_DIRECTORY << "/LANG.pack)\n"
+            "  -o, --output-dir DIR     write corrected files under DIR\n"
+            "  -i, --in-place           overwrite the input files with the corrected text\n"
+            "  -r, --report PATH        write a JSON report to PATH (- for stdout)\n"
+            "  -m, --metrics PATH       write per stage timings, bytes, fixes and allocations\n"
+            "                           as JSON to PATH (- for stderr)\n"
+            "      --trace PATH         write every stage run in Chrome trace format to PATH\n"
+            "  -D, --diagnostics N      list up to N fixes of each file in the report, with\n"
+            "                           rule, input offset, length and replacement\n"
+            "  -j, --jobs N             number of worker threads (default: all cores)\n"
+            "      --stream             analyze every file in bounded memory (always done for\n"
+            "                           stdin and files of 64 MB or more)\n"
+            "  -P, --parallel           analyze one file at a time, each split over all workers\n"
+            "                           (files of any size are read whole unless --stream)\n"
+            "      --cache PATH         take the paragraphs analyzed by earlier runs from the\n"
+            "                           result cache at PATH and add the new ones (not used for\n"
+            "                           files split by --parallel or while collecting metrics)\n"
+            "      --cache-mb N         size of the cache file (default 64)\n"
+            "\n"
+            "directories are searched recursively for .txt files, - reads stdin and\n"
+            "writes the corrected text to stdout\n";
+    }
+
+    // returns false on a usage error
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](std::string& out)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                out = argv[++i];
+                return true;
+            };
+
+            std::string text;
+            if (arg == "-c" || arg == "--capitalize") options.capitalizeFirstLetter = true;
+            else if (arg == "-s" || arg == "--spacing") options.fixSpacing = true;
+            else if (arg == "-p" || arg == "--after-period") options.capitalizeAfterPeriod = true;
+            else if (arg == "-k" || arg == "--coding-terms") options.codingTerms = true;
+            else if (arg == "-S" || arg == "--spelling") options.suggestSpelling = true;
+            else if (arg == "-i" || arg == "--in-place") options.inPlace = true;
+            else if (arg == "--stream") options.stream = true;
+            else if (arg == "-P" || arg == "--parallel") options.parallel = true;
+            else if (arg == "-l" || arg == "--language")
+            {
+                if (!value(text) || !ParseLanguageCode(text, options.language))
+                    return false;
+            }
+            else if (arg == "-d" || arg == "--dictionary")
+            {
+                if (!value(options.dictionaryPath))
+                    return false;
+            }
+            else if (arg == "-o" || arg == "--output-dir")
+            {
+                if (!value(options.outputDir))
+                    return false;
+            }
+            else if (arg == "-r" || arg == "--report")
+            {
+                if (!value(options.reportPath))
+                    return false;
+            }
+            else if (arg == "-m" || arg == "--metrics")
+            {
+                if (!value(options.metricsPath))
+                    return false;
+            }
+            else if (arg == "--trace")
+            {
+                if (!value(options.tracePath))
+                    return false;
+            }
+            else if (arg == "--cache")
+            {
+                if (!value(options.cachePath))
+                    return false;
+            }
+            else if (arg == "--cache-mb")
+            {
+                if (!value(text))
+                    return false;
+                options.cacheBytes = std::strtoull(text.c_str(), nullptr, 10) << 20;
+            }
+            else if (arg == "-D" || arg == "--diagnostics")
+            {
+                if (!value(text))
+                    return false;
+                options.diagnosticsLimit = static_cast<size_t>(std::strtoul(text.c_str(), nullptr, 10));
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                if (!value(text))
+                    return false;
+                options.jobs = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10));
+            }
+            else if (arg == "-h" || arg == "--help")
+            {
+                return false;
+            }
+            else if (arg.size() > 1 && arg[0] == '-')
+            {
+                std::cerr << "unknown option: " << arg << "\n";
+                return false;
+            }
+            else
+            {
+                options.inputs.push_back(arg);
+            }
+        }
+        return !options.inputs.empty() && !(options.inPlace && !options.outputDir.empty());
+    }
+
+    bool IsTextFile(const fs::path& path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension == ".txt";
+    }
+
+    // expands the file and directory arguments, stdin is handled separately
+    void CollectInputs(const Options& options, std::vector<InputFile>& files, bool& readStdin)
+    {
+        readStdin = false;
+        for (const std::string& input : options.inputs)
+        {
+            if (input == "-")
+            {
+                readStdin = true;
+                continue;
+            }
+
+            std::error_code error;
+            if (fs::is_directory(input, error))
+            {
+                std::vector<InputFile> found;
+                for (fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, error), end;
+                     it != end; it.increment(error))
+                {
+                    if (it->is_regular_file(error) && IsTextFile(it->path()))
+                        found.push_back(InputFile{ it->path(), fs::path(input) });
+                }
+                std::sort(found.begin(), found.end(),
+                          [](const InputFile& a, const InputFile& b) { return a.path < b.path; });
+                files.insert(files.end(), found.begin(), found.end());
+            }
+            else
+            {
+                files.push_back(InputFile{ fs::path(input), fs::path() });
+            }
+        }
+    }
+
+    bool ReadFile(const fs::path& path, std::string& content)
+    {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.seekg(0, std::ios::end);
+        std::streamoff size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        if (size < 0)
+            return false;
+        content.resize(static_cast<size_t>(size));
+        file.read(&content[0], size);
+        return static_cast<bool>(file) || file.gcount() == size;
+    }
+
+    bool WriteFile(const fs::path& path, const std::string& content)
+    {
+        std::error_code error;
+        if (path.has_parent_path())
+            fs::create_directories(path.parent_path(), error);
+        // replaces path only once the whole content is on disk, an input corrected in place
+        // is never left half written
+        AtomicFile file;
+        return file.Open(path.string()) && file.Write(content.data(), content.size()) && file.Commit();
+    }
+
+    // where the corrected version of a file goes, empty if it is not written
+    fs::path OutputPathFor(const Options& options, const InputFile& input)
+    {
+        if (options.inPlace)
+            return input.path;
+        if (options.outputDir.empty())
+            return fs::path();
+        fs::path relative = input.inputRoot.empty()
+            ? input.path.filename()
+            : input.path.lexically_relative(input.inputRoot);
+        return fs::path(options.outputDir) / relative;
+    }
+
+    std::shared_ptr<AnalysisDiagnostics> NewDiagnostics(const Options& options)
+    {
+        if (options.diagnosticsLimit == 0)
+            return nullptr;
+        return std::make_shared<AnalysisDiagnostics>(options.diagnosticsLimit);
+    }
+
+    void CollectMessages(const AnalysisState& state, FileResult& result)
+    {
+        for (const auto& message : CountMessages(state))
+            result.messages[message.first] += message.second;
+    }
+
+    // with a pool the text is split over its workers (see AnalyzeParallel), else with a cache
+    // the paragraphs analyzed before are taken from it
+    FileResult AnalyzeText(std::string& text, const Options& options, const RulePack& rules, ResultCache* cache,
+                           AnalysisMetrics* metrics, WorkStealingPool* pool)
+    {
+        AnalysisSettings settings{ options.capitalizeFirstLetter, options.fixSpacing,
+                                   options.capitalizeAfterPeriod, options.codingTerms, options.suggestSpelling };
+        FileResult result;
+        result.bytes = text.size();
+        result.diagnostics = NewDiagnostics(options);
+        std::string before = text;
+        AnalysisState state;
+        if (pool)
+            AnalyzeParallel(text, settings, rules, state, *pool, metrics, result.diagnostics.get());
+        else if (cache && !metrics)
+            AnalyzePieceCached(text, settings, rules, state, *cache, result.diagnostics.get());
+        else
+            AnalyzePiece(text, settings, rules, state, metrics, result.diagnostics.get());
+        result.likeness = ComputeLikeness(state);
+        result.changed = text != before;
+        CollectMessages(state, result);
+        return result;
+    }
+
+    // analyzes input chunk by chunk, corrected text goes to output (if not empty) piece by piece
+    FileResult AnalyzeStream(std::istream& input, const StreamAnalyzer::Output& output, const Options& options, const RulePack& rules,
+                             ResultCache* cache, AnalysisMetrics* metrics)
+    {
+        AnalysisSettings settings{ options.capitalizeFirstLetter, options.fixSpacing,
+                                   options.capitalizeAfterPeriod, options.codingTerms, options.suggestSpelling };
+        StreamAnalyzer analyzer(settings, [&output](const std::string& piece)
+        {
+            if (output)
+                output(piece);
+        }, rules);
+        analyzer.SetMetrics(metrics);
+        std::shared_ptr<AnalysisDiagnostics> diagnostics = NewDiagnostics(options);
+        analyzer.SetDiagnostics(diagnostics.get());
+        analyzer.SetCache(cache);
+
+        std::vector<char> block(StreamAnalyzer::DEFAULT_CHUNK_SIZE);
+        while (input)
+        {
+            input.read(block.data(), static_cast<std::streamsize>(block.size()));
+            analyzer.Write(block.data(), static_cast<size_t>(input.gcount()));
+        }
+
+        analyzer.Finish();
+
+        FileResult result;
+        result.diagnostics = std::move(diagnostics);
+        result.bytes = analyzer.BytesIn();
+        result.likeness = ComputeLikeness(analyzer.State());
+        result.changed = analyzer.Changed();
+        CollectMessages(analyzer.State(), result);
+        if (input.bad())
+            result.error = "could not read input";
+        return result;
+    }
+
+    FileResult AnalyzeFileStreaming(const InputFile& input, const fs::path& outputPath, const Options& options, const RulePack& rules,
+                                    ResultCache* cache, AnalysisMetrics* metrics)
+    {
+        std::ifstream file(input.path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+        {
+            FileResult result;
+            result.error = "could not read file";
+            return result;
+        }
+        if (outputPath.empty())
+            return AnalyzeStream(file, nullptr, options, rules, cache, metrics);
+
+        // like WriteFile the output replaces outputPath only once all of it is on disk, an
+        // error or a crash on the way leaves the old file (the input when in place) as it was
+        std::error_code error;
+        if (outputPath.has_parent_path())
+            fs::create_directories(outputPath.parent_path(), error);
+        AtomicFile out;
+        if (!out.Open(outputPath.string()))
+        {
+            FileResult result;
+            result.error = "could not write " + outputPath.string();
+            return result;
+        }
+
+        bool written = true;
+        FileResult result = AnalyzeStream(file, [&out, &written](const std::string& piece)
+        {
+            written = written && out.Write(piece.data(), piece.size());
+        }, options, rules, cache, metrics);
+        file.close();
+
+        // an input corrected in place is only replaced if something changed
+        if (!result.error.empty() || (options.inPlace && !result.changed))
+            out.Discard();
+        else if (!written || !out.Commit())
+            result.error = (options.inPlace ? "could not replace " : "could not write ") + outputPath.string();
+        return result;
+    }
+
+    FileResult AnalyzeFile(const InputFile& input, const Options& options, const RulePack& rules, ResultCache* cache,
+                           AnalysisMetrics* metrics, WorkStealingPool* pool = nullptr)
+    {
+        fs::path outputPath = OutputPathFor(options, input);
+
+        std::error_code error;
+        uint64_t size = fs::file_size(input.path, error);
+        if (options.stream || (!pool && !error && size >= STREAM_THRESHOLD))
+            return AnalyzeFileStreaming(input, outputPath, options, rules, cache, metrics);
+
+        std::string text;
+        if (!ReadFile(input.path, text))
+        {
+            FileResult result;
+            result.error = "could not read file";
+            return result;
+        }
+
+        FileResult result = AnalyzeText(text, options, rules, cache, metrics, pool);
+
+        if (!outputPath.empty() && (result.changed || !options.inPlace) && !WriteFile(outputPath, text))
+            result.error = "could not write " + outputPath.string();
+        return result;
+    }
+
+    std::string JsonEscape(const std::string& text)
+    {
+        std::string escaped;
+        escaped.reserve(text.size() + 2);
+        for (unsigned char c : text)
+        {
+            switch (c)
+            {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    escaped += buffer;
+                }
+                else
+                {
+                    escaped += static_cast<char>(c);
+                }
+            }
+        }
+        return escaped;
+    }
+
+    void WriteReport(std::ostream& out, const Options& options, const std::vector<std::string>& names,
+                     const std::vector<FileResult>& results, double seconds, uint64_t totalBytes, const ResultCache* cache)
+    {
+        out << "{\n";
+        out << "  \"settings\": {\"capitalize\": " << (options.capitalizeFirstLetter ? "true" : "false")
+            << ", \"spacing\": " << (options.fixSpacing ? "true" : "false")
+            << ", \"after_period\": " << (options.capitalizeAfterPeriod ? "true" : "false")
+            << ", \"coding_terms\": " << (options.codingTerms ? "true" : "false")
+            << ", \"spelling\": " << (options.suggestSpelling ? "true" : "false")
+            << ", \"language\": \"" << LanguageCode(options.language) << "\"},\n";
+        out << "  \"files\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const FileResult& result = results[i];
+            out << "    {\"path\": \"" << JsonEscape(names[i]) << "\", \"bytes\": " << result.bytes
+                << ", \"changed\": " << (result.changed ? "true" : "false")
+                << ", \"likeness\": " << result.likeness << ", \"messages\": {";
+            bool first = true;
+            for (const auto& message : result.messages)
+            {
+                out << (first ? "" : ", ") << "\"" << JsonEscape(message.first) << "\": " << message.second;
+                first = false;
+            }
+            out << "}";
+            if (result.diagnostics)
+                out << ", \"diagnostics\": " << DiagnosticsToJson(*result.diagnostics);
+            if (!result.error.empty())
+                out << ", \"error\": \"" << JsonEscape(result.error) << "\"";
+            out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ],\n";
+        out << "  \"summary\": {\"files\": " << results.size() << ", \"bytes\": " << totalBytes
+            << ", \"seconds\": " << seconds
+            << ", \"files_per_second\": " << (seconds > 0 ? results.size() / seconds : 0.0)
+            << ", \"mb_per_second\": " << (seconds > 0 ? totalBytes / 1e6 / seconds : 0.0) << "}";
+        if (cache)
+        {
+            ResultCache::Statistics statistics = cache->GetStatistics();
+            out << ",\n  \"cache\": {\"hits\": " << statistics.hits << ", \"misses\": " << statistics.misses
+                << ", \"stores\": " << statistics.stores << ", \"evictions\": " << statistics.evictions
+                << ", \"entries\": " << statistics.entries << ", \"capacity\": " << statistics.capacity << "}";
+        }
+        out << "\n";
+        out << "}\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // the rules are loaded once and shared read-only by all workers
+    RulePack customRules;
+    const RulePack* rules = nullptr;
+    if (!options.dictionaryPath.empty())
+    {
+        if (!customRules.BuildFromSources(options.language, RULE_PACK_DIRECTORY, options.dictionaryPath))
+        {
+            std::cerr << "could not open dictionary " << options.dictionaryPath << "\n";
+            return 2;
+        }
+        rules = &customRules;
+    }
+    else
+    {
+        rules = &RulePackFor(options.language);
+    }
+
+    // the cache only saves time, the files are analyzed without it if it cannot be opened
+    ResultCache resultCache;
+    ResultCache* cache = nullptr;
+    if (!options.cachePath.empty())
+    {
+        std::string error;
+        if (resultCache.Open(options.cachePath, options.cacheBytes, error))
+            cache = &resultCache;
+        else
+            std::cerr << "not using the result cache: " << error << "\n";
+    }
+
+    std::vector<InputFile> files;
+    bool readStdin = false;
+    CollectInputs(options, files, readStdin);
+
+    std::vector<std::string> names;
+    std::vector<FileResult> results(files.size());
+    for (const InputFile& file : files)
+        names.push_back(file.path.string());
+
+    auto start = std::chrono::steady_clock::now();
+
+    // every input collects its own metrics, merged when all are done
+    bool collectMetrics = !options.metricsPath.empty() || !options.tracePath.empty();
+    std::vector<AnalysisMetrics> metrics(collectMetrics ? files.size() + 1 : 0);
+    for (AnalysisMetrics& fileMetrics : metrics)
+    {
+        fileMetrics.origin = start;
+        fileMetrics.recordEvents = !options.tracePath.empty();
+    }
+    auto metricsFor = [&](size_t i) { return collectMetrics ? &metrics[i] : nullptr; };
+
+    if (readStdin)
+    {
+        results.push_back(AnalyzeStream(std::cin, [](const std::string& piece)
+        {
+            std::cout.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        }, options, *rules, cache, metricsFor(files.size())));
+        names.push_back("-");
+        std::cout.flush();
+    }
+
+    {
+        WorkStealingPool pool(options.jobs);
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (options.parallel)
+            {
+                results[i] = AnalyzeFile(files[i], options, *rules, cache, metricsFor(i), &pool);
+                continue;
+            }
+            pool.Submit([&, i]
+            {
+                results[i] = AnalyzeFile(files[i], options, *rules, cache, metricsFor(i));
+            });
+        }
+        pool.Wait();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    uint64_t totalBytes = 0;
+    int exitCode = 0;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        totalBytes += results[i].bytes;
+        if (!results[i].error.empty())
+        {
+            std::cerr << names[i] << ": " << results[i].error << "\n";
+            exitCode = 1;
+        }
+    }
+
+    if (!options.reportPath.empty())
+    {
+        if (options.reportPath == "-")
+        {
+            WriteReport(std::cout, options, names, results, elapsed.count(), totalBytes, cache);
+        }
+        else
+        {
+            std::ofstream report(options.reportPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!report.is_open())
+            {
+                std::cerr << "could not write report " << options.reportPath << "\n";
+                exitCode = 1;
+            }
+            else
+            {
+                WriteReport(report, options, names, results, elapsed.count(), totalBytes, cache);
+            }
+        }
+    }
+
+    if (collectMetrics)
+    {
+        AnalysisMetrics total;
+        total.origin = start;
+        for (const AnalysisMetrics& fileMetrics : metrics)
+            total.Merge(fileMetrics);
+
+        if (options.metricsPath == "-")
+            std::cerr << MetricsToJson(total);
+        else if (!options.metricsPath.empty() && !WriteFile(options.metricsPath, MetricsToJson(total)))
+        {
+            std::cerr << "could not write metrics " << options.metricsPath << "\n";
+            exitCode = 1;
+        }
+        if (!options.tracePath.empty() && !WriteFile(options.tracePath, MetricsToChromeTrace(total)))
+        {
+            std::cerr << "could not write trace " << options.tracePath << "\n";
+            exitCode = 1;
+        }
+    }
+
+    double seconds = elapsed.count();
+    std::fprintf(stderr, "%zu files, %.2f MB in %.3f s (%.1f files/s, %.2f MB/s)\n",
+                 results.size(), totalBytes / 1e6, seconds,
+                 seconds > 0 ? results.size() / seconds : 0.0,
+                 seconds > 0 ? totalBytes / 1e6 / seconds : 0.0);
+    if (cache)
+    {
+        ResultCache::Statistics statistics = cache->GetStatistics();
+        std::fprintf(stderr, "result cache: %llu of %llu paragraphs reused, %llu entries\n",
+                     static_cast<unsigned long long>(statistics.hits),
+                     static_cast<unsigned long long>(statistics.hits + statistics.misses),
+                     static_cast<unsigned long long>(statistics.entries));
+    }
+    return exitCode;
+}
@@ -0,0 +1,281 @@
+// load generator for trace_server: keeps a number of connections sending analysis requests
+// of generated text and reports throughput and latency percentiles
+//
+// usage: trace_load [-s PATH] [-C N] [-d N] [-b BYTES] [-t SECONDS] [-f FLAGS] [--corpus KIND]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_protocol.h"
+#include "corpus_generator.h"
+
+namespace
+{
+    struct Options
+    {
+        std::string socketPath = DefaultSocketPath();
+        unsigned connections = 8;
+        unsigned depth = 1;   // requests a connection sends before waiting for a response
+        size_t bytes = 2048;  // text per request
+        double seconds = 5.0;
+        uint8_t flags = ANALYZE_CAPITALIZE | ANALYZE_SPACING | ANALYZE_AFTER_PERIOD;
+        CorpusKind corpus = CorpusKind::PROSE;
+    };
+
+    // the text the requests are cut from
+    const size_t CORPUS_SIZE = 4u << 20;
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "usage: trace_load [options]\n"
+            "\n"
+            "  -s, --socket PATH        server socket (default " << DefaultSocketPath() << ")\n"
+            "  -C, --connections N      concurrent connections (default 8)\n"
+            "  -d, --depth N            requests each connection keeps in flight (default 1)\n"
+            "  -b, --bytes N            text bytes per request (default 2048)\n"
+            "  -t, --duration SECONDS   how long to send requests (default 5)\n"
+            "  -f, --flags LETTERS      analysis flags as in trace_cli, any of c, s, p, k and\n"
+            "                           S (default csp)\n"
+            "      --corpus KIND        prose, code, diacritics or whitespace (default prose)\n"
+            "\n"
+            "prints the client side throughput and latency, then the server's counters\n";
+    }
+
+    // returns false on a usage error
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](std::string& out)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                out = argv[++i];
+                return true;
+            };
+
+            std::string text;
+            if (arg == "-s" || arg == "--socket")
+            {
+                if (!value(options.socketPath))
+                    return false;
+            }
+            else if (arg == "-C" || arg == "--connections")
+            {
+                if (!value(text) || (options.connections = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10))) == 0)
+                    return false;
+            }
+            else if (arg == "-d" || arg == "--depth")
+            {
+                if (!value(text) || (options.depth = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10))) == 0)
+                    return false;
+            }
+            else if (arg == "-b" || arg == "--bytes")
+            {
+                if (!value(text))
+                    return false;
+                options.bytes = std::min<size_t>(std::strtoull(text.c_str(), nullptr, 10), CORPUS_SIZE);
+            }
+            else if (arg == "-t" || arg == "--duration")
+            {
+                if (!value(text) || (options.seconds = std::strtod(text.c_str(), nullptr)) <= 0.0)
+                    return false;
+            }
+            else if (arg == "-f" || arg == "--flags")
+            {
+                if (!value(text))
+                    return false;
+                options.flags = 0;
+                for (char letter : text)
+                {
+                    switch (letter)
+                    {
+                    case 'c': options.flags |= ANALYZE_CAPITALIZE; break;
+                    case 's': options.flags |= ANALYZE_SPACING; break;
+                    case 'p': options.flags |= ANALYZE_AFTER_PERIOD; break;
+                    case 'k': options.flags |= ANALYZE_CODING_TERMS; break;
+                    case 'S': options.flags |= ANALYZE_SPELLING; break;
+                    case '-': break;
+                    default: return false;
+                    }
+                }
+            }
+            else if (arg == "--corpus")
+            {
+                if (!value(text) || !ParseCorpusKind(text, options.corpus))
+                    return false;
+            }
+            else
+            {
+                if (arg != "-h" && arg != "--help")
+                    std::cerr << "unknown option: " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct ClientResult
+    {
+        std::vector<double> latencies; // microseconds
+        uint64_t bytesSent = 0;
+        uint64_t failures = 0; // responses that were not OK
+        bool connected = true;
+    };
+
+    // one connection: keeps depth requests in flight until the time is up, then collects
+    // the outstanding responses
+    void RunClient(const Options& options, const std::string& corpus, unsigned index, ClientResult& result)
+    {
+        using Clock = std::chrono::steady_clock;
+        int socket = ConnectLocalSocket(options.socketPath);
+        if (socket < 0)
+        {
+            result.connected = false;
+            return;
+        }
+
+        const Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+        std::unordered_map<uint32_t, Clock::time_point> sent;
+        std::string frame;
+        std::string payload;
+        uint32_t nextId = 0;
+        size_t offset = (corpus.size() / options.connections) * index;
+
+        while (true)
+        {
+            bool sending = Clock::now() < end;
+            while (sending && sent.size() < options.depth)
+            {
+                if (offset + options.bytes > corpus.size())
+                    offset = 0;
+                Request request;
+                request.id = nextId++;
+                request.flags = options.flags;
+                request.text = std::string_view(corpus).substr(offset, options.bytes);
+                offset += options.bytes;
+
+                frame.clear();
+                EncodeRequest(request, frame);
+                sent[request.id] = Clock::now();
+                if (!SendAll(socket, frame.data(), frame.size()))
+                {
+                    result.connected = false;
+                    CloseSocket(socket);
+                    return;
+                }
+                result.bytesSent += frame.size();
+            }
+            if (sent.empty())
+                break;
+
+            Response response;
+            if (!ReadFrame(socket, payload) || !DecodeResponse(payload, response))
+            {
+                result.connected = false;
+                break;
+            }
+            auto request = sent.find(response.id);
+            if (request != sent.end())
+            {
+                std::chrono::duration<double, std::micro> elapsed = Clock::now() - request->second;
+                result.latencies.push_back(elapsed.count());
+                sent.erase(request);
+            }
+            if (response.status != ResponseStatus::OK)
+                ++result.failures;
+        }
+        CloseSocket(socket);
+    }
+
+    // nearest rank percentile of sorted samples
+    double Percentile(const std::vector<double>& sorted, double percent)
+    {
+        if (sorted.empty())
+            return 0.0;
+        size_t rank = static_cast<size_t>(percent / 100.0 * sorted.size() + 0.999999);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    // the server's counters, empty if it did not answer
+    std::string FetchServerCounters(const std::string& socketPath)
+    {
+        int socket = ConnectLocalSocket(socketPath);
+        if (socket < 0)
+            return std::string();
+        Request request;
+        request.kind = RequestKind::STATS;
+        std::string frame;
+        EncodeRequest(request, frame);
+        std::string payload;
+        Response response;
+        std::string counters;
+        if (SendAll(socket, frame.data(), frame.size()) && ReadFrame(socket, payload) && DecodeResponse(payload, response))
+            counters.assign(response.text.data(), response.text.size());
+        CloseSocket(socket);
+        return counters;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    const std::string corpus = GenerateCorpus(options.corpus, CORPUS_SIZE);
+    std::vector<ClientResult> results(options.connections);
+    std::vector<std::thread> clients;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned c = 0; c < options.connections; ++c)
+        clients.emplace_back(RunClient, std::cref(options), std::cref(corpus), c, std::ref(results[c]));
+    for (std::thread& client : clients)
+        client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> latencies;
+    uint64_t bytes = 0;
+    uint64_t failures = 0;
+    unsigned disconnected = 0;
+    for (const ClientResult& result : results)
+    {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        bytes += result.bytesSent;
+        failures += result.failures;
+        disconnected += result.connected ? 0 : 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    if (disconnected == options.connections && latencies.empty())
+    {
+        std::cerr << "could not connect to " << options.socketPath << "\n";
+        return 1;
+    }
+
+    std::printf("connections %u, depth %u, %zu bytes per request, %s corpus\n", options.connections, options.depth, options.bytes,
+                CorpusName(options.corpus));
+    std::printf("requests %zu in %.2f s: %.0f requests/s, %.2f MB/s sent\n", latencies.size(), seconds, latencies.size() / seconds,
+                bytes / seconds / (1024.0 * 1024.0));
+    std::printf("latency us: p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n", Percentile(latencies, 50.0), Percentile(latencies, 90.0),
+                Percentile(latencies, 99.0), latencies.empty() ? 0.0 : latencies.back());
+    if (failures > 0 || disconnected > 0)
+        std::printf("failed responses %llu, lost connections %u\n", static_cast<unsigned long long>(failures), disconnected);
+
+    std::string counters = FetchServerCounters(options.socketPath);
+    if (!counters.empty())
+        std::printf("server %s\n", counters.c_str());
+    return failures > 0 || disconnected > 0 ? 1 : 0;
+}
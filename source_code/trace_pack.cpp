@@ -0,0 +1,111 @@
+// compiles the rule sources of each language into the binary rule packs loaded by TRACE
+//
+// usage: trace_pack [-l LANG]... [-s DIR] [-o DIR]
+// reads typos_<code>.txt, abbreviations_<code>.txt, words_<code>.txt and coding_terms.txt
+// from the source directory and writes <code>.pack to the output directory
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rule_pack.h"
+
+namespace
+{
+    struct Options
+    {
+        std::vector<Language> languages; // all if empty
+        std::string sourceDir = RULE_PACK_DIRECTORY;
+        std::string outputDir = RULE_PACK_DIRECTORY;
+    };
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "usage: trace_pack [options]\n"
+            "\n"
+            "  -l, --language LANG      compile only LANG (en, es, fr or pl), may be repeated\n"
+            "                           (default all)\n"
+            "  -s, --sources DIR        directory of the rule sources (default " << RULE_PACK_DIRECTORY << ")\n"
+            "  -o, --output-dir DIR     directory the packs are written to (default " << RULE_PACK_DIRECTORY << ")\n";
+    }
+
+    // returns false on a usage error
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](std::string& out)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                out = argv[++i];
+                return true;
+            };
+
+            std::string text;
+            if (arg == "-l" || arg == "--language")
+            {
+                Language language;
+                if (!value(text) || !ParseLanguageCode(text, language))
+                    return false;
+                options.languages.push_back(language);
+            }
+            else if (arg == "-s" || arg == "--sources")
+            {
+                if (!value(options.sourceDir))
+                    return false;
+            }
+            else if (arg == "-o" || arg == "--output-dir")
+            {
+                if (!value(options.outputDir))
+                    return false;
+            }
+            else
+            {
+                if (arg != "-h" && arg != "--help")
+                    std::cerr << "unknown option: " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+    if (options.languages.empty())
+    {
+        for (size_t l = 0; l < LANGUAGE_COUNT; ++l)
+            options.languages.push_back(static_cast<Language>(l));
+    }
+
+    for (Language language : options.languages)
+    {
+        RulePack pack;
+        pack.BuildFromSources(language, options.sourceDir);
+        std::string path = options.outputDir + "/" + LanguageCode(language) + ".pack";
+        if (!pack.WritePack(path))
+        {
+            std::cerr << "could not write " << path << "\n";
+            return 1;
+        }
+
+        // the pack must load back as written
+        RulePack check;
+        if (!check.MapPack(language, path) || check.Typos().Size() != pack.Typos().Size())
+        {
+            std::cerr << "could not load " << path << " back\n";
+            return 1;
+        }
+        std::cout << path << ": " << pack.Typos().Size() << " typos\n";
+    }
+    return 0;
+}
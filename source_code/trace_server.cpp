@@ -0,0 +1,502 @@
+// local analysis server for editor plugins and commit hooks, does not use wxWidgets
+//
+// usage: trace_server [-s PATH] [-j N] [-q MB] [-b KB]
+// keeps the rule packs of every language loaded and answers the requests of
+// analysis_protocol.h on a Unix domain socket until SIGINT or SIGTERM
+// connections are read by one thread each, requests wait in one queue and are handed to
+// the workers in batches: whatever has queued up while all workers were busy goes to the
+// next free one at once, up to a batch size, so a burst of small requests costs one task
+// per batch rather than one per request; when the queue holds its limit the connection
+// threads stop reading, which makes the clients' sends block
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "analysis_arena.h"
+#include "analysis_protocol.h"
+#include "text_analyzer.h"
+#include "thread_pool.h"
+
+namespace
+{
+    struct Options
+    {
+        std::string socketPath = DefaultSocketPath();
+        unsigned jobs = 0;
+        size_t queueBytes = 256u << 20;  // request bytes waiting for a worker
+        size_t maxQueued = 4096;         // requests waiting for a worker
+        size_t batchBytes = 256u << 10;  // a batch takes requests up to this many bytes
+        size_t batchRequests = 64;
+    };
+
+    // a worker blocked this long writing to a client that does not read gives up on it
+    const int SEND_TIMEOUT_SECONDS = 10;
+
+    std::atomic<bool> stopRequested{ false };
+
+    void OnStopSignal(int)
+    {
+        stopRequested = true;
+    }
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "usage: trace_server [options]\n"
+            "\n"
+            "  -s, --socket PATH        socket to listen on (default " << DefaultSocketPath() << ")\n"
+            "  -j, --jobs N             number of worker threads (default: all cores)\n"
+            "  -q, --queue-mb N         request megabytes queued before clients are made to\n"
+            "                           wait (default 256)\n"
+            "  -b, --batch-kb N         kilobytes of small requests handed to a worker at\n"
+            "                           once (default 256)\n"
+            "\n"
+            "runs until interrupted, then prints its counters as JSON to stderr\n";
+    }
+
+    // returns false on a usage error
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto number = [&](size_t& out)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                out = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+                return out > 0;
+            };
+
+            size_t value = 0;
+            if (arg == "-s" || arg == "--socket")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                options.socketPath = argv[++i];
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                if (!number(value))
+                    return false;
+                options.jobs = static_cast<unsigned>(value);
+            }
+            else if (arg == "-q" || arg == "--queue-mb")
+            {
+                if (!number(value))
+                    return false;
+                options.queueBytes = value << 20;
+            }
+            else if (arg == "-b" || arg == "--batch-kb")
+            {
+                if (!number(value))
+                    return false;
+                options.batchBytes = value << 10;
+            }
+            else
+            {
+                if (arg != "-h" && arg != "--help")
+                    std::cerr << "unknown option: " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // request latencies in buckets a quarter octave wide, so percentiles are within 19%
+    class LatencyHistogram
+    {
+    public:
+        static const size_t BUCKETS = 4 * 36; // up to about 19 hours in microseconds
+
+        void Add(double microseconds)
+        {
+            size_t bucket = microseconds <= 1.0 ? 0 : static_cast<size_t>(4.0 * std::log2(microseconds)) + 1;
+            ++counts[std::min(bucket, BUCKETS - 1)];
+            uint64_t value = static_cast<uint64_t>(microseconds);
+            uint64_t maximum = largest.load();
+            while (value > maximum && !largest.compare_exchange_weak(maximum, value))
+            {
+            }
+        }
+
+        // upper bound in microseconds of the bucket holding the percentile
+        double Percentile(double percent) const
+        {
+            uint64_t total = 0;
+            for (const auto& count : counts)
+                total += count.load();
+            if (total == 0)
+                return 0.0;
+            uint64_t rank = static_cast<uint64_t>(std::ceil(percent / 100.0 * total));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < BUCKETS; ++b)
+            {
+                seen += counts[b].load();
+                if (seen >= std::max<uint64_t>(rank, 1))
+                    return std::min(std::exp2(b / 4.0), static_cast<double>(largest.load()));
+            }
+            return static_cast<double>(largest.load());
+        }
+
+        uint64_t Max() const { return largest.load(); }
+
+    private:
+        std::atomic<uint64_t> counts[BUCKETS] = {};
+        std::atomic<uint64_t> largest{ 0 };
+    };
+
+    // one client, shared by its reading thread and the workers answering its requests
+    struct Connection
+    {
+        explicit Connection(int socket) : socket(socket) {}
+        ~Connection() { CloseSocket(socket); }
+
+        const int socket;
+        std::mutex writeMutex; // one response is written at a time
+        std::atomic<bool> failed{ false };
+        std::atomic<bool> finished{ false }; // the reading thread is done
+    };
+
+    struct QueuedRequest
+    {
+        std::shared_ptr<Connection> connection;
+        std::string payload;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    class AnalysisServer
+    {
+    public:
+        explicit AnalysisServer(const Options& options)
+            : options(options), pool(options.jobs), started(std::chrono::steady_clock::now())
+        {
+        }
+
+        // accepts connections on listener until stopRequested, then answers what is queued
+        void Run(int listener);
+
+        std::string CountersJson() const;
+
+    private:
+        void ReadRequests(std::shared_ptr<Connection> connection);
+        void Dispatch();
+        void AnswerBatch(std::vector<QueuedRequest>& batch);
+        void Answer(QueuedRequest& queued, const Response& response);
+
+        const Options options;
+        WorkStealingPool pool;
+        const std::chrono::steady_clock::time_point started;
+
+        // the queue, guarded by queueMutex; queueChanged wakes the dispatcher when a request
+        // comes in or a worker gets free, and the connection threads when there is room
+        std::mutex queueMutex;
+        std::condition_variable queueChanged;
+        std::deque<QueuedRequest> queue;
+        size_t queuedBytes = 0;
+        unsigned busyWorkers = 0;
+        bool stopping = false;
+
+        std::atomic<uint64_t> connections{ 0 };
+        std::atomic<uint64_t> openConnections{ 0 };
+        std::atomic<uint64_t> requests{ 0 };
+        std::atomic<uint64_t> badRequests{ 0 };
+        std::atomic<uint64_t> batches{ 0 };
+        std::atomic<uint64_t> backpressureWaits{ 0 };
+        std::atomic<uint64_t> maxQueued{ 0 };
+        std::atomic<uint64_t> bytesIn{ 0 };
+        std::atomic<uint64_t> bytesOut{ 0 };
+        LatencyHistogram latency;
+    };
+
+    void AnalysisServer::Run(int listener)
+    {
+        std::thread dispatcher(&AnalysisServer::Dispatch, this);
+
+        struct Reader
+        {
+            std::shared_ptr<Connection> connection;
+            std::thread thread;
+        };
+        std::vector<Reader> readers;
+
+        while (!stopRequested)
+        {
+            pollfd waiting{ listener, POLLIN, 0 };
+            if (poll(&waiting, 1, 200) > 0 && (waiting.revents & POLLIN))
+            {
+                int socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                if (socket >= 0)
+                {
+                    timeval timeout{ SEND_TIMEOUT_SECONDS, 0 };
+                    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    auto connection = std::make_shared<Connection>(socket);
+                    ++connections;
+                    ++openConnections;
+                    readers.push_back(Reader{ connection, std::thread(&AnalysisServer::ReadRequests, this, connection) });
+                }
+            }
+
+            // joins the threads of clients that went away
+            for (size_t r = 0; r < readers.size();)
+            {
+                if (!readers[r].connection->finished)
+                {
+                    ++r;
+                    continue;
+                }
+                readers[r].thread.join();
+                if (r + 1 < readers.size())
+                    readers[r] = std::move(readers.back());
+                readers.pop_back();
+            }
+        }
+
+        // the dispatcher answers what is still queued, then the workers finish their batches
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        dispatcher.join();
+        pool.Wait();
+
+        for (Reader& reader : readers)
+        {
+            shutdown(reader.connection->socket, SHUT_RDWR);
+            reader.thread.join();
+        }
+    }
+
+    void AnalysisServer::ReadRequests(std::shared_ptr<Connection> connection)
+    {
+        std::string payload;
+        while (ReadFrame(connection->socket, payload))
+        {
+            const size_t size = payload.size();
+            std::unique_lock<std::mutex> lock(queueMutex);
+            auto hasRoom = [&]
+            {
+                return stopping || queue.empty() || (queuedBytes + size <= options.queueBytes && queue.size() < options.maxQueued);
+            };
+            if (!hasRoom())
+            {
+                ++backpressureWaits;
+                queueChanged.wait(lock, hasRoom);
+            }
+            if (stopping)
+                break;
+
+            queue.push_back(QueuedRequest{ connection, std::move(payload), std::chrono::steady_clock::now() });
+            queuedBytes += size;
+            if (queue.size() > maxQueued)
+                maxQueued = queue.size();
+            lock.unlock();
+            queueChanged.notify_all();
+            bytesIn += size + FRAME_HEADER_SIZE;
+            payload = std::string();
+        }
+        --openConnections;
+        connection->finished = true;
+    }
+
+    void AnalysisServer::Dispatch()
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        while (true)
+        {
+            queueChanged.wait(lock, [this] { return stopping || (!queue.empty() && busyWorkers < pool.Size()); });
+            if (stopping)
+                break;
+
+            // one large request alone, else small ones up to the batch limits
+            auto batch = std::make_shared<std::vector<QueuedRequest>>();
+            size_t batchBytes = 0;
+            while (!queue.empty() && batch->size() < options.batchRequests
+                   && (batch->empty() || batchBytes + queue.front().payload.size() <= options.batchBytes))
+            {
+                batchBytes += queue.front().payload.size();
+                batch->push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            queuedBytes -= batchBytes;
+            ++busyWorkers;
+            ++batches;
+
+            lock.unlock();
+            queueChanged.notify_all();
+            pool.Submit([this, batch]
+            {
+                AnswerBatch(*batch);
+                {
+                    std::lock_guard<std::mutex> workerLock(queueMutex);
+                    --busyWorkers;
+                }
+                queueChanged.notify_all();
+            });
+            lock.lock();
+        }
+
+        // requests nobody will analyze any more
+        for (QueuedRequest& queued : queue)
+        {
+            Request request;
+            Response response;
+            if (DecodeRequest(queued.payload, request))
+                response.id = request.id;
+            response.status = ResponseStatus::SHUTTING_DOWN;
+            Answer(queued, response);
+        }
+        queue.clear();
+        queuedBytes = 0;
+    }
+
+    void AnalysisServer::AnswerBatch(std::vector<QueuedRequest>& batch)
+    {
+        for (QueuedRequest& queued : batch)
+        {
+            Request request;
+            Response response;
+            std::string counters;
+            if (!DecodeRequest(queued.payload, request))
+            {
+                ++badRequests;
+                response.status = ResponseStatus::BAD_REQUEST;
+                response.text = "request shorter than its header";
+                Answer(queued, response);
+                continue;
+            }
+            response.id = request.id;
+
+            if (request.kind == RequestKind::STATS)
+            {
+                counters = CountersJson();
+                response.text = counters;
+                Answer(queued, response);
+                continue;
+            }
+            if (request.kind != RequestKind::ANALYZE || request.language >= LANGUAGE_COUNT
+                || (request.flags & ~(ANALYZE_CAPITALIZE | ANALYZE_SPACING | ANALYZE_AFTER_PERIOD | ANALYZE_CODING_TERMS | ANALYZE_SPELLING)) != 0)
+            {
+                ++badRequests;
+                response.status = ResponseStatus::BAD_REQUEST;
+                response.text = request.kind != RequestKind::ANALYZE ? "unknown request kind"
+                    : request.language >= LANGUAGE_COUNT ? "unknown language" : "unknown analysis flags";
+                Answer(queued, response);
+                continue;
+            }
+
+            // the packs stay loaded, an analyzer is only the settings and a reference to them
+            const Language language = static_cast<Language>(request.language);
+            const TextAnalyzer analyzer(SettingsFromFlags(request.flags), RulePackFor(language));
+            AnalysisResult result = analyzer.Analyze(request.text);
+            std::string findings = FormatFindings(result.report, language);
+            response.changed = result.changed;
+            response.likeness = result.report.likeness;
+            response.findings = findings;
+            response.text = result.text;
+            Answer(queued, response);
+        }
+    }
+
+    void AnalysisServer::Answer(QueuedRequest& queued, const Response& response)
+    {
+        ScratchString scratch;
+        std::string& frame = scratch.Get();
+        EncodeResponse(response, frame);
+
+        Connection& connection = *queued.connection;
+        if (!connection.failed)
+        {
+            std::lock_guard<std::mutex> lock(connection.writeMutex);
+            if (!SendAll(connection.socket, frame.data(), frame.size()))
+            {
+                // the client is gone or stopped reading, its reading thread ends as well
+                connection.failed = true;
+                shutdown(connection.socket, SHUT_RDWR);
+            }
+        }
+        bytesOut += frame.size();
+        ++requests;
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - queued.received;
+        latency.Add(elapsed.count());
+    }
+
+    std::string AnalysisServer::CountersJson() const
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        uint64_t answered = requests.load();
+        std::ostringstream out;
+        out << "{\"uptime_seconds\": " << seconds
+            << ", \"workers\": " << pool.Size()
+            << ", \"connections\": " << connections.load()
+            << ", \"open_connections\": " << openConnections.load()
+            << ", \"requests\": " << answered
+            << ", \"bad_requests\": " << badRequests.load()
+            << ", \"batches\": " << batches.load()
+            << ", \"requests_per_batch\": " << (batches.load() > 0 ? static_cast<double>(answered) / batches.load() : 0.0)
+            << ", \"backpressure_waits\": " << backpressureWaits.load()
+            << ", \"max_queued\": " << maxQueued.load()
+            << ", \"bytes_in\": " << bytesIn.load()
+            << ", \"bytes_out\": " << bytesOut.load()
+            << ", \"requests_per_second\": " << (seconds > 0.0 ? answered / seconds : 0.0)
+            << ", \"mb_per_second_in\": " << (seconds > 0.0 ? bytesIn.load() / seconds / (1024.0 * 1024.0) : 0.0)
+            << ", \"latency_us\": {\"p50\": " << latency.Percentile(50.0)
+            << ", \"p90\": " << latency.Percentile(90.0)
+            << ", \"p99\": " << latency.Percentile(99.0)
+            << ", \"max\": " << latency.Max() << "}}";
+        return out.str();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // loaded before the first request, so no request waits for a pack to be mapped
+    for (size_t l = 0; l < LANGUAGE_COUNT; ++l)
+        RulePackFor(static_cast<Language>(l));
+
+    std::string error;
+    int listener = ListenLocalSocket(options.socketPath, error);
+    if (listener < 0)
+    {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+
+    AnalysisServer server(options);
+    std::cerr << "listening on " << options.socketPath << "\n";
+    server.Run(listener);
+
+    CloseSocket(listener);
+    unlink(options.socketPath.c_str());
+    std::cerr << server.CountersJson() << "\n";
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "undo_history.h"
+
+#include <utility>
+
+UndoHistory::UndoHistory(size_t memoryLimit)
+    : memoryLimit(memoryLimit)
+{
+}
+
+void UndoHistory::Record(std::vector<TextEdit> edits)
+{
+    for (const Step& step : redoSteps)
+        memoryUsed -= step.bytes;
+    redoSteps.clear();
+
+    if (edits.empty())
+        return;
+
+    size_t bytes = StepBytes(edits);
+    if (bytes > memoryLimit)
+    {
+        Clear();
+        return;
+    }
+    undoSteps.push_back(Step{ std::move(edits), bytes });
+    memoryUsed += bytes;
+    Trim();
+}
+
+const std::vector<TextEdit>& UndoHistory::Undo()
+{
+    redoSteps.push_back(std::move(undoSteps.back()));
+    undoSteps.pop_back();
+    Invert(redoSteps.back().edits);
+    return redoSteps.back().edits;
+}
+
+const std::vector<TextEdit>& UndoHistory::Redo()
+{
+    undoSteps.push_back(std::move(redoSteps.back()));
+    redoSteps.pop_back();
+    Invert(undoSteps.back().edits);
+    return undoSteps.back().edits;
+}
+
+void UndoHistory::Clear()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    memoryUsed = 0;
+}
+
+void UndoHistory::SetMemoryLimit(size_t newLimit)
+{
+    memoryLimit = newLimit;
+    Trim();
+}
+
+size_t UndoHistory::StepBytes(const std::vector<TextEdit>& edits)
+{
+    size_t bytes = sizeof(Step) + edits.size() * sizeof(TextEdit);
+    for (const TextEdit& edit : edits)
+        bytes += edit.removed.size() + edit.inserted.size();
+    return bytes;
+}
+
+// turns edits of a text into the edits that restore it, offsets move into the edited text
+void UndoHistory::Invert(std::vector<TextEdit>& edits)
+{
+    size_t shift = 0; // total growth of the text before the current edit, may wrap around
+    for (TextEdit& edit : edits)
+    {
+        edit.offset += shift;
+        shift += edit.inserted.size() - edit.removed.size();
+        edit.removed.swap(edit.inserted);
+    }
+}
+
+// drops the oldest steps while over the limit, undo steps first, then the furthest redo steps
+void UndoHistory::Trim()
+{
+    while (memoryUsed > memoryLimit && !undoSteps.empty())
+    {
+        memoryUsed -= undoSteps.front().bytes;
+        undoSteps.pop_front();
+    }
+    while (memoryUsed > memoryLimit && !redoSteps.empty())
+    {
+        memoryUsed -= redoSteps.front().bytes;
+        redoSteps.erase(redoSteps.begin());
+    }
+}
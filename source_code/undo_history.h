@@ -0,0 +1,55 @@
+#pragma once
+
+#include "text_edit.h"
+
+#include <deque>
+#include <vector>
+
+// multi-level undo and redo of text changes, each step is a list of edits instead of a
+// copy of the whole text, so undoing or redoing costs the size of the step's edits
+// the oldest steps are dropped while undo and redo together use more than the memory limit
+class UndoHistory
+{
+public:
+    static const size_t DEFAULT_MEMORY_LIMIT = 64 << 20;
+
+    explicit UndoHistory(size_t memoryLimit = DEFAULT_MEMORY_LIMIT);
+
+    // adds a step made of ascending edits with offsets in the text before the step,
+    // the redo steps are discarded; a step bigger than the whole limit clears the history
+    void Record(std::vector<TextEdit> edits);
+
+    // moves the newest step to the redo list and returns the edits that undo it, ascending
+    // with offsets in the current text, the reference is valid until the next call
+    // must not be called when CanUndo() is false
+    const std::vector<TextEdit>& Undo();
+
+    // moves the newest undone step back and returns the edits that redo it, like Undo()
+    const std::vector<TextEdit>& Redo();
+
+    void Clear();
+    void SetMemoryLimit(size_t newLimit);
+
+    bool CanUndo() const { return !undoSteps.empty(); }
+    bool CanRedo() const { return !redoSteps.empty(); }
+    size_t UndoLevels() const { return undoSteps.size(); }
+    size_t RedoLevels() const { return redoSteps.size(); }
+    size_t MemoryUsed() const { return memoryUsed; }
+    size_t MemoryLimit() const { return memoryLimit; }
+
+private:
+    struct Step
+    {
+        std::vector<TextEdit> edits;
+        size_t bytes;
+    };
+
+    static size_t StepBytes(const std::vector<TextEdit>& edits);
+    static void Invert(std::vector<TextEdit>& edits);
+    void Trim();
+
+    std::deque<Step> undoSteps; // newest at the back
+    std::vector<Step> redoSteps; // newest undone at the back
+    size_t memoryLimit;
+    size_t memoryUsed = 0;
+};
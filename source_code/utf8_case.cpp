@@ -0,0 +1,82 @@
+#include "utf8_case.h"
+
+#include <cstdint>
+
+namespace
+{
+    // code points with a two byte UTF-8 sequence covered by the table
+    const char32_t TABLE_FIRST = 0x80;
+    const char32_t TABLE_END = 0x180;
+
+    // upper case code point of each lower case letter from U+0080 to U+017F, 0 for the rest
+    struct UpperCaseTable
+    {
+        uint16_t upper[TABLE_END - TABLE_FIRST] = {};
+
+        constexpr void Set(char32_t lower, char32_t upperCase) { upper[lower - TABLE_FIRST] = static_cast<uint16_t>(upperCase); }
+
+        // [first, last] holds pairs of an upper case letter followed by its lower case
+        constexpr void SetPairs(char32_t first, char32_t last)
+        {
+            for (char32_t c = first + 1; c <= last; c += 2)
+                Set(c, c - 1);
+        }
+
+        constexpr UpperCaseTable()
+        {
+            // Latin-1 Supplement: à..þ map 0x20 down except ÷, ß (upper case "SS") is below them
+            for (char32_t c = 0xE0; c <= 0xFE; ++c)
+            {
+                if (c != 0xF7)
+                    Set(c, c - 0x20);
+            }
+            Set(0xFF, 0x178); // ÿ -> Ÿ
+
+            // Latin Extended-A: pairs, skipping ı (upper case I is ASCII), ĸ (none),
+            // ŉ (upper case "ʼN") and ſ (upper case S)
+            SetPairs(0x100, 0x12F);
+            SetPairs(0x132, 0x137);
+            SetPairs(0x139, 0x148);
+            SetPairs(0x14A, 0x177);
+            SetPairs(0x179, 0x17E);
+        }
+    };
+
+    constexpr UpperCaseTable UPPER_CASE;
+
+    // code point of the two byte sequence at the start of letter if the table covers it,
+    // otherwise 0
+    char32_t DecodeTableLetter(const char* letter, size_t available)
+    {
+        unsigned char lead = letter[0];
+        if (available < 2 || lead < 0xC2 || lead > 0xC5)
+            return 0;
+        unsigned char next = letter[1];
+        if ((next & 0xC0) != 0x80)
+            return 0;
+        return (static_cast<char32_t>(lead & 0x1F) << 6) | (next & 0x3F);
+    }
+
+    char32_t UpperCase(char32_t c)
+    {
+        return c >= TABLE_FIRST && c < TABLE_END ? UPPER_CASE.upper[c - TABLE_FIRST] : 0;
+    }
+}
+
+namespace detail
+{
+    bool IsLowerLetterNonAscii(std::string_view letter)
+    {
+        return UpperCase(DecodeTableLetter(letter.data(), letter.size())) != 0;
+    }
+
+    bool CapitalizeLetterNonAscii(char* letter, size_t available)
+    {
+        char32_t upper = UpperCase(DecodeTableLetter(letter, available));
+        if (upper == 0)
+            return false;
+        letter[0] = static_cast<char>(0xC0 | (upper >> 6));
+        letter[1] = static_cast<char>(0x80 | (upper & 0x3F));
+        return true;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// case mapping of single UTF-8 letters for the capitalization passes
+// covers ASCII, the Latin-1 Supplement and Latin Extended-A, i.e. the letters of Polish,
+// French and Spanish text; the two byte letters are looked up in a table built at compile
+// time, ASCII bytes never leave the inline fast path below
+// only letters whose upper case has the same UTF-8 length are mapped, so capitalizing never
+// moves the rest of the text: ß, ı, ĸ, ŉ and ſ are left as they are
+
+namespace detail
+{
+    bool IsLowerLetterNonAscii(std::string_view letter);
+    bool CapitalizeLetterNonAscii(char* letter, size_t available);
+}
+
+// true if text starts with a lower case letter that CapitalizeLetter changes
+inline bool IsLowerLetter(std::string_view text)
+{
+    if (text.empty())
+        return false;
+    unsigned char c = text[0];
+    if (c < 0x80)
+        return c >= 'a' && c <= 'z';
+    return detail::IsLowerLetterNonAscii(text);
+}
+
+// upper cases the letter starting at letter in place, available is the number of bytes that
+// can be read from there; returns true if the letter was changed
+inline bool CapitalizeLetter(char* letter, size_t available)
+{
+    if (available == 0)
+        return false;
+    unsigned char c = letter[0];
+    if (c < 0x80)
+    {
+        if (c < 'a' || c > 'z')
+            return false;
+        letter[0] = static_cast<char>(c - 'a' + 'A');
+        return true;
+    }
+    return detail::CapitalizeLetterNonAscii(letter, available);
+}
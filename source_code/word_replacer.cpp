@@ -0,0 +1,238 @@
+#include "word_replacer.h"
+#include "analysis_arena.h"
+#include "char_classes.h"
+
+#include <algorithm>
+#include <fstream>
+
+void WordReplacer::Add(const std::string& from, const std::string& to)
+{
+    if (from.empty())
+        return;
+    int node = 0;
+    for (unsigned char c : from)
+    {
+        auto it = buildTrie[node].find(c);
+        if (it == buildTrie[node].end())
+        {
+            buildTrie[node][c] = static_cast<int>(buildTrie.size());
+            node = static_cast<int>(buildTrie.size());
+            buildTrie.emplace_back();
+            buildEntries.push_back(-1);
+        }
+        else
+        {
+            node = it->second;
+        }
+    }
+    if (buildEntries[node] < 0)
+    {
+        buildEntries[node] = static_cast<int>(replacements.size());
+        replacements.push_back(to);
+    }
+    else
+    {
+        replacements[buildEntries[node]] = to;
+    }
+}
+
+bool WordReplacer::LoadFromFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::string::size_type arrow = line.find("->");
+        std::string from, to;
+        if (arrow != std::string::npos)
+        {
+            from = line.substr(0, arrow);
+            to = line.substr(arrow + 2);
+        }
+        else
+        {
+            std::string::size_type space = line.find_first_of(" \t");
+            std::string::size_type toStart = line.find_first_not_of(" \t", space);
+            if (space == std::string::npos || toStart == std::string::npos)
+                continue;
+            from = line.substr(0, space);
+            to = line.substr(toStart);
+        }
+        if (to.find(',') != std::string::npos)
+            continue;
+        Add(from, to);
+    }
+    return true;
+}
+
+void WordReplacer::Compile()
+{
+    nodes.assign(buildTrie.size(), Node());
+    edges.clear();
+    edges.reserve(buildTrie.size());
+    for (size_t n = 0; n < buildTrie.size(); ++n)
+    {
+        nodes[n].firstEdge = static_cast<uint32_t>(edges.size());
+        for (const auto& child : buildTrie[n]) // std::map keeps the edges sorted
+            edges.push_back(Edge{ static_cast<uint32_t>(child.second), child.first, {} });
+        nodes[n].lastEdge = static_cast<uint32_t>(edges.size());
+        nodes[n].entry = buildEntries[n];
+    }
+
+    rootChild.assign(256, -1);
+    for (const auto& child : buildTrie[0])
+        rootChild[child.first] = child.second;
+
+    // the replacements are stored back to back
+    replacementOffsets.clear();
+    replacementBytes.clear();
+    for (const std::string& replacement : replacements)
+    {
+        replacementOffsets.push_back(static_cast<uint32_t>(replacementBytes.size()));
+        replacementBytes += replacement;
+    }
+    replacementOffsets.push_back(static_cast<uint32_t>(replacementBytes.size()));
+    external = false;
+}
+
+void WordReplacer::UseTables(const Tables& tables)
+{
+    buildTrie.assign(1, std::map<unsigned char, int>());
+    buildEntries.assign(1, -1);
+    replacements.clear();
+    externalTables = tables;
+    external = true;
+}
+
+WordReplacer::Tables WordReplacer::View() const
+{
+    if (external)
+        return externalTables;
+
+    Tables tables;
+    if (nodes.empty())
+        return tables;
+    tables.nodes = nodes.data();
+    tables.nodeCount = static_cast<uint32_t>(nodes.size());
+    tables.edges = edges.data();
+    tables.edgeCount = static_cast<uint32_t>(edges.size());
+    tables.rootChild = rootChild.data();
+    tables.replacementOffsets = replacementOffsets.data();
+    tables.replacementBytes = replacementBytes.data();
+    tables.entryCount = static_cast<uint32_t>(replacementOffsets.size() - 1);
+    return tables;
+}
+
+size_t WordReplacer::Apply(std::string& text, std::vector<int>* usedEntries) const
+{
+    const Tables tables = View();
+    if (tables.nodeCount == 0)
+        return 0;
+    const Node* nodes = tables.nodes;
+    const int32_t* rootChild = tables.rootChild;
+
+    const size_t length = text.size();
+    ScratchString scratch;
+    std::string& result = scratch.Get();
+    size_t usedBefore = usedEntries ? usedEntries->size() : 0;
+    size_t copiedUpTo = 0;
+    size_t count = 0;
+
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned char c = text[i];
+        bool prevIsWord = i > 0 && IsWordChar(text[i - 1]);
+        if (rootChild[c] < 0 || prevIsWord == IsWordChar(c))
+        {
+            ++i;
+            continue;
+        }
+
+        // walks the trie and remembers the longest entry ending on a word boundary
+        int best = -1;
+        size_t bestEnd = 0;
+        int node = rootChild[c];
+        size_t j = i + 1;
+        while (true)
+        {
+            if (nodes[node].entry >= 0)
+            {
+                bool lastIsWord = IsWordChar(text[j - 1]);
+                bool nextIsWord = j < length && IsWordChar(text[j]);
+                if (lastIsWord != nextIsWord)
+                {
+                    best = nodes[node].entry;
+                    bestEnd = j;
+                }
+            }
+            if (j >= length)
+                break;
+            node = FindChild(tables, node, static_cast<unsigned char>(text[j]));
+            if (node < 0)
+                break;
+            ++j;
+        }
+
+        if (best < 0)
+        {
+            ++i;
+            continue;
+        }
+
+        if (result.empty())
+            result.reserve(length + length / 16);
+        result.append(text, copiedUpTo, i - copiedUpTo);
+        result.append(tables.replacementBytes + tables.replacementOffsets[best],
+                      tables.replacementOffsets[best + 1] - tables.replacementOffsets[best]);
+        if (usedEntries)
+            usedEntries->push_back(best);
+        ++count;
+        i = bestEnd;
+        copiedUpTo = bestEnd;
+    }
+
+    if (count == 0)
+        return 0;
+
+    result.append(text, copiedUpTo, std::string::npos);
+    text.swap(result);
+
+    if (usedEntries)
+    {
+        std::sort(usedEntries->begin() + usedBefore, usedEntries->end());
+        usedEntries->erase(std::unique(usedEntries->begin() + usedBefore, usedEntries->end()), usedEntries->end());
+    }
+    return count;
+}
+
+int WordReplacer::FindChild(const Tables& tables, int node, unsigned char c)
+{
+    const Edge* edges = tables.edges;
+    uint32_t lo = tables.nodes[node].firstEdge;
+    uint32_t hi = tables.nodes[node].lastEdge;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (edges[mid].byte < c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < tables.nodes[node].lastEdge && edges[lo].byte == c) ? static_cast<int>(edges[lo].target) : -1;
+}
+
+void AddBuiltinTypos(WordReplacer& replacer)
+{
+    replacer.Add("teh", "the");
+    replacer.Add("recieve", "receive");
+    replacer.Add("adn", "and");
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// replaces whole-word misspellings using a byte trie compiled once from all entries
+// every occurrence is fixed in one left-to-right pass over the text, at each word
+// boundary the longest entry that also ends on a word boundary wins (like \bword\b)
+class WordReplacer
+{
+public:
+    // adds or overrides an entry, Compile() must be called before Apply()
+    void Add(const std::string& from, const std::string& to);
+
+    // loads entries from a dictionary file, one per line, either "misspelling->correction"
+    // (the common-misspellings list format) or "misspelling correction"
+    // empty lines, lines starting with '#' and entries with several suggestions are skipped
+    // returns false if the file could not be opened
+    bool LoadFromFile(const std::string& path);
+
+    // flattens the build trie into sorted edge arrays used by Apply()
+    void Compile();
+
+    size_t Size() const { return external ? externalTables.entryCount : replacements.size(); }
+
+    // fixes every occurrence in text, returns the number of replacements made
+    // the indices of the entries used are appended to usedEntries (optional), the appended
+    // range is sorted and unique
+    size_t Apply(std::string& text, std::vector<int>* usedEntries = nullptr) const;
+
+    // the compiled trie is plain arrays of these, so it can be written to a file and used
+    // from a mapping of it (see rule_pack.h)
+    struct Node
+    {
+        uint32_t firstEdge = 0;
+        uint32_t lastEdge = 0;
+        int32_t entry = -1;
+    };
+
+    struct Edge
+    {
+        uint32_t target;
+        unsigned char byte;
+        unsigned char reserved[3];
+    };
+
+    // the compiled arrays, valid while the replacer (or the memory given to UseTables) is
+    struct Tables
+    {
+        const Node* nodes = nullptr;
+        uint32_t nodeCount = 0;
+        const Edge* edges = nullptr;
+        uint32_t edgeCount = 0;
+        const int32_t* rootChild = nullptr;        // 256 entries, -1 for no child
+        const uint32_t* replacementOffsets = nullptr; // entryCount + 1 offsets into replacementBytes
+        const char* replacementBytes = nullptr;
+        uint32_t entryCount = 0;
+    };
+
+    Tables CompiledTables() const { return View(); }
+
+    // uses arrays compiled earlier instead of the own ones, entries added before are dropped
+    void UseTables(const Tables& tables);
+
+private:
+    // the own compiled arrays or the ones given to UseTables
+    Tables View() const;
+
+    static int FindChild(const Tables& tables, int node, unsigned char c);
+
+    // trie used while adding entries
+    std::vector<std::map<unsigned char, int>> buildTrie = std::vector<std::map<unsigned char, int>>(1);
+    std::vector<int> buildEntries = std::vector<int>(1, -1);
+
+    std::vector<std::string> replacements;
+
+    // compiled trie
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::vector<int32_t> rootChild;
+    std::vector<uint32_t> replacementOffsets;
+    std::string replacementBytes;
+
+    bool external = false; // set by UseTables
+    Tables externalTables;
+};
+
+// adds the English typo entries that are always available, even without a dictionary file
+void AddBuiltinTypos(WordReplacer& replacer);